@@ -0,0 +1,45 @@
+# Microbenchmarks of the simulation pipeline, no widgets (see stovebench.cpp).
+# QtGui is only needed for the pixel type of the paint pass, QtConcurrent for the checkpoints of SimulationThread.
+QT       += core gui concurrent
+QT       -= widgets
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = stovebench
+
+SOURCES += \
+    adisolver.cpp \
+    checkpoint.cpp \
+    framerecorder.cpp \
+    heatsolver.cpp \
+    multigridsolver.cpp \
+    profiler.cpp \
+    rkcsolver.cpp \
+    simulationthread.cpp \
+    stencilkernel.cpp \
+    steadystate.cpp \
+    stovebench.cpp \
+    temperaturepainter.cpp \
+    workerpool.cpp
+
+HEADERS += \
+    adisolver.h \
+    checkpoint.h \
+    framerecorder.h \
+    heatsolver.h \
+    multigridsolver.h \
+    plategrid.h \
+    profiler.h \
+    rkcsolver.h \
+    simulationthread.h \
+    stencilkernel.h \
+    steadystate.h \
+    temperaturepainter.h \
+    triplebuffer.h \
+    workerpool.h
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
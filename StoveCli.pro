@@ -0,0 +1,42 @@
+# Headless batch runner, no widgets: can be built and ran on render-less machines.
+# QtGui is only needed to read PNG burner masks.
+QT       += core gui concurrent
+QT       -= widgets
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = stovecli
+
+SOURCES += \
+    adisolver.cpp \
+    checkpoint.cpp \
+    heatsolver.cpp \
+    multigridsolver.cpp \
+    parametersweep.cpp \
+    profiler.cpp \
+    rkcsolver.cpp \
+    scenario.cpp \
+    stovecli.cpp \
+    stencilkernel.cpp \
+    steadystate.cpp \
+    workerpool.cpp
+
+HEADERS += \
+    adisolver.h \
+    checkpoint.h \
+    heatsolver.h \
+    multigridsolver.h \
+    parametersweep.h \
+    rkcsolver.h \
+    plategrid.h \
+    profiler.h \
+    scenario.h \
+    stencilkernel.h \
+    steadystate.h \
+    workerpool.h
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
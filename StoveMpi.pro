@@ -0,0 +1,40 @@
+# Distributed runs of the explicit steps over MPI ranks (see stovempi.cpp), no Qt:
+# built with the MPI compiler wrappers, ran with mpirun.
+CONFIG -= qt app_bundle
+CONFIG += c++17 console
+
+QMAKE_CC = mpicc
+QMAKE_CXX = mpicxx
+QMAKE_LINK = mpicxx
+
+# only the C API of MPI is used, its deprecated C++ bindings are left out
+DEFINES += OMPI_SKIP_MPICXX MPICH_SKIP_MPICXX
+
+TARGET = stovempi
+
+SOURCES += \
+    adisolver.cpp \
+    distributedsolver.cpp \
+    heatsolver.cpp \
+    multigridsolver.cpp \
+    profiler.cpp \
+    rkcsolver.cpp \
+    stencilkernel.cpp \
+    stovempi.cpp \
+    workerpool.cpp
+
+HEADERS += \
+    adisolver.h \
+    distributedsolver.h \
+    heatsolver.h \
+    multigridsolver.h \
+    plategrid.h \
+    profiler.h \
+    rkcsolver.h \
+    stencilkernel.h \
+    workerpool.h
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
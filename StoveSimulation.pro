@@ -9,11 +9,37 @@ CONFIG += c++17
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    adisolver.cpp \
+    checkpoint.cpp \
+    framerecorder.cpp \
+    heatsolver.cpp \
     main.cpp \
-    mainwindow.cpp
+    mainwindow.cpp \
+    multigridsolver.cpp \
+    profiler.cpp \
+    rkcsolver.cpp \
+    simulationthread.cpp \
+    stencilkernel.cpp \
+    steadystate.cpp \
+    temperaturepainter.cpp \
+    workerpool.cpp
 
 HEADERS += \
-    mainwindow.h
+    adisolver.h \
+    checkpoint.h \
+    framerecorder.h \
+    heatsolver.h \
+    mainwindow.h \
+    multigridsolver.h \
+    plategrid.h \
+    profiler.h \
+    rkcsolver.h \
+    simulationthread.h \
+    stencilkernel.h \
+    steadystate.h \
+    temperaturepainter.h \
+    triplebuffer.h \
+    workerpool.h
 
 FORMS += \
     mainwindow.ui
@@ -0,0 +1,141 @@
+#include "adisolver.h"
+
+#include <algorithm>
+
+void AdiSolver::factorize(int n, double offDiagonal, double diagonal,
+                          std::vector<double> &cPrime, std::vector<double> &inverse){
+    // forward elimination factors of the constant tridiagonal matrix [off, diagonal, off]
+    cPrime.resize(n);
+    inverse.resize(n);
+    double previousCPrime = 0;
+    for (int i = 0; i < n; ++i){
+        inverse[i] = 1. / (diagonal - offDiagonal * previousCPrime);
+        cPrime[i] = offDiagonal * inverse[i];
+        previousCPrime = cPrime[i];
+    }
+}
+
+void AdiSolver::step(const double *previous, double *current, const double *heater,
+                     int newNx, int newNy, int newStride, const StencilCoefficients &c, WorkerPool *pool){
+    nx = newNx;
+    ny = newNy;
+    stride = newStride;
+    ax = c.x / 2;
+    ay = c.y / 2;
+    az = c.z / 2;
+    outside = c.outside;
+
+    factorize(nx-2, -ax, 1. + 2*ax + az, cPrimeX, inverseX);
+    factorize(ny-2, -ay, 1. + 2*ay + az, cPrimeY, inverseY);
+
+    const int threads = pool ? pool->size() : 1;
+    rightHandSide.resize(static_cast<size_t>(stride) * ny);
+    if (lines.size() != static_cast<size_t>(threads)) lines.resize(threads);
+    for (std::vector<double> &line : lines) line.resize(nx);
+
+    /* the half step in x is written into current, its rows are independent;
+     * the half step in y needs the neighbour columns of the x half, so the
+     * right hand side is ready before any column is overwritten */
+    auto job = [this, previous, current, heater, threads, pool](int worker){
+        const int yMin = static_cast<int>(static_cast<long long>(ny) * worker / threads);
+        const int yMax = static_cast<int>(static_cast<long long>(ny) * (worker+1) / threads);
+        const int xMin = static_cast<int>(static_cast<long long>(nx) * worker / threads);
+        const int xMax = static_cast<int>(static_cast<long long>(nx) * (worker+1) / threads);
+
+        halfStepX(previous, current, heater, yMin, yMax, lines[worker].data());
+        if (pool) pool->barrier();
+        rightHandSideY(previous, current, heater, xMin, xMax);
+        if (pool) pool->barrier();
+        solveColumns(current, xMin, xMax);
+    };
+    if (pool) pool->run(job);
+    else job(0);
+}
+
+size_t AdiSolver::memoryBytes() const{
+    size_t count = cPrimeX.capacity() + inverseX.capacity() + cPrimeY.capacity() + inverseY.capacity()
+            + rightHandSide.capacity();
+    for (const std::vector<double> &line : lines) count += line.capacity();
+    return count * sizeof(double);
+}
+
+void AdiSolver::halfStepX(const double *previous, double *half, const double *heater, int yMin, int yMax, double *line){
+    // (1 - ax*dxx + az) half = (1 + ay*dyy - az) previous + az*(air + heater), implicit along the rows
+    const int n = nx-2;
+    for (int y = yMin; y < yMax; ++y){
+        const double *T = previous + static_cast<size_t>(y) * stride;
+        double *out = half + static_cast<size_t>(y) * stride;
+        if (y == 0 || y == ny-1){
+            // constant boundary rows
+            std::copy(T, T + nx, out);
+            continue;
+        }
+        out[0] = T[0];
+        out[nx-1] = T[nx-1];
+
+        const double *heaterRow = heater + static_cast<size_t>(y) * stride;
+        for (int x = 1; x < nx-1; ++x){
+            line[x-1] = T[x] + ay*(T[x-stride] + T[x+stride] - 2*T[x]) - az*T[x]
+                    + az*(std::min(outside, T[x]*0.7) + heaterRow[x]);
+        }
+        // constant border points move to the right hand side
+        line[0] += ax*out[0];
+        line[n-1] += ax*out[nx-1];
+
+        // Thomas algorithm, forward elimination and back substitution
+        line[0] *= inverseX[0];
+        for (int i = 1; i < n; ++i) line[i] = (line[i] + ax*line[i-1]) * inverseX[i];
+        for (int i = n-2; i >= 0; --i) line[i] -= cPrimeX[i] * line[i+1];
+        std::copy(line, line + n, out + 1);
+    }
+}
+
+void AdiSolver::rightHandSideY(const double *previous, const double *half, const double *heater, int xMin, int xMax){
+    // (1 + ax*dxx - az) half + az*(air + heater), the air is taken from the previous state
+    xMin = std::max(1, xMin);
+    xMax = std::min(nx-1, xMax);
+    for (int y = 1; y < ny-1; ++y){
+        const size_t row = static_cast<size_t>(y) * stride;
+        const double *H = half + row;
+        const double *T = previous + row;
+        const double *heaterRow = heater + row;
+        double *rhs = rightHandSide.data() + row;
+        for (int x = xMin; x < xMax; ++x){
+            rhs[x] = H[x] + ax*(H[x-1] + H[x+1] - 2*H[x]) - az*H[x]
+                    + az*(std::min(outside, T[x]*0.7) + heaterRow[x]);
+        }
+    }
+    // constant border rows move to the right hand side
+    for (int x = xMin; x < xMax; ++x){
+        rightHandSide[static_cast<size_t>(stride) + x] += ay*half[x];
+        rightHandSide[static_cast<size_t>(ny-2) * stride + x] += ay*half[static_cast<size_t>(ny-1) * stride + x];
+    }
+}
+
+void AdiSolver::solveColumns(double *current, int xMin, int xMax){
+    /* all the columns xMin..xMax at once: the Thomas algorithm goes down and up the rows,
+     * and every row of the sweep is a contiguous, vectorisable loop */
+    xMin = std::max(1, xMin);
+    xMax = std::min(nx-1, xMax);
+    if (xMin >= xMax) return;
+    double *rhs = rightHandSide.data();
+
+    for (int x = xMin; x < xMax; ++x) rhs[static_cast<size_t>(stride) + x] *= inverseY[0];
+    for (int y = 2; y < ny-1; ++y){
+        double *line = rhs + static_cast<size_t>(y) * stride;
+        const double *lineAbove = line - stride;
+        const double inverse = inverseY[y-1];
+        for (int x = xMin; x < xMax; ++x) line[x] = (line[x] + ay*lineAbove[x]) * inverse;
+    }
+
+    double *last = current + static_cast<size_t>(ny-2) * stride;
+    const double *lastRhs = rhs + static_cast<size_t>(ny-2) * stride;
+    for (int x = xMin; x < xMax; ++x) last[x] = lastRhs[x];
+    for (int y = ny-3; y >= 1; --y){
+        double *out = current + static_cast<size_t>(y) * stride;
+        const double *below = out + stride;
+        const double *line = rhs + static_cast<size_t>(y) * stride;
+        const double cPrime = cPrimeY[y-1];
+        for (int x = xMin; x < xMax; ++x) out[x] = line[x] - cPrime * below[x];
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef ADISOLVER_H
+#define ADISOLVER_H
+
+/* Peaceman-Rachford ADI step of the stove top, unconditionally stable.
+ * The step is split in two halves, implicit in x and explicit in y, then the other
+ * way round; every half is a batch of tridiagonal systems solved with the Thomas
+ * algorithm. The coefficients are the same for all the lines, so the elimination
+ * factors are calculated once per step and shared by all of them. Rows are solved
+ * one by one, columns all at once, sweeping the rows so the memory is read in order.
+ * The z term: -2T/zStep^2 is split between the halves and implicit, the air and the
+ * heater (min(outside, 0.7T) + heater)/zStep^2 are taken from the previous state. */
+
+// C++ libs
+#include <vector>
+
+#include "stencilkernel.h"
+#include "workerpool.h"
+
+//______________________________________________ADI Solver________________//
+class AdiSolver{
+public:
+    /* previous and current are nx*ny plates stored row by row, stride points apart,
+     * the border points are constant; c holds alpha*timeStep/step^2 for the whole step */
+    void step(const double *previous, double *current, const double *heater,
+              int nx, int ny, int stride, const StencilCoefficients &c, WorkerPool *pool);
+
+    size_t memoryBytes() const;
+
+private:
+    static void factorize(int n, double offDiagonal, double diagonal,
+                          std::vector<double> &cPrime, std::vector<double> &inverse);
+
+    void halfStepX(const double *previous, double *half, const double *heater, int yMin, int yMax, double *line);
+
+    void rightHandSideY(const double *previous, const double *half, const double *heater, int xMin, int xMax);
+
+    void solveColumns(double *current, int xMin, int xMax);
+
+    int nx = 0;
+    int ny = 0;
+    int stride = 0;
+    double ax = 0, ay = 0, az = 0;   // coefficients of a half step
+    double outside = 20.;
+
+    // Thomas factors of the x lines (nx-2 long) and of the y lines (ny-2 long)
+    std::vector<double> cPrimeX, inverseX;
+    std::vector<double> cPrimeY, inverseY;
+
+    std::vector<double> rightHandSide;           // of the y half, whole plate with the same stride
+    std::vector<std::vector<double>> lines;      // one line buffer per worker
+};
+
+#endif // ADISOLVER_H
@@ -0,0 +1,197 @@
+#include "checkpoint.h"
+
+// Qt files
+#include <QFile>
+#include <QSaveFile>
+
+// C++ libs
+#include <cstring>
+
+namespace {
+const char checkpointMagic[8] = {'S', 'T', 'O', 'V', 'E', 'C', 'P', '\0'};
+const quint32 byteOrderMark = 0x01020304;
+
+struct CheckpointHeader{
+    char magic[8];
+    quint32 version;
+    quint32 headerBytes;         // with byteOrder, tells if the file was written by a compatible build
+    quint32 byteOrder;
+    qint32 sizeX, sizeY, stride;
+    qint32 tileCountX, tileCountY;
+    qint32 watts;
+    qint32 burnerOn;
+    qint32 plateLayers;          // 1 - the single layer plate, no layers block
+    qint32 reserved;
+    qint64 step;
+    double simulatedTime;
+    double alpha;
+    double ambientTemperature;
+    double proposedStep;
+    quint64 temperatureOffset;   // from the start of the file, the two layers start on a page
+    quint64 heaterOffset;
+    quint64 burnerOffset;
+    quint64 burnerWords;
+    quint64 tilesOffset;
+    quint64 layersOffset;        // on a page, 0 with a single layer
+    quint64 fileBytes;
+};
+
+quint64 pageAligned(quint64 offset){
+    return (offset + Checkpoint::pageSize - 1) / Checkpoint::pageSize * Checkpoint::pageSize;
+}
+
+bool fail(QString *error, const QString &message){
+    if (error) *error = message;
+    return false;
+}
+}
+
+void Checkpoint::capture(const HeatSolver &solver){
+    const std::vector<uint64_t> &burnerMap = solver.getBurnerMap();
+    const quint64 layerBytes = static_cast<quint64>(solver.rowStride()) * solver.sizeY() * sizeof(double);
+    const quint64 tiles = static_cast<quint64>(solver.getTileCountX()) * solver.getTileCountY();
+    const int plateLayers = solver.getPlateLayers();
+    const quint64 layersBytes = plateLayers > 1 ? layerBytes * plateLayers : 0;
+
+    CheckpointHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, checkpointMagic, sizeof(header.magic));
+    header.version = version;
+    header.headerBytes = sizeof(CheckpointHeader);
+    header.byteOrder = byteOrderMark;
+    header.sizeX = solver.sizeX();
+    header.sizeY = solver.sizeY();
+    header.stride = solver.rowStride();
+    header.tileCountX = solver.getTileCountX();
+    header.tileCountY = solver.getTileCountY();
+    header.watts = solver.getWatts();
+    header.burnerOn = solver.isBurnerOn();
+    header.plateLayers = plateLayers;
+    header.step = solver.getCurrentStep();
+    header.simulatedTime = solver.getSimulatedTime();
+    header.alpha = solver.getAlpha();
+    header.ambientTemperature = solver.getAmbientTemperature();
+    header.proposedStep = solver.getIntegrator() == Integrator::RKC ? solver.getProposedStep() : 0.;
+    header.temperatureOffset = pageAligned(sizeof(CheckpointHeader));
+    header.heaterOffset = pageAligned(header.temperatureOffset + layerBytes);
+    header.burnerOffset = pageAligned(header.heaterOffset + layerBytes);
+    header.burnerWords = burnerMap.size();
+    header.tilesOffset = header.burnerOffset + burnerMap.size() * sizeof(uint64_t);
+    header.layersOffset = plateLayers > 1 ? pageAligned(header.tilesOffset + tiles) : 0;
+    header.fileBytes = plateLayers > 1 ? header.layersOffset + layersBytes : header.tilesOffset + tiles;
+
+    // not zeroed, only the gaps between the parts are cleared
+    if (imageBytes != static_cast<qint64>(header.fileBytes)){
+        imageBytes = static_cast<qint64>(header.fileBytes);
+        image.reset(new char[imageBytes]);
+    }
+    char *file = image.get();
+    std::memset(file, 0, header.temperatureOffset);
+    std::memcpy(file, &header, sizeof(header));
+    // the layers are one block each, their rows and padding are copied as they are
+    std::memcpy(file + header.temperatureOffset, solver.temperatureRow(0), layerBytes);
+    std::memset(file + header.temperatureOffset + layerBytes, 0, header.heaterOffset - header.temperatureOffset - layerBytes);
+    std::memcpy(file + header.heaterOffset, solver.heaterRow(0), layerBytes);
+    std::memset(file + header.heaterOffset + layerBytes, 0, header.burnerOffset - header.heaterOffset - layerBytes);
+    std::memcpy(file + header.burnerOffset, burnerMap.data(), burnerMap.size() * sizeof(uint64_t));
+    for (int tileY = 0; tileY < header.tileCountY; ++tileY){
+        for (int tileX = 0; tileX < header.tileCountX; ++tileX){
+            file[header.tilesOffset + tileY * header.tileCountX + tileX] = solver.isTileActive(tileX, tileY);
+        }
+    }
+    if (plateLayers > 1){
+        const quint64 tilesEnd = header.tilesOffset + tiles;
+        std::memset(file + tilesEnd, 0, header.layersOffset - tilesEnd);
+        std::memcpy(file + header.layersOffset, solver.layerRow(0, 0), layersBytes);
+    }
+}
+
+long long Checkpoint::getStep() const{
+    if (isEmpty()) return 0;
+    return reinterpret_cast<const CheckpointHeader *>(image.get())->step;
+}
+
+bool Checkpoint::write(const QString &fileName, QString *error) const{
+    if (isEmpty()) return fail(error, "Nothing captured to write");
+    /* one copy into a temporary file next to the target; commit() flushes it to the disk
+     * and renames it over the target in one step, the target is never removed first.
+     * A run restored from the old file keeps its mapping of it */
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) return fail(error, "Can not write " + fileName + ": " + file.errorString());
+    if (file.write(image.get(), imageBytes) != imageBytes){
+        const QString message = file.errorString();
+        file.cancelWriting();
+        return fail(error, "Can not write " + fileName + ": " + message);
+    }
+    if (!file.commit()) return fail(error, "Can not replace " + fileName + ": " + file.errorString());
+    return true;
+}
+
+bool Checkpoint::restore(HeatSolver &solver, const QString &fileName, QString *error, const QSize &plateSize){
+    std::shared_ptr<QFile> file = std::make_shared<QFile>(fileName);
+    if (!file->open(QIODevice::ReadOnly)) return fail(error, "Can not open " + fileName + ": " + file->errorString());
+    const qint64 fileBytes = file->size();
+    if (fileBytes < static_cast<qint64>(sizeof(CheckpointHeader))) return fail(error, fileName + " is not a checkpoint");
+
+    // private: the steps write to their own copy of the touched pages, never to the file
+    uchar *data = file->map(0, fileBytes, QFileDevice::MapPrivateOption);
+    if (!data) return fail(error, "Can not map " + fileName + ": " + file->errorString());
+    std::shared_ptr<void> mapping(data, [file](void *p){ file->unmap(static_cast<uchar *>(p)); });
+
+    CheckpointHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, checkpointMagic, sizeof(header.magic)) != 0){
+        return fail(error, fileName + " is not a checkpoint");
+    }
+    if (header.version != version || header.headerBytes != sizeof(CheckpointHeader) || header.byteOrder != byteOrderMark){
+        return fail(error, fileName + " was written by an incompatible version");
+    }
+    if (header.sizeX < 3 || header.sizeY < 3 || header.stride != PlateGrid<double>::paddedStride(header.sizeX)){
+        return fail(error, fileName + " has a plate layout this version can not use");
+    }
+    const quint64 layerBytes = static_cast<quint64>(header.stride) * header.sizeY * sizeof(double);
+    const quint64 cells = static_cast<quint64>(header.stride) * header.sizeY;
+    const quint64 tilesEnd = header.tilesOffset + static_cast<quint64>(header.tileCountX) * header.tileCountY;
+    const bool layered = header.plateLayers > 1;
+    const int tileSize = HeatSolver::tileSize;
+    const bool consistent = header.fileBytes == static_cast<quint64>(fileBytes)
+            && header.temperatureOffset % pageSize == 0 && header.heaterOffset % pageSize == 0
+            && header.temperatureOffset >= sizeof(CheckpointHeader)
+            && header.heaterOffset >= header.temperatureOffset + layerBytes
+            && header.burnerOffset >= header.heaterOffset + layerBytes
+            && header.burnerWords == (cells + 63) / 64
+            && header.tilesOffset == header.burnerOffset + header.burnerWords * sizeof(uint64_t)
+            && header.tileCountX == (header.sizeX + tileSize - 1) / tileSize
+            && header.tileCountY == (header.sizeY + tileSize - 1) / tileSize
+            && header.plateLayers >= 1 && header.plateLayers <= HeatSolver::maxPlateLayers
+            && (layered ? header.layersOffset % pageSize == 0 && header.layersOffset >= tilesEnd
+                          && header.fileBytes == header.layersOffset + layerBytes * header.plateLayers
+                        : header.layersOffset == 0 && header.fileBytes == tilesEnd);
+    if (!consistent) return fail(error, fileName + " is truncated or damaged");
+    if (plateSize.isValid() && (header.sizeX != plateSize.width() || header.sizeY != plateSize.height())){
+        return fail(error, QString("%1 holds a %2x%3 plate, not %4x%5")
+                    .arg(fileName).arg(header.sizeX).arg(header.sizeY).arg(plateSize.width()).arg(plateSize.height()));
+    }
+
+    SolverState state;
+    state.sizeX = header.sizeX;
+    state.sizeY = header.sizeY;
+    state.temperatures = reinterpret_cast<double *>(data + header.temperatureOffset);
+    state.heater = reinterpret_cast<double *>(data + header.heaterOffset);
+    state.plateLayers = header.plateLayers;
+    if (layered) state.layers = reinterpret_cast<double *>(data + header.layersOffset);
+    state.owner = std::move(mapping);
+    state.burnerMap.resize(header.burnerWords);
+    std::memcpy(state.burnerMap.data(), data + header.burnerOffset, header.burnerWords * sizeof(uint64_t));
+    const char *tiles = reinterpret_cast<const char *>(data + header.tilesOffset);
+    state.activeTiles.assign(tiles, tiles + static_cast<size_t>(header.tileCountX) * header.tileCountY);
+    state.ambientTemperature = header.ambientTemperature;
+    state.step = header.step;
+    state.simulatedTime = header.simulatedTime;
+    state.alpha = header.alpha;
+    state.watts = header.watts;
+    state.burnerOn = header.burnerOn != 0;
+    state.proposedStep = header.proposedStep;
+    solver.restoreState(std::move(state));
+    return true;
+}
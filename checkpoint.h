@@ -0,0 +1,51 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+/* Binary checkpoint of a run, to resume it later (HeatSolver::restoreState).
+ * The file is a header followed by the current plate, the heater, the burner mask,
+ * the active tiles and, for a layered plate, all its layers (z-blocked as in the solver);
+ * the plate, the heater and the layers keep the row stride of the solver and start on
+ * a page, so a restore maps the file and hands these blocks to the solver as they are: nothing is read nor copied until a step touches it, and the
+ * mapping is private, the steps never write to the file. The numbers are stored as
+ * in memory (native byte order and padding), the header tells if a file fits the build.
+ * capture() copies the state in the file layout, a plain copy of the plate like a
+ * frame for the UI; write() can then run on any thread while the solver keeps
+ * stepping, it writes a temporary file, syncs it to the disk and only then renames
+ * it over the old checkpoint (QSaveFile), which is left whole if the write fails or
+ * the machine goes down during it. */
+
+// Qt files
+#include <QSize>
+#include <QString>
+
+// C++ libs
+#include <memory>
+
+#include "heatsolver.h"
+
+//______________________________________________Checkpoint________________//
+class Checkpoint{
+public:
+    // copy of the current state of the solver, in the layout of the file
+    void capture(const HeatSolver &solver);
+
+    bool isEmpty() const { return imageBytes == 0; }
+
+    long long getStep() const;
+
+    bool write(const QString &fileName, QString *error = nullptr) const;
+
+    /* maps the file into the solver, which keeps the mapping as long as it uses the layers;
+     * with a valid plateSize, a plate of another size is refused and the solver is left as it was */
+    static bool restore(HeatSolver &solver, const QString &fileName, QString *error = nullptr,
+                        const QSize &plateSize = QSize());
+
+    static constexpr qint64 pageSize = 4096;
+    static constexpr quint32 version = 2;      // 2 - with the layers of the plate
+
+private:
+    std::unique_ptr<char[]> image;   // the whole file
+    qint64 imageBytes = 0;
+};
+
+#endif // CHECKPOINT_H
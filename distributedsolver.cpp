@@ -0,0 +1,179 @@
+#include "distributedsolver.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "profiler.h"
+
+namespace {
+// a halo is tagged with the way it travels
+enum HaloTag { TowardsNorth, TowardsSouth, TowardsWest, TowardsEast };
+}
+
+DistributedSolver::DistributedSolver(MPI_Comm communicator, int sizeX, int sizeY){
+    plateSizeX = std::max(3, sizeX);
+    plateSizeY = std::max(3, sizeY);
+    MPI_Comm_size(communicator, &ranks);
+
+    // the blocks as square as the number of ranks allows, the longer side of the plate split more
+    int dims[2] = {0, 0};
+    MPI_Dims_create(ranks, 2, dims);
+    if ((plateSizeX > plateSizeY) != (dims[1] > dims[0])) std::swap(dims[0], dims[1]);
+    gridY = dims[0];
+    gridX = dims[1];
+    const int periods[2] = {0, 0};
+    MPI_Cart_create(communicator, 2, dims, periods, 1, &cartesian);
+    MPI_Comm_rank(cartesian, &rank);
+    int coords[2];
+    MPI_Cart_coords(cartesian, rank, 2, coords);
+    coordY = coords[0];
+    coordX = coords[1];
+    MPI_Cart_shift(cartesian, 0, 1, &north, &south);
+    MPI_Cart_shift(cartesian, 1, 1, &west, &east);
+
+    int blockX = 0, blockY = 0;
+    blockOrigin(coordX, coordY, &originX, &originY, &blockX, &blockY);
+    block.resize(blockX + 2, blockY + 2);
+
+    MPI_Type_vector(blockY, 1, block.rowStride(), MPI_DOUBLE, &columnType);
+    MPI_Type_commit(&columnType);
+}
+
+DistributedSolver::~DistributedSolver(){
+    if (columnType != MPI_DATATYPE_NULL) MPI_Type_free(&columnType);
+    if (cartesian != MPI_COMM_NULL) MPI_Comm_free(&cartesian);
+}
+
+void DistributedSolver::blockOrigin(int blockCoordX, int blockCoordY, int *blockOriginX, int *blockOriginY,
+                                    int *blockX, int *blockY) const{
+    // the inner points 1..size-2 of the plate are split evenly, the halo corner is one point before
+    const int innerX = plateSizeX - 2;
+    const int innerY = plateSizeY - 2;
+    const int xMin = 1 + static_cast<int>(static_cast<long long>(innerX) * blockCoordX / gridX);
+    const int xMax = 1 + static_cast<int>(static_cast<long long>(innerX) * (blockCoordX+1) / gridX);
+    const int yMin = 1 + static_cast<int>(static_cast<long long>(innerY) * blockCoordY / gridY);
+    const int yMax = 1 + static_cast<int>(static_cast<long long>(innerY) * (blockCoordY+1) / gridY);
+    *blockOriginX = xMin - 1;
+    *blockOriginY = yMin - 1;
+    *blockX = xMax - xMin;
+    *blockY = yMax - yMin;
+}
+
+void DistributedSolver::setBurnerDisc(int centerX, int centerY, int diameter, bool status){
+    /* the disc is drawn over the block and its halos, then taken off the halos of the
+     * neighbours, they draw it themselves; the border of the plate keeps it as a single
+     * solver does, those points count in the power */
+    block.setBurnerDisc(centerX - originX, centerY - originY, diameter, status);
+    const int nx = block.sizeX();
+    const int ny = block.sizeY();
+    for (int x = 0; x < nx; ++x){
+        if (north != MPI_PROC_NULL) block.setBurnerCell(x, 0, false);
+        if (south != MPI_PROC_NULL) block.setBurnerCell(x, ny-1, false);
+    }
+    for (int y = 0; y < ny; ++y){
+        if (west != MPI_PROC_NULL) block.setBurnerCell(0, y, false);
+        if (east != MPI_PROC_NULL) block.setBurnerCell(nx-1, y, false);
+    }
+}
+
+void DistributedSolver::countBurnerPixels(){
+    int pixels = block.getNumberOfBurnerPixels();
+    MPI_Allreduce(&pixels, &burnerPixels, 1, MPI_INT, MPI_SUM, cartesian);
+    block.setPowerPixels(burnerPixels);
+}
+
+void DistributedSolver::calcHeatingSteps(int steps){
+    const int nx = block.sizeX();
+    const int ny = block.sizeY();
+    const int bx = nx - 2;
+    const int by = ny - 2;
+    for (int i = 0; i < steps; ++i){
+        // the state just stepped becomes the previous one, its halos are filled while the inside is stepped
+        block.swapBuffers();
+        MPI_Request requests[8];
+        MPI_Irecv(block.previousRow(0) + 1, bx, MPI_DOUBLE, north, TowardsSouth, cartesian, &requests[0]);
+        MPI_Irecv(block.previousRow(ny-1) + 1, bx, MPI_DOUBLE, south, TowardsNorth, cartesian, &requests[1]);
+        MPI_Irecv(block.previousRow(1), 1, columnType, west, TowardsEast, cartesian, &requests[2]);
+        MPI_Irecv(block.previousRow(1) + nx-1, 1, columnType, east, TowardsWest, cartesian, &requests[3]);
+        MPI_Isend(block.previousRow(1) + 1, bx, MPI_DOUBLE, north, TowardsNorth, cartesian, &requests[4]);
+        MPI_Isend(block.previousRow(ny-2) + 1, bx, MPI_DOUBLE, south, TowardsSouth, cartesian, &requests[5]);
+        MPI_Isend(block.previousRow(1) + 1, 1, columnType, west, TowardsWest, cartesian, &requests[6]);
+        MPI_Isend(block.previousRow(1) + nx-2, 1, columnType, east, TowardsEast, cartesian, &requests[7]);
+
+        block.calcHeaterRows();
+        block.calcStencilRect(2, nx-2, 2, ny-2);
+        {
+            ProfileScope scope(ProfilePhase::Barrier);
+            const double waitStart = MPI_Wtime();
+            MPI_Waitall(8, requests, MPI_STATUSES_IGNORE);
+            exchangeWaitSeconds += MPI_Wtime() - waitStart;
+        }
+        // the ring of points next to the halos
+        block.calcStencilRect(1, nx-1, 1, 2);
+        if (by > 1) block.calcStencilRect(1, nx-1, ny-2, ny-1);
+        block.calcStencilRect(1, 2, 2, ny-2);
+        if (bx > 1) block.calcStencilRect(nx-2, nx-1, 2, ny-2);
+        block.finishStep();
+    }
+}
+
+long long DistributedSolver::haloBytesPerStep() const{
+    const long long rows = (north != MPI_PROC_NULL) + (south != MPI_PROC_NULL);
+    const long long columns = (west != MPI_PROC_NULL) + (east != MPI_PROC_NULL);
+    return (rows * blockSizeX() + columns * blockSizeY()) * static_cast<long long>(sizeof(double));
+}
+
+double DistributedSolver::maxTemperature() const{
+    // the inner points of the block, the border of the plate stays at the outside temperature
+    double maximum = -std::numeric_limits<double>::infinity();
+    for (int y = 1; y <= blockSizeY(); ++y){
+        const double *row = block.temperatureRow(y);
+        maximum = std::max(maximum, *std::max_element(row + 1, row + 1 + blockSizeX()));
+    }
+    double plateMaximum = maximum;
+    MPI_Allreduce(&maximum, &plateMaximum, 1, MPI_DOUBLE, MPI_MAX, cartesian);
+    return plateMaximum;
+}
+
+std::vector<double> DistributedSolver::gatherPlate(int root) const{
+    // every block sends its inner points packed, root places them by the coordinates of the block
+    const int bx = blockSizeX();
+    const int by = blockSizeY();
+    std::vector<double> packed(static_cast<size_t>(bx) * by);
+    for (int y = 0; y < by; ++y){
+        const double *row = block.temperatureRow(y + 1) + 1;
+        std::copy(row, row + bx, packed.begin() + static_cast<size_t>(y) * bx);
+    }
+
+    std::vector<int> counts, displacements;
+    std::vector<double> blocks;
+    if (rank == root){
+        counts.resize(ranks);
+        displacements.resize(ranks);
+        int offset = 0;
+        for (int r = 0; r < ranks; ++r){
+            int coords[2], x0, y0, sx, sy;
+            MPI_Cart_coords(cartesian, r, 2, coords);
+            blockOrigin(coords[1], coords[0], &x0, &y0, &sx, &sy);
+            counts[r] = sx * sy;
+            displacements[r] = offset;
+            offset += counts[r];
+        }
+        blocks.resize(offset);
+    }
+    MPI_Gatherv(packed.data(), bx * by, MPI_DOUBLE, blocks.data(), counts.data(), displacements.data(),
+                MPI_DOUBLE, root, cartesian);
+    if (rank != root) return {};
+
+    std::vector<double> plate(static_cast<size_t>(plateSizeX) * plateSizeY, HeatSolver::outsideTemperature);
+    for (int r = 0; r < ranks; ++r){
+        int coords[2], x0, y0, sx, sy;
+        MPI_Cart_coords(cartesian, r, 2, coords);
+        blockOrigin(coords[1], coords[0], &x0, &y0, &sx, &sy);
+        for (int y = 0; y < sy; ++y){
+            const double *source = blocks.data() + displacements[r] + static_cast<size_t>(y) * sx;
+            std::copy(source, source + sx, plate.begin() + static_cast<size_t>(y0 + 1 + y) * plateSizeX + x0 + 1);
+        }
+    }
+    return plate;
+}
@@ -0,0 +1,115 @@
+#ifndef DISTRIBUTEDSOLVER_H
+#define DISTRIBUTEDSOLVER_H
+
+/* The explicit steps of one plate split into 2D blocks over the ranks of an MPI
+ * communicator, for plates larger than the caches and cores of one machine.
+ * Every rank steps its block with a HeatSolver of its own, one point larger on
+ * every side: the border points 0 and size-1 the solver never steps are the halos,
+ * the points of the neighbour blocks, and at the edges of the plate they are its
+ * constant border as in a single solver. Every step the edge rows and columns of
+ * the previous state are sent to the neighbours with non-blocking sends and their
+ * halos received straight into the border of the previous state (the columns with
+ * a strided datatype, nothing is packed); the inside of the block, which does not
+ * read the halos, is stepped while they travel, the edge rows and columns after.
+ * The heater is pointwise and needs no halo, the burner power is spread over the
+ * burner points of all the blocks. The result is the one of a single solver. */
+
+// MPI
+#include <mpi.h>
+
+// C++ libs
+#include <vector>
+
+#include "heatsolver.h"
+
+//______________________________________________Distributed Solver________________//
+class DistributedSolver{
+public:
+    // collective over communicator: the plate of sizeX*sizeY points, border included
+    DistributedSolver(MPI_Comm communicator, int sizeX, int sizeY);
+
+    ~DistributedSolver();
+
+    DistributedSolver(const DistributedSolver &) = delete;
+
+    DistributedSolver &operator=(const DistributedSolver &) = delete;
+
+    // the size of the whole plate
+    int sizeX() const { return plateSizeX; }
+
+    int sizeY() const { return plateSizeY; }
+
+    int getRank() const { return rank; }
+
+    int getRanks() const { return ranks; }
+
+    // blocks of the plate in x and y
+    int getGridX() const { return gridX; }
+
+    int getGridY() const { return gridY; }
+
+    // the points stepped by this rank
+    int blockSizeX() const { return block.sizeX() - 2; }
+
+    int blockSizeY() const { return block.sizeY() - 2; }
+
+    // parameters, the same on every rank
+    void setAlpha(double alpha) { block.setAlpha(alpha); }
+
+    void setWatts(int watts) { block.setWatts(watts); }
+
+    void setBurner(bool status) { block.setBurner(status); }
+
+    void setKernelIsa(KernelIsa isa) { block.setKernelIsa(isa); }
+
+    KernelIsa getKernelIsa() const { return block.getKernelIsa(); }
+
+    double getTimeStep() const { return block.getTimeStep(); }
+
+    // a disc in the coordinates of the whole plate, every rank keeps its part of it
+    void setBurnerDisc(int centerX, int centerY, int diameter, bool status);
+
+    // collective: the power follows the burner points of all the blocks
+    void countBurnerPixels();
+
+    int getNumberOfBurnerPixels() const { return burnerPixels; }
+
+    // collective
+    void calcHeatingSteps(int steps);
+
+    long long getCurrentStep() const { return block.getCurrentStep(); }
+
+    double getSimulatedTime() const { return block.getSimulatedTime(); }
+
+    // seconds this rank waited for its halos, over all the steps
+    double getExchangeWaitSeconds() const { return exchangeWaitSeconds; }
+
+    // bytes this rank sends every step
+    long long haloBytesPerStep() const;
+
+    // collective
+    double maxTemperature() const;
+
+    // collective: the whole plate row by row (sizeX*sizeY points) on root, empty on the other ranks
+    std::vector<double> gatherPlate(int root = 0) const;
+
+private:
+    void blockOrigin(int coordX, int coordY, int *originX, int *originY, int *blockX, int *blockY) const;
+
+    MPI_Comm cartesian = MPI_COMM_NULL;
+    int rank = 0;
+    int ranks = 1;
+    int gridX = 1, gridY = 1;
+    int coordX = 0, coordY = 0;
+    int north = MPI_PROC_NULL, south = MPI_PROC_NULL;   // y - 1, y + 1
+    int west = MPI_PROC_NULL, east = MPI_PROC_NULL;     // x - 1, x + 1
+    MPI_Datatype columnType = MPI_DATATYPE_NULL;       // the inner points of a column of the block
+
+    int plateSizeX = 0, plateSizeY = 0;
+    int originX = 0, originY = 0;    // the point of the plate at the halo corner (0, 0) of the block
+    HeatSolver block;
+    int burnerPixels = 0;
+    double exchangeWaitSeconds = 0;
+};
+
+#endif // DISTRIBUTEDSOLVER_H
@@ -0,0 +1,376 @@
+#include "framerecorder.h"
+
+// C++ libs
+#include <algorithm>
+#include <cstring>
+
+namespace {
+const char recordingMagic[8] = {'S', 'T', 'O', 'V', 'E', 'R', 'E', 'C'};
+const char indexMagic[8] = {'S', 'T', 'O', 'V', 'E', 'I', 'D', 'X'};
+const quint32 frameMagic = 0x4d415246;    // "FRAM"
+const quint32 byteOrderMark = 0x01020304;
+const quint32 recordingVersion = 1;
+
+struct RecordingHeader{
+    char magic[8];
+    quint32 version;
+    quint32 headerBytes;
+    quint32 byteOrder;
+    qint32 sizeX, sizeY;
+    qint32 tileCountX, tileCountY;
+    qint32 keyframeInterval;
+    double cadence;
+};
+
+// before the compressed payload of every frame: the active tiles, then the planes of the (delta) bits
+struct FrameRecordHeader{
+    quint32 magic;
+    quint32 compressedBytes;
+    qint32 keyframe;
+    qint32 reserved;
+    qint64 step;
+    double simulatedTime;
+    double ambientTemperature;
+};
+
+struct RecordingFooter{
+    quint64 indexOffset;
+    quint64 frameCount;
+    char magic[8];
+};
+
+template <typename T>
+T readStruct(const uchar *data){
+    // the records are packed one after the other, not aligned
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return value;
+}
+}
+
+
+
+//______________________________________________Frame Recorder________________//
+FrameRecorder::~FrameRecorder(){
+    stop();
+}
+
+bool FrameRecorder::start(const QString &fileName, double newCadence, QString *errorOut){
+    stop();
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)){
+        if (errorOut) *errorOut = "Can not write " + fileName + ": " + file.errorString();
+        return false;
+    }
+    headerWritten = false;
+    index.clear();
+    recordedFrames.store(0, std::memory_order_relaxed);
+    droppedFrames.store(0, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        head = 0;
+        count = 0;
+        cadence = std::max(0., newCadence);
+        firstFrame = true;
+        error.clear();
+        recording.store(true, std::memory_order_relaxed);
+    }
+    writer = std::thread(&FrameRecorder::writeFrames, this);
+    return true;
+}
+
+void FrameRecorder::stop(){
+    if (!writer.joinable()) return;
+    {
+        // a frame being copied into the queue is still written
+        std::lock_guard<std::mutex> lock(mutex);
+        recording.store(false, std::memory_order_relaxed);
+    }
+    condition.notify_all();
+    writer.join();
+
+    // the index of the frames and where it starts, the last bytes of the file
+    if (headerWritten){
+        RecordingFooter footer;
+        footer.indexOffset = static_cast<quint64>(file.pos());
+        footer.frameCount = static_cast<quint64>(index.size());
+        std::memcpy(footer.magic, indexMagic, sizeof(footer.magic));
+        file.write(reinterpret_cast<const char *>(index.constData()), index.size() * static_cast<qint64>(sizeof(RecordedFrameEntry)));
+        file.write(reinterpret_cast<const char *>(&footer), sizeof(footer));
+    }
+    file.close();
+}
+
+void FrameRecorder::recordFrame(const SimulationFrame &frame){
+    if (!recording.load(std::memory_order_relaxed)) return;
+    int slot;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!recording.load(std::memory_order_relaxed)) return;
+        if (!firstFrame && frame.simulatedTime < nextFrameTime) return;
+        if (count == queueCapacity){
+            droppedFrames.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        // on the cadence, without catching up on the frames that were not due
+        nextFrameTime = firstFrame ? frame.simulatedTime : nextFrameTime;
+        while (nextFrameTime <= frame.simulatedTime && cadence > 0) nextFrameTime += cadence;
+        firstFrame = false;
+        slot = (head + count) % queueCapacity;
+        copying = true;
+    }
+    // the writer never reads a slot before it is counted, the vectors keep their size
+    queue[slot] = frame;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        copying = false;
+        ++count;
+    }
+    condition.notify_all();
+}
+
+QString FrameRecorder::errorString() const{
+    std::lock_guard<std::mutex> lock(mutex);
+    return error;
+}
+
+void FrameRecorder::writeFrames(){
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;){
+        condition.wait(lock, [this](){
+            return count > 0 || (!recording.load(std::memory_order_relaxed) && !copying);
+        });
+        if (count == 0) break;
+        SimulationFrame &frame = queue[head];
+        const bool failed = !error.isEmpty();
+        lock.unlock();
+        // after a failed write the queue is only emptied
+        const bool written = failed || writeFrame(frame);
+        lock.lock();
+        if (!written) error = "Can not write " + file.fileName() + ": " + file.errorString();
+        head = (head + 1) % queueCapacity;
+        --count;
+    }
+}
+
+bool FrameRecorder::writeFrame(SimulationFrame &frame){
+    if (!headerWritten){
+        sizeX = frame.sizeX;
+        sizeY = frame.sizeY;
+        tileCountX = frame.tileCountX;
+        tileCountY = frame.tileCountY;
+        RecordingHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, recordingMagic, sizeof(header.magic));
+        header.version = recordingVersion;
+        header.headerBytes = sizeof(RecordingHeader);
+        header.byteOrder = byteOrderMark;
+        header.sizeX = sizeX;
+        header.sizeY = sizeY;
+        header.tileCountX = tileCountX;
+        header.tileCountY = tileCountY;
+        header.keyframeInterval = keyframeInterval;
+        header.cadence = cadence;
+        if (file.write(reinterpret_cast<const char *>(&header), sizeof(header)) != sizeof(header)) return false;
+        headerWritten = true;
+    }
+    // the plate does not change size while the simulation runs, a frame of another size is not recorded
+    if (frame.sizeX != sizeX || frame.sizeY != sizeY){
+        droppedFrames.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // float bits of the plate, the inactive tiles at the ambient temperature
+    const size_t points = static_cast<size_t>(sizeX) * sizeY;
+    const int tileSize = HeatSolver::tileSize;
+    const float ambient = static_cast<float>(frame.ambientTemperature);
+    bits.resize(points);
+    for (int y = 0; y < sizeY; ++y){
+        const double *row = frame.temperatureRow(y);
+        uint32_t *out = bits.data() + static_cast<size_t>(y) * sizeX;
+        for (int tileX = 0; tileX < tileCountX; ++tileX){
+            const bool active = frame.isTileActive(tileX, y / tileSize);
+            const int xMax = std::min(sizeX, (tileX + 1) * tileSize);
+            for (int x = tileX * tileSize; x < xMax; ++x){
+                const float value = active ? static_cast<float>(row[x]) : ambient;
+                std::memcpy(out + x, &value, sizeof(value));
+            }
+        }
+    }
+
+    // the active tiles, then byte plane b holds byte b of every point
+    const bool keyframe = index.size() % keyframeInterval == 0;
+    const size_t tiles = static_cast<size_t>(tileCountX) * tileCountY;
+    payload.resize(static_cast<int>(tiles + 4 * points));
+    uchar *out = reinterpret_cast<uchar *>(payload.data());
+    std::memcpy(out, frame.activeTiles.data(), tiles);
+    uchar *planes = out + tiles;
+    previousBits.resize(points, 0);
+    for (size_t i = 0; i < points; ++i){
+        const uint32_t delta = keyframe ? bits[i] : bits[i] ^ previousBits[i];
+        planes[i] = static_cast<uchar>(delta);
+        planes[points + i] = static_cast<uchar>(delta >> 8);
+        planes[2*points + i] = static_cast<uchar>(delta >> 16);
+        planes[3*points + i] = static_cast<uchar>(delta >> 24);
+    }
+    previousBits.swap(bits);
+    // the fastest level: the writer has to keep up with the cadence
+    const QByteArray compressed = qCompress(payload, 1);
+
+    FrameRecordHeader record;
+    std::memset(&record, 0, sizeof(record));
+    record.magic = frameMagic;
+    record.compressedBytes = static_cast<quint32>(compressed.size());
+    record.keyframe = keyframe;
+    record.step = frame.step;
+    record.simulatedTime = frame.simulatedTime;
+    record.ambientTemperature = frame.ambientTemperature;
+    RecordedFrameEntry entry;
+    entry.offset = static_cast<quint64>(file.pos());
+    entry.step = frame.step;
+    entry.simulatedTime = frame.simulatedTime;
+    entry.keyframe = keyframe;
+    if (file.write(reinterpret_cast<const char *>(&record), sizeof(record)) != sizeof(record)
+            || file.write(compressed) != compressed.size()){
+        return false;
+    }
+    index.push_back(entry);
+    recordedFrames.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+
+
+//______________________________________________Frame Player________________//
+bool FramePlayer::open(const QString &fileName, QString *error){
+    close();
+    auto fail = [this, error](const QString &message){
+        if (error) *error = message;
+        close();
+        return false;
+    };
+    file = std::make_unique<QFile>(fileName);
+    if (!file->open(QIODevice::ReadOnly)) return fail("Can not open " + fileName + ": " + file->errorString());
+    bytes = file->size();
+    if (bytes < static_cast<qint64>(sizeof(RecordingHeader))) return fail(fileName + " is not a recording");
+    data = file->map(0, bytes);
+    if (!data) return fail("Can not map " + fileName + ": " + file->errorString());
+
+    const RecordingHeader header = readStruct<RecordingHeader>(data);
+    if (std::memcmp(header.magic, recordingMagic, sizeof(header.magic)) != 0) return fail(fileName + " is not a recording");
+    if (header.version != recordingVersion || header.headerBytes != sizeof(RecordingHeader)
+            || header.byteOrder != byteOrderMark){
+        return fail(fileName + " was written by an incompatible version");
+    }
+    const int tileSize = HeatSolver::tileSize;
+    if (header.sizeX < 1 || header.sizeY < 1 || header.tileCountX != (header.sizeX + tileSize - 1) / tileSize
+            || header.tileCountY != (header.sizeY + tileSize - 1) / tileSize){
+        return fail(fileName + " is damaged");
+    }
+    sizeX = header.sizeX;
+    sizeY = header.sizeY;
+    tileCountX = header.tileCountX;
+    tileCountY = header.tileCountY;
+
+    // the index written when the recording was closed, or the frames as far as they are complete
+    bool indexed = false;
+    if (bytes >= static_cast<qint64>(sizeof(RecordingHeader) + sizeof(RecordingFooter))){
+        const RecordingFooter footer = readStruct<RecordingFooter>(data + bytes - sizeof(RecordingFooter));
+        const quint64 indexBytes = footer.frameCount * sizeof(RecordedFrameEntry);
+        if (std::memcmp(footer.magic, indexMagic, sizeof(footer.magic)) == 0 && footer.indexOffset >= sizeof(RecordingHeader)
+                && footer.indexOffset + indexBytes + sizeof(RecordingFooter) == static_cast<quint64>(bytes)){
+            index.resize(static_cast<int>(footer.frameCount));
+            std::memcpy(index.data(), data + footer.indexOffset, indexBytes);
+            indexed = true;
+        }
+    }
+    if (!indexed) rebuildIndex();
+    if (index.isEmpty()) return fail(fileName + " holds no frame");
+    return true;
+}
+
+void FramePlayer::close(){
+    // closing the file unmaps it
+    if (file) file->close();
+    file.reset();
+    data = nullptr;
+    bytes = 0;
+    index.clear();
+    decodedFrame = -1;
+}
+
+bool FramePlayer::rebuildIndex(){
+    // the frames of a recording that was not closed, up to the first incomplete one
+    index.clear();
+    qint64 offset = sizeof(RecordingHeader);
+    while (offset + static_cast<qint64>(sizeof(FrameRecordHeader)) <= bytes){
+        const FrameRecordHeader record = readStruct<FrameRecordHeader>(data + offset);
+        const qint64 end = offset + static_cast<qint64>(sizeof(FrameRecordHeader)) + record.compressedBytes;
+        if (record.magic != frameMagic || end > bytes) break;
+        RecordedFrameEntry entry;
+        entry.offset = static_cast<quint64>(offset);
+        entry.step = record.step;
+        entry.simulatedTime = record.simulatedTime;
+        entry.keyframe = record.keyframe;
+        index.push_back(entry);
+        offset = end;
+    }
+    return !index.isEmpty();
+}
+
+bool FramePlayer::decodeFrame(int i){
+    const quint64 offset = index[i].offset;
+    if (offset + sizeof(FrameRecordHeader) > static_cast<quint64>(bytes)) return false;
+    const FrameRecordHeader record = readStruct<FrameRecordHeader>(data + offset);
+    if (record.magic != frameMagic || offset + sizeof(FrameRecordHeader) + record.compressedBytes > static_cast<quint64>(bytes)){
+        return false;
+    }
+    // straight from the mapping
+    const QByteArray payload = qUncompress(data + offset + sizeof(FrameRecordHeader), static_cast<int>(record.compressedBytes));
+    const size_t points = static_cast<size_t>(sizeX) * sizeY;
+    const size_t tiles = static_cast<size_t>(tileCountX) * tileCountY;
+    if (static_cast<size_t>(payload.size()) != tiles + 4 * points) return false;
+
+    const uchar *in = reinterpret_cast<const uchar *>(payload.constData());
+    activeTiles.assign(in, in + tiles);
+    const uchar *planes = in + tiles;
+    bits.resize(points, 0);
+    for (size_t p = 0; p < points; ++p){
+        const uint32_t delta = planes[p] | uint32_t(planes[points + p]) << 8
+                | uint32_t(planes[2*points + p]) << 16 | uint32_t(planes[3*points + p]) << 24;
+        bits[p] = record.keyframe ? delta : bits[p] ^ delta;
+    }
+    ambientTemperature = record.ambientTemperature;
+    return true;
+}
+
+bool FramePlayer::readFrame(int i, SimulationFrame &frame){
+    if (!isOpen() || i < 0 || i >= index.size()) return false;
+    // from the keyframe before it, unless the last frame read is on the way
+    int first = i;
+    while (first > 0 && !index[first].keyframe) --first;
+    if (decodedFrame >= first && decodedFrame <= i) first = decodedFrame + 1;
+    for (int j = first; j <= i; ++j){
+        if (!decodeFrame(j)){
+            decodedFrame = -1;
+            return false;
+        }
+    }
+    decodedFrame = i;
+
+    frame.sizeX = sizeX;
+    frame.sizeY = sizeY;
+    frame.tileCountX = tileCountX;
+    frame.tileCountY = tileCountY;
+    frame.temperatures.resize(bits.size());
+    for (size_t p = 0; p < bits.size(); ++p){
+        float value;
+        std::memcpy(&value, &bits[p], sizeof(value));
+        frame.temperatures[p] = value;
+    }
+    frame.activeTiles = activeTiles;
+    frame.ambientTemperature = ambientTemperature;
+    frame.step = index[i].step;
+    frame.simulatedTime = index[i].simulatedTime;
+    return true;
+}
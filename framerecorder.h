@@ -0,0 +1,134 @@
+#ifndef FRAMERECORDER_H
+#define FRAMERECORDER_H
+
+/* Recording of the frames of a run, and their playback without the solver.
+ * The simulation thread hands its frames to the recorder, which keeps one every
+ * cadence seconds of simulated time in a small queue; a writer thread encodes and
+ * appends them to the file. The queue is bounded and never waited for: a frame
+ * arriving while it is full is dropped (and counted), the stepping goes on.
+ * A frame is stored in float precision, the inactive tiles at the ambient
+ * temperature: every keyframeInterval-th frame as it is, the others as the XOR of
+ * their bits with the previous frame, so the unchanged points are zeros; the bytes
+ * are grouped by significance (all the first bytes, then the second...) before
+ * qCompress, as the high bytes of neighbouring points are alike. An index of the
+ * frames closes the file; the player rebuilds it from the frames if a recording was
+ * not closed. The player maps the file and decodes a frame from the keyframe before
+ * it, or forward from the last frame read, so scrubbing never runs the solver.
+ * The numbers are stored as in memory (native byte order), like the checkpoints. */
+
+// Qt files
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+// C++ libs
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "simulationthread.h"
+
+// where a frame starts in the recording and when it was simulated
+struct RecordedFrameEntry{
+    quint64 offset = 0;
+    qint64 step = 0;
+    double simulatedTime = 0;
+    qint32 keyframe = 0;
+    qint32 reserved = 0;
+};
+
+//______________________________________________Frame Recorder________________//
+class FrameRecorder{
+public:
+    ~FrameRecorder();
+
+    // starts a recording, one frame every cadence seconds of simulated time (0 - every frame handed over)
+    bool start(const QString &fileName, double cadence, QString *error = nullptr);
+
+    // writes the frames left in the queue and the index, then closes the file
+    void stop();
+
+    bool isRecording() const { return recording.load(std::memory_order_relaxed); }
+
+    // simulation thread: queues a copy of the frame if it is due, never waits
+    void recordFrame(const SimulationFrame &frame);
+
+    long long getRecordedFrames() const { return recordedFrames.load(std::memory_order_relaxed); }
+
+    long long getDroppedFrames() const { return droppedFrames.load(std::memory_order_relaxed); }
+
+    QString errorString() const;
+
+    static constexpr int queueCapacity = 8;
+    static constexpr int keyframeInterval = 16;
+
+private:
+    void writeFrames();
+
+    bool writeFrame(SimulationFrame &frame);
+
+    std::atomic<bool> recording{false};
+    std::atomic<long long> recordedFrames{0};
+    std::atomic<long long> droppedFrames{0};
+
+    // the queue: count frames from head, a slot is reserved by the simulation thread while it copies into it
+    mutable std::mutex mutex;
+    std::condition_variable condition;
+    SimulationFrame queue[queueCapacity];
+    int head = 0;
+    int count = 0;
+    bool copying = false;
+    double cadence = 0;
+    double nextFrameTime = 0;
+    bool firstFrame = true;
+
+    // writer thread only
+    std::thread writer;
+    QFile file;
+    QString error;                     // guarded by mutex
+    bool headerWritten = false;
+    int sizeX = 0, sizeY = 0, tileCountX = 0, tileCountY = 0;
+    std::vector<uint32_t> previousBits;
+    std::vector<uint32_t> bits;
+    QByteArray payload;
+    QVector<RecordedFrameEntry> index;
+};
+
+//______________________________________________Frame Player________________//
+class FramePlayer{
+public:
+    bool open(const QString &fileName, QString *error = nullptr);
+
+    void close();
+
+    bool isOpen() const { return data != nullptr; }
+
+    int frameCount() const { return index.size(); }
+
+    double frameTime(int frame) const { return index[frame].simulatedTime; }
+
+    // decodes frame i into frame, from the keyframe before it or forward from the last one read
+    bool readFrame(int i, SimulationFrame &frame);
+
+private:
+    bool rebuildIndex();
+
+    bool decodeFrame(int i);
+
+    std::unique_ptr<QFile> file;
+    const uchar *data = nullptr;
+    qint64 bytes = 0;
+    int sizeX = 0, sizeY = 0, tileCountX = 0, tileCountY = 0;
+    QVector<RecordedFrameEntry> index;
+
+    // the last frame decoded
+    int decodedFrame = -1;
+    std::vector<uint32_t> bits;
+    std::vector<char> activeTiles;
+    double ambientTemperature = 0;
+};
+
+#endif // FRAMERECORDER_H
@@ -0,0 +1,1371 @@
+#include "heatsolver.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "profiler.h"
+
+namespace {
+// the x for which a*x + b is in lo..hi, a line of x if a is 0; false if there is none
+bool linearRange(double a, double b, double lo, double hi, double *xMin, double *xMax){
+    if (a == 0){
+        *xMin = -std::numeric_limits<double>::infinity();
+        *xMax = std::numeric_limits<double>::infinity();
+        return b >= lo && b <= hi;
+    }
+    const double x0 = (lo - b) / a;
+    const double x1 = (hi - b) / a;
+    *xMin = std::min(x0, x1);
+    *xMax = std::max(x0, x1);
+    return true;
+}
+}
+
+HeatSolver::HeatSolver(int sizeX, int sizeY){
+    resize(sizeX, sizeY);
+    updateTimeStep();
+}
+
+void HeatSolver::resize(int newSizeX, int newSizeY){
+    temperatureMapSizeX = std::max(3, newSizeX);
+    temperatureMapSizeY = std::max(3, newSizeY);
+    temperatureMapStride = PlateGrid<double>::paddedStride(temperatureMapSizeX);
+    tileCountX = (temperatureMapSizeX + tileSize - 1) / tileSize;
+    tileCountY = (temperatureMapSizeY + tileSize - 1) / tileSize;
+    clearBurnerMap();
+    resetTemperatureMapLayers();
+}
+
+
+
+/*                                              PARAMETERS                         */
+void HeatSolver::setAlpha(double newAlpha){
+    alpha = newAlpha;
+    updateTimeStep();
+}
+
+void HeatSolver::setWatts(int newW){
+    W = newW;
+    updatePower();
+}
+
+void HeatSolver::setBurner(bool status){
+    burnerOn = status;
+}
+
+void HeatSolver::updatePower(){
+    const int pixels = powerPixels > 0 ? powerPixels : numberOfBurnerPixels;
+    if (pixels == 0) return;
+    // convert watts/hour into watts/second and then to temperature increase per second
+    // volHeatCapCu indicates how much energy is needed to increase the temperature of
+    // 1 mm^3 of Cu by 1 K, our volume is number of pixels * size of one pixel
+    power = W/3600. / (pixels*xStep*yStep*burnerSizeZ * volHeatCapCu);
+}
+
+void HeatSolver::setPowerPixels(int pixels){
+    powerPixels = std::max(0, pixels);
+    updatePower();
+}
+
+void HeatSolver::updateTimeStep(){
+    // time step is calc from simulation parameters (stability limit of the explicit scheme),
+    // but it can not be larger than maxTimeStep (for the GUI - the screen update time step);
+    // the implicit integrators are stable for any step, it is only limited by accuracy;
+    // RKC starts from the explicit limit and then picks its steps from the local error.
+    // The centre coefficient 1 - 2*(cx + cy + cz) must not go negative: the z term (heater
+    // and air) counts as much as x and y; the layered plate solves z implicitly, only x and y bound it
+    const double zTerm = plateLayers == 1 ? 1./(zStep*zStep) : 0.;
+    double limit = 1. / (2. * alpha * (1./(xStep*xStep) + 1./(yStep*yStep) + zTerm));
+    if (plateLayers == 1 && (integrator == Integrator::ADI || integrator == Integrator::Multigrid)) limit *= timeStepFactor;
+    timeStep = std::min(maxTimeStep, limit);
+    rkcSolver.reset(timeStep);
+}
+
+void HeatSolver::setIntegrator(Integrator newIntegrator){
+    integrator = newIntegrator;
+    updateTimeStep();
+}
+
+void HeatSolver::setTimeStepFactor(double factor){
+    timeStepFactor = std::max(1., factor);
+    updateTimeStep();
+}
+
+void HeatSolver::setMultigridTolerance(double newTolerance){
+    multigridSolver.setTolerance(newTolerance);
+}
+
+void HeatSolver::setAdaptiveTolerance(double newTolerance){
+    rkcSolver.setTolerance(newTolerance);
+}
+
+void HeatSolver::setMaxTimeStep(double newMaxTimeStep){
+    maxTimeStep = newMaxTimeStep;
+    updateTimeStep();
+}
+
+int HeatSolver::stepsPerPeriod(double periodSeconds) const{
+    return static_cast<int>(periodSeconds / timeStep);
+}
+
+void HeatSolver::setPlateLayers(int layers){
+    layers = std::max(1, std::min(maxPlateLayers, layers));
+    if (layers == plateLayers) return;
+    plateLayers = layers;
+    // every layer starts at the temperature of the plate as it is
+    if (plateLayers > 1) fillPlateLayers();
+    updateTimeStep();
+}
+
+void HeatSolver::setNumberOfThreads(int newThreads){
+    // the pool is only rebuilt when the number of threads changes
+    if (newThreads == getNumberOfThreads()) return;
+    workerPool.reset();
+    if (newThreads > 1) workerPool = std::make_unique<WorkerPool>(newThreads);
+}
+
+
+
+/*                                              BURNER MAP                         */
+void BurnerBounds::add(int x0, int y0, int x1, int y1){
+    if (x0 >= x1 || y0 >= y1) return;
+    if (isEmpty()){
+        xMin = x0; yMin = y0;
+        xMax = x1; yMax = y1;
+        return;
+    }
+    xMin = std::min(xMin, x0); yMin = std::min(yMin, y0);
+    xMax = std::max(xMax, x1); yMax = std::max(yMax, y1);
+}
+
+void HeatSolver::clearBurnerMap(){
+    // the bits follow the layout of the layers, the padding is never set
+    const size_t cells = static_cast<size_t>(temperatureMapStride) * temperatureMapSizeY;
+    burnerMap.assign((cells + 63) / 64, 0);
+    numberOfBurnerPixels = 0;
+    // the whole plate, the box of a plate of another size is not kept
+    burnerDirty = BurnerBounds();
+    burnerDirty.add(0, 0, temperatureMapSizeX, temperatureMapSizeY);
+}
+
+void HeatSolver::setBurnerBit(int i, bool status){
+    // the number of burner pixels follows every change of the mask
+    uint64_t &word = burnerMap[static_cast<size_t>(i) >> 6];
+    const uint64_t bit = uint64_t(1) << (i & 63);
+    if (((word & bit) != 0) == status) return;
+    word ^= bit;
+    numberOfBurnerPixels += status ? 1 : -1;
+}
+
+void HeatSolver::setBurnerCell(int x, int y, bool status){
+    if (x < 0 || y < 0 || x >= temperatureMapSizeX || y >= temperatureMapSizeY) return;
+    if (isBurnerCell(x, y) == status) return;
+    setBurnerBit(index(x, y), status);
+    burnerDirty.add(x, y, x + 1, y + 1);
+}
+
+void HeatSolver::setBurnerSpan(int y, int xMin, int xMax, bool status){
+    // up to 64 points per word at once, the count follows the bits that flip
+    if (xMin >= xMax) return;
+    size_t i = static_cast<size_t>(index(xMin, y));
+    const size_t end = static_cast<size_t>(index(xMax, y));
+    bool changed = false;
+    while (i < end){
+        const int bit = static_cast<int>(i & 63);
+        const size_t count = std::min<size_t>(64 - bit, end - i);
+        const uint64_t mask = (count == 64 ? ~uint64_t(0) : (uint64_t(1) << count) - 1) << bit;
+        uint64_t &word = burnerMap[i >> 6];
+        const uint64_t flipped = (status ? ~word : word) & mask;
+        if (flipped){
+            const int flips = __builtin_popcountll(flipped);
+            word ^= flipped;
+            numberOfBurnerPixels += status ? flips : -flips;
+            changed = true;
+        }
+        i += count;
+    }
+    if (changed) burnerDirty.add(xMin, y, xMax, y + 1);
+}
+
+void HeatSolver::setBurnerDisc(int centerX, int centerY, int diameter, bool status){
+    /* some specific math to define a circle of diameter penWidth
+     * and fill the burnerMap with status within this circle */
+    int radius = diameter / 2;
+    int yMin = std::max(0, centerY - radius);
+    int yMax = std::min(temperatureMapSizeY, centerY + radius);
+
+    for (int y = yMin; y < yMax; ++y){
+        int offset = static_cast<int>(std::sqrt(radius*radius - (y - centerY)*(y - centerY)));
+        int xMin = std::max(0, centerX - offset);
+        int xMax = std::min(temperatureMapSizeX, centerX + offset);
+        setBurnerSpan(y, xMin, xMax, status);
+    }
+}
+
+void HeatSolver::setBurnerCapsule(int x0, int y0, int x1, int y1, int diameter, bool status){
+    /* every row of a capsule is one span (it is convex): the union of the spans of the two
+     * caps and of the band, the points whose projection falls on the segment and whose
+     * distance from its line is at most the radius, two linear conditions in x */
+    if (diameter <= 0) return;
+    const double radius = diameter / 2.;
+    if (capsuleDiameter != diameter){
+        capsuleDiameter = diameter;
+        capsuleSpans.resize(static_cast<size_t>(radius) + 1);
+        for (size_t dy = 0; dy < capsuleSpans.size(); ++dy){
+            capsuleSpans[dy] = static_cast<int>(std::sqrt(radius*radius - static_cast<double>(dy*dy)) + 1e-9);
+        }
+    }
+    const int reach = static_cast<int>(capsuleSpans.size()) - 1;
+    const double dx = x1 - x0;
+    const double dy = y1 - y0;
+    const double lengthSquared = dx*dx + dy*dy;
+    const double band = radius * std::sqrt(lengthSquared);
+
+    const int yMin = std::max(0, std::min(y0, y1) - reach);
+    const int yMax = std::min(temperatureMapSizeY - 1, std::max(y0, y1) + reach);
+    for (int y = yMin; y <= yMax; ++y){
+        int xMin = std::numeric_limits<int>::max();
+        int xMax = std::numeric_limits<int>::min();
+        for (int end = 0; end < 2; ++end){
+            const int cx = end ? x1 : x0;
+            const int rows = std::abs(y - (end ? y1 : y0));
+            if (rows > reach) continue;
+            xMin = std::min(xMin, cx - capsuleSpans[rows]);
+            xMax = std::max(xMax, cx + capsuleSpans[rows]);
+        }
+        if (lengthSquared > 0){
+            // projection (x-x0)*dx + (y-y0)*dy in 0..length^2, cross (x-x0)*dy - (y-y0)*dx in -band..band
+            double alongMin, alongMax, acrossMin, acrossMax;
+            const bool along = linearRange(dx, (y - y0)*dy - x0*dx, 0, lengthSquared, &alongMin, &alongMax);
+            const bool across = linearRange(dy, -(y - y0)*dx - x0*dy, -band, band, &acrossMin, &acrossMax);
+            const double bandMin = std::ceil(std::max(alongMin, acrossMin) - 1e-9);
+            const double bandMax = std::floor(std::min(alongMax, acrossMax) + 1e-9);
+            if (along && across && bandMin <= bandMax){
+                xMin = std::min(xMin, static_cast<int>(bandMin));
+                xMax = std::max(xMax, static_cast<int>(bandMax));
+            }
+        }
+        setBurnerSpan(y, std::max(0, xMin), std::min(temperatureMapSizeX, xMax + 1), status);
+    }
+}
+
+void HeatSolver::countBurnerPixels(){
+    // the count is kept up to date by the changes of the mask, only the power follows it here
+    updatePower();
+}
+
+void HeatSolver::updateBurnerCells(){
+    /* the burner points as a sorted list of indices, with the start of every row in it,
+     * so the heater is only updated where it is; after the mask is changed the rows of the
+     * tiles under the changed box are scanned again and spliced in, the others are kept */
+    if (burnerDirty.isEmpty()) return;
+    const int stride = temperatureMapStride;
+    const int ny = temperatureMapSizeY;
+    const size_t tiles = static_cast<size_t>(tileCountX) * tileCountY;
+    if (burnerRowStart.size() != static_cast<size_t>(ny) + 1 || burnerTiles.size() != tiles){
+        burnerCells.clear();
+        burnerRowStart.assign(ny + 1, 0);
+        burnerTiles.assign(tiles, 0);
+        burnerDirty.add(0, 0, temperatureMapSizeX, ny);
+    }
+    const int tileYMin = burnerDirty.yMin / tileSize;
+    const int tileYMax = (burnerDirty.yMax - 1) / tileSize + 1;
+    const int yMin = tileYMin * tileSize;
+    const int yMax = std::min(ny, tileYMax * tileSize);
+    std::fill(burnerTiles.begin() + static_cast<size_t>(tileYMin) * tileCountX,
+              burnerTiles.begin() + static_cast<size_t>(tileYMax) * tileCountX, 0);
+
+    std::vector<int> rows;
+    std::vector<int> rowStart(yMax - yMin + 1, 0);
+    const size_t first = static_cast<size_t>(yMin) * stride;
+    const size_t last = static_cast<size_t>(yMax) * stride;
+    int y = yMin;
+    for (size_t w = first >> 6; w <= (last - 1) >> 6; ++w){
+        // one bit scan per burner point instead of one test per point
+        uint64_t word = burnerMap[w];
+        if (w == first >> 6) word &= ~uint64_t(0) << (first & 63);
+        if (w == (last - 1) >> 6 && (last & 63)) word &= ~uint64_t(0) >> (64 - (last & 63));
+        for (; word != 0; word &= word - 1){
+            const int i = static_cast<int>(w * 64 + __builtin_ctzll(word));
+            while (i >= (y + 1) * stride) rowStart[++y - yMin] = static_cast<int>(rows.size());
+            rows.push_back(i);
+            burnerTiles[tileIndex(i - y * stride, y)] = 1;
+        }
+    }
+    while (y < yMax) rowStart[++y - yMin] = static_cast<int>(rows.size());
+
+    const int oldFirst = burnerRowStart[yMin];
+    const int oldLast = burnerRowStart[yMax];
+    const int shift = static_cast<int>(rows.size()) - (oldLast - oldFirst);
+    burnerCells.erase(burnerCells.begin() + oldFirst, burnerCells.begin() + oldLast);
+    burnerCells.insert(burnerCells.begin() + oldFirst, rows.begin(), rows.end());
+    for (int row = yMin + 1; row <= yMax; ++row) burnerRowStart[row] = oldFirst + rowStart[row - yMin];
+    for (int row = yMax + 1; row <= ny; ++row) burnerRowStart[row] += shift;
+    burnerDirty = BurnerBounds();
+}
+
+double HeatSolver::getDeltaT(int x, int y) const{
+    if (isBurnerCell(x, y)) {
+        return power;
+    }
+    return 0;
+}
+
+
+
+/*                                              SIMULATION                         */
+void HeatSolver::resetTemperatureMapLayers(){
+    /* fill temperature layers for simulation
+     * with outside temperature */
+    for (PlateGrid<double> *layer : {&temperatureMapL0, &temperatureBuffers[0], &temperatureBuffers[1]}){
+        if (layer->sizeX() == temperatureMapSizeX && layer->sizeY() == temperatureMapSizeY) layer->fill(outsideTemperature);
+        else layer->resize(temperatureMapSizeX, temperatureMapSizeY, outsideTemperature);
+    }
+    temperatureMapL2 = temperatureBuffers[0].data();
+    temperatureMapL3 = temperatureBuffers[1].data();
+    currentSimulationStep = 0;
+    simulatedTime = 0;
+    rkcSolver.resetCounters();
+    updateTimeStep();
+    resetActiveTiles();
+    if (plateLayers > 1) fillPlateLayers();
+}
+
+void HeatSolver::restoreState(SolverState state){
+    /* the plate and the heater of the state are used in place, nothing is copied; only
+     * the previous state is allocated, the next step overwrites it */
+    temperatureMapSizeX = state.sizeX;
+    temperatureMapSizeY = state.sizeY;
+    temperatureMapStride = PlateGrid<double>::paddedStride(temperatureMapSizeX);
+    tileCountX = (temperatureMapSizeX + tileSize - 1) / tileSize;
+    tileCountY = (temperatureMapSizeY + tileSize - 1) / tileSize;
+    temperatureMapL0.adopt(state.heater, temperatureMapSizeX, temperatureMapSizeY, state.owner);
+    temperatureBuffers[1].adopt(state.temperatures, temperatureMapSizeX, temperatureMapSizeY, state.owner);
+    PlateGrid<double> &previous = temperatureBuffers[0];
+    if (previous.sizeX() == temperatureMapSizeX && previous.sizeY() == temperatureMapSizeY) previous.fill(outsideTemperature);
+    else previous.resize(temperatureMapSizeX, temperatureMapSizeY, outsideTemperature);
+    temperatureMapL2 = temperatureBuffers[0].data();
+    temperatureMapL3 = temperatureBuffers[1].data();
+
+    burnerMap = std::move(state.burnerMap);
+    numberOfBurnerPixels = 0;
+    for (uint64_t word : burnerMap) numberOfBurnerPixels += __builtin_popcountll(word);
+    burnerDirty = BurnerBounds();
+    burnerDirty.add(0, 0, temperatureMapSizeX, temperatureMapSizeY);
+    activeTiles = std::move(state.activeTiles);
+    ambientTemperature = state.ambientTemperature;
+    currentSimulationStep = state.step;
+    simulatedTime = state.simulatedTime;
+
+    plateLayers = std::max(1, std::min(maxPlateLayers, state.plateLayers));
+    if (plateLayers > 1 && state.layers){
+        // the current layers are used in place, the other buffer gets their constant border points
+        const int rows = temperatureMapSizeY * plateLayers;
+        layerBuffers[0].adopt(state.layers, temperatureMapSizeX, rows, state.owner);
+        PlateGrid<double> &next = layerBuffers[1];
+        if (next.sizeX() != temperatureMapSizeX || next.sizeY() != rows) next.resize(temperatureMapSizeX, rows, outsideTemperature);
+        std::copy(state.layers, state.layers + static_cast<size_t>(temperatureMapStride) * rows, next.data());
+        currentLayers = 0;
+        activateAllTiles();
+    }
+    // a state without its layers: they start at the temperature of the top
+    else if (plateLayers > 1) fillPlateLayers();
+
+    alpha = state.alpha;
+    W = state.watts;
+    burnerOn = state.burnerOn;
+    updatePower();
+    rkcSolver.resetCounters();
+    updateTimeStep();
+    if (state.proposedStep > 0) rkcSolver.reset(state.proposedStep);
+}
+
+void HeatSolver::calcHeatingStep(){
+    updateBurnerCells();
+    lastStepStatistics.valid = false;
+    if (plateLayers > 1){
+        calcLayeredSteps(1);
+        return;
+    }
+    if (integrator == Integrator::RKC){
+        calcAdaptiveStep(maxTimeStep);
+        return;
+    }
+    if (integrator != Integrator::Explicit){
+        calcImplicitStep();
+        return;
+    }
+    if (precision != Precision::Double){
+        calcReducedPrecisionSteps(1);
+        return;
+    }
+    if (activeTileTracking && !steadyStateMonitor){
+        calcActiveTileSteps(1);
+        return;
+    }
+    swapBuffers();
+    if (steadyStateMonitor){
+        StencilRowStats stats;
+        calcStepRows(temperatureMapL2, temperatureMapL3, 0, temperatureMapSizeY, &stats);
+        finishStep();
+        recordStepStatistics(&stats, 1);
+        return;
+    }
+    calcStepRows(0, temperatureMapSizeY);
+    finishStep();
+}
+
+void HeatSolver::calcHeatingSteps(int steps){
+    if (steps <= 0) return;
+    updateBurnerCells();
+    lastStepStatistics.valid = false;
+    if (plateLayers > 1){
+        calcLayeredSteps(steps);
+        return;
+    }
+    if (integrator == Integrator::RKC){
+        for (int i = 0; i < steps; ++i){
+            calcAdaptiveStep(maxTimeStep);
+            if (isInterrupted()) break;
+        }
+        return;
+    }
+    if (integrator != Integrator::Explicit){
+        for (int i = 0; i < steps; ++i){
+            calcImplicitStep();
+            if (isInterrupted()) break;
+        }
+        return;
+    }
+    if (precision != Precision::Double){
+        calcReducedPrecisionSteps(steps);
+        return;
+    }
+    if (temporalBlockSteps > 1 && !steadyStateMonitor){
+        calcHeatingStepsBlocked(steps);
+        return;
+    }
+    if (!workerPool || (activeTileTracking && !steadyStateMonitor)){
+        if (activeTileTracking && !steadyStateMonitor) calcActiveTileSteps(steps);
+        else for (int i = 0; i < steps; ++i){
+            calcHeatingStep();
+            if (isInterrupted()) break;
+        }
+        return;
+    }
+
+    /* every worker owns the same strip of rows for all the steps. Instead of
+     * swapping the shared pointers each worker picks the buffers by the parity
+     * of the step, so one barrier per step is enough: the next step may only
+     * overwrite the previous state when the neighbour strips are done reading it */
+    const int threads = workerPool->size();
+    activateAllTiles();
+    double *previous = temperatureMapL3;
+    double *current = temperatureMapL2;
+    stepsToTake.store(steps, std::memory_order_relaxed);
+    workerStats.resize(threads);
+    auto job = [this, steps, threads, previous, current](int worker){
+        const int yMin = static_cast<int>(static_cast<long long>(temperatureMapSizeY) * worker / threads);
+        const int yMax = static_cast<int>(static_cast<long long>(temperatureMapSizeY) * (worker+1) / threads);
+        // every worker keeps the statistics of its strip for the last step
+        StencilRowStats *stats = steadyStateMonitor ? &workerStats[worker] : nullptr;
+        for (int i = 0; i < steps; ++i){
+            if (stats) *stats = StencilRowStats();
+            if (i % 2 == 0) calcStepRows(previous, current, yMin, yMax, stats);
+            else calcStepRows(current, previous, yMin, yMax, stats);
+            markInterruption(worker, i);
+            {
+                ProfileScope scope(ProfilePhase::Barrier);
+                workerPool->barrier();
+            }
+            if (isLastStep(i)) break;
+        }
+    };
+    workerPool->run(job);
+
+    // the same pointers as after that many calls of swapBuffers
+    const int done = stepsToTake.load(std::memory_order_relaxed);
+    if (done % 2 == 1) swapBuffers();
+
+    currentSimulationStep += done;
+    for (int i = 0; i < done; ++i) simulatedTime += timeStep;
+    if (steadyStateMonitor) recordStepStatistics(workerStats.data(), threads);
+}
+
+void HeatSolver::advanceTime(double seconds){
+    if (seconds <= 0) return;
+    updateBurnerCells();
+    const double target = simulatedTime + seconds;
+    if (integrator == Integrator::RKC && plateLayers == 1){
+        // the last step is cut to the time left, the proposed step is kept for the next call
+        while (target - simulatedTime > 1e-12 * seconds){
+            calcAdaptiveStep(std::min(maxTimeStep, target - simulatedTime));
+            if (isInterrupted()) return;
+        }
+    }
+    else {
+        calcHeatingSteps(static_cast<int>(seconds / timeStep));
+        // interrupted: the time of the whole steps done
+        if (isInterrupted()) return;
+        const double rest = target - simulatedTime;
+        if (rest > 1e-9 * timeStep){
+            // a shorter step is stable for every integrator
+            const double fullStep = timeStep;
+            timeStep = std::min(rest, fullStep);
+            calcHeatingSteps(1);
+            timeStep = fullStep;
+        }
+    }
+    // no rounding error of the summed steps is left behind
+    simulatedTime = target;
+}
+
+void HeatSolver::calcHeaterRows(){
+    // the heater of the whole plate, split over the worker pool
+    updateBurnerCells();
+    const int nx = temperatureMapSizeX;
+    auto heaterJob = [this, nx](int worker){
+        const int threads = getNumberOfThreads();
+        const int yMin = static_cast<int>(static_cast<long long>(temperatureMapSizeY) * worker / threads);
+        const int yMax = static_cast<int>(static_cast<long long>(temperatureMapSizeY) * (worker+1) / threads);
+        for (int y = yMin; y < yMax; ++y){
+            calcHeaterRow(y, temperatureMapL0.row(y), 0, nx);
+        }
+    };
+    if (workerPool) workerPool->run(heaterJob);
+    else heaterJob(0);
+}
+
+void HeatSolver::calcStencilRect(int xMin, int xMax, int yMin, int yMax){
+    // the heater of the rows is already updated, the parts of a step can be done in any order
+    ProfileScope scope(ProfilePhase::Stencil);
+    const int stride = temperatureMapStride;
+    const StencilCoefficients c = stencilCoefficients();
+    xMin = std::max(1, xMin);
+    xMax = std::min(temperatureMapSizeX-1, xMax);
+    if (xMin >= xMax) return;
+    for (int y = std::max(1, yMin); y < std::min(temperatureMapSizeY-1, yMax); ++y){
+        const int i = index(xMin, y);
+        stencilRow(temperatureMapL2 + i - stride, temperatureMapL2 + i, temperatureMapL2 + i + stride,
+                   temperatureMapL0.data() + i, temperatureMapL3 + i, xMax - xMin, c);
+    }
+}
+
+void HeatSolver::calcImplicitStep(){
+    ProfileScope scope(ProfilePhase::Solve);
+    // the heater is explicit as in calcStepRows, then the plate is solved with the new heater
+    swapBuffers();
+    calcHeaterRows();
+
+    if (integrator == Integrator::Multigrid){
+        multigridSolver.step(temperatureMapL2, temperatureMapL3, temperatureMapL0.data(), temperatureMapSizeX,
+                             temperatureMapSizeY, temperatureMapStride, stencilCoefficients(), workerPool.get());
+    } else {
+        adiSolver.step(temperatureMapL2, temperatureMapL3, temperatureMapL0.data(), temperatureMapSizeX,
+                       temperatureMapSizeY, temperatureMapStride, stencilCoefficients(), workerPool.get());
+    }
+    finishStep();
+}
+
+void HeatSolver::calcAdaptiveStep(double maxStep){
+    ProfileScope scope(ProfilePhase::Solve);
+    /* the step may be rejected and retried, so the plate is stepped with the heater
+     * of the previous state and the heater follows with the step that was taken */
+    swapBuffers();
+    timeStep = rkcSolver.step(temperatureMapL2, temperatureMapL3, temperatureMapL0.data(), temperatureMapSizeX,
+                              temperatureMapSizeY, temperatureMapStride, rateCoefficients(), maxStep, stencilRow,
+                              workerPool.get());
+    calcHeaterRows();
+    finishStep();
+}
+
+void HeatSolver::swapBuffers(){
+    // the current state becomes the previous one for the next step;
+    // the whole plate is going to be stepped, so the inactive tiles are filled first
+    ProfileScope scope(ProfilePhase::Swap);
+    updateBurnerCells();
+    activateAllTiles();
+    std::swap(temperatureMapL2, temperatureMapL3);
+}
+
+void HeatSolver::calcStepRows(int yMin, int yMax){
+    calcStepRows(temperatureMapL2, temperatureMapL3, yMin, yMax);
+}
+
+void HeatSolver::finishStep(){
+    ++currentSimulationStep;
+    simulatedTime += timeStep;
+}
+
+template <typename T>
+void HeatSolver::calcHeaterRow(int y, T *heater, int xMin, int xMax) const{
+    /* current temperature of the burner, calculation only at the point where
+     * burner is drawn (heater is row y, the points xMin..xMax of it are updated).
+     * Approximation - burner cools down at the same rate as it heats up.
+     * If burner is on, we heat, if off, we cool untill outside temp */
+    const int rowStart = index(0, y);
+    const int *cell = burnerCells.data() + burnerRowStart[y];
+    const int *end = burnerCells.data() + burnerRowStart[y + 1];
+    if (xMin > 0) cell = std::lower_bound(cell, end, rowStart + xMin);
+    if (xMax < temperatureMapSizeX) end = std::lower_bound(cell, end, rowStart + xMax);
+
+    if (burnerOn) {
+        // restrict heater from reachin maxHeaterTemp by multiplying power by a coef
+        // ranging from 1 at T = 0, to 0 at T = maxHeatingTemp: the square of it is
+        // done with the constant factors taken out, no std::pow per point
+        // (the clamp only matters for the huge steps of the implicit integrators)
+        const double rate = timeStep * power / maxHeaterTemp / maxHeaterTemp;
+        for (; cell != end; ++cell){
+            T &h = heater[*cell - rowStart];
+            const double margin = maxHeaterTemp - h;
+            h = static_cast<T>(std::min<double>(maxHeaterTemp, h + rate * margin * margin));
+        }
+    }
+    else {
+        const double cooling = timeStep * power;
+        for (; cell != end; ++cell){
+            T &h = heater[*cell - rowStart];
+            h = static_cast<T>(std::max(outsideTemperature, h - cooling));
+        }
+    }
+}
+
+StencilCoefficients HeatSolver::stencilCoefficients() const{
+    // divisions by the steps are done once here instead of once per cell
+    StencilCoefficients c;
+    c.x = alpha*timeStep/xStep/xStep;
+    c.y = alpha*timeStep/yStep/yStep;
+    c.z = alpha*timeStep/zStep/zStep;
+    c.center = 1. - 2*(c.x + c.y + c.z);
+    c.outside = outsideTemperature;
+    return c;
+}
+
+StencilCoefficients HeatSolver::rateCoefficients() const{
+    // the coefficients of a one second step without the previous state: the stencil gives dT/dt
+    StencilCoefficients c;
+    c.x = alpha/xStep/xStep;
+    c.y = alpha/yStep/yStep;
+    c.z = alpha/zStep/zStep;
+    c.center = -2*(c.x + c.y + c.z);
+    c.outside = outsideTemperature;
+    return c;
+}
+
+void HeatSolver::calcStepRows(const double *previous, double *current, int yMin, int yMax, StencilRowStats *stats){
+    /* one sweep does the whole step: the heater of a row is updated first and
+     * then used by the stencil of the same row while it is still in cache.
+     * Simple solution of a differential equation, explicit type.
+     * for z it is outside temperature from the top
+     * and burner (temperatureMapL0) from the bottom;
+     * we are not calculating at border points, constant boundary condition works there,
+     * the heater is calculated everywhere */
+    const int nx = temperatureMapSizeX;
+    const int ny = temperatureMapSizeY;
+    const int stride = temperatureMapStride;
+    const StencilCoefficients c = stencilCoefficients();
+    if (Profiler::isEnabled()){
+        // two passes to time them apart, the heater rows do not depend on the plate: the same result
+        {
+            ProfileScope scope(ProfilePhase::Heater);
+            for (int y = yMin; y < yMax; ++y) calcHeaterRow(y, temperatureMapL0.row(y), 0, nx);
+        }
+        ProfileScope scope(ProfilePhase::Stencil);
+        for (int y = std::max(1, yMin); y < std::min(ny-1, yMax); ++y){
+            const int row = index(0, y);
+            if (stats) monitoredStencilRow(previous + row - stride + 1, previous + row + 1, previous + row + stride + 1,
+                                           temperatureMapL0.data() + row + 1, current + row + 1, nx-2, c, *stats);
+            else stencilRow(previous + row - stride + 1, previous + row + 1, previous + row + stride + 1,
+                            temperatureMapL0.data() + row + 1, current + row + 1, nx-2, c);
+        }
+        return;
+    }
+    for (int y = yMin; y < yMax; ++y){
+        const int row = index(0, y);
+        calcHeaterRow(y, temperatureMapL0.data() + row, 0, nx);
+        if (y == 0 || y == ny-1) continue;
+
+        if (stats) monitoredStencilRow(previous + row - stride + 1, previous + row + 1, previous + row + stride + 1,
+                                       temperatureMapL0.data() + row + 1, current + row + 1, nx-2, c, *stats);
+        else stencilRow(previous + row - stride + 1, previous + row + 1, previous + row + stride + 1,
+                        temperatureMapL0.data() + row + 1, current + row + 1, nx-2, c);
+    }
+}
+
+void HeatSolver::recordStepStatistics(const StencilRowStats *stats, int count){
+    // the sums of the strips, the border points are constant at the outside temperature
+    StencilRowStats total;
+    for (int i = 0; i < count; ++i){
+        total.maxChange = std::max(total.maxChange, stats[i].maxChange);
+        total.sum += stats[i].sum;
+    }
+    const double points = static_cast<double>(temperatureMapSizeX - 2) * (temperatureMapSizeY - 2);
+    lastStepStatistics.valid = true;
+    lastStepStatistics.maxRate = total.maxChange / timeStep;
+    lastStepStatistics.heatContent = (total.sum - points * outsideTemperature) * xStep * yStep * zStep;
+    lastStepStatistics.simulatedTime = simulatedTime;
+
+    // the heater heads for maxHeaterTemp, or for the outside temperature when it is off
+    const double heaterLimit = burnerOn ? maxHeaterTemp : outsideTemperature;
+    const double *heater = temperatureMapL0.data();
+    double gap = 0;
+    for (int cell : burnerCells) gap = std::max(gap, std::fabs(heaterLimit - heater[cell]));
+    lastStepStatistics.heaterGap = gap;
+}
+
+bool HeatSolver::solveSteadyState(double tolerance){
+    /* the heater does not depend on the plate, its limit is known; the plate is then the
+     * solution of the steady equation, with the air term of the previous solution */
+    if (plateLayers > 1) return false;
+    ProfileScope scope(ProfilePhase::Solve);
+    updateBurnerCells();
+    activateAllTiles();
+    const double heaterLimit = burnerOn ? maxHeaterTemp : outsideTemperature;
+    double *heater = temperatureMapL0.data();
+    for (int cell : burnerCells) heater[cell] = heaterLimit;
+
+    const int nx = temperatureMapSizeX;
+    const int ny = temperatureMapSizeY;
+    const StencilCoefficients c = rateCoefficients();
+    lastSteadyStateIterations = 0;
+    for (int iteration = 0; iteration < 50; ++iteration){
+        multigridSolver.solveSteady(temperatureMapL3, temperatureMapL2, heater, nx, ny, temperatureMapStride, c,
+                                    workerPool.get());
+        ++lastSteadyStateIterations;
+        double change = 0;
+        for (int y = 1; y < ny-1; ++y){
+            const double *solved = temperatureMapL2 + index(0, y);
+            const double *guess = temperatureMapL3 + index(0, y);
+            for (int x = 1; x < nx-1; ++x) change = std::max(change, std::fabs(solved[x] - guess[x]));
+        }
+        std::swap(temperatureMapL2, temperatureMapL3);
+        if (change <= tolerance) break;
+    }
+    lastStepStatistics.valid = false;
+    return true;
+}
+
+void HeatSolver::setTemporalBlocking(int steps){
+    temporalBlockSteps = std::max(1, steps);
+}
+
+void HeatSolver::calcHeatingStepsBlocked(int steps){
+    ProfileScope scope(ProfilePhase::Solve);
+    /* temporal blocking as a wavefront: k steps are done in one sweep over the plate.
+     * While going down the rows, row y of step 1, row y-1 of step 2, ... row y-k+1 of
+     * step k are calculated, every intermediate step only keeps the 3 rows the next step
+     * still needs in a small ring buffer, so the plate is read and written once per k
+     * steps and the working set (3*(k-1) rows) stays in cache. The kernels and their
+     * inputs are the same as for one step at a time, so the result is bit-identical.
+     * With several threads every worker sweeps its own strip plus k halo rows on each
+     * side, which are calculated twice (on a private copy of the heater) */
+    const int stride = temperatureMapStride;
+    const int threads = getNumberOfThreads();
+    activateAllTiles();
+
+    while (steps > 0){
+        const int k = std::min(steps, temporalBlockSteps);
+        const size_t ringCells = static_cast<size_t>(3) * (k - 1) * stride;
+        const size_t haloCells = static_cast<size_t>(2) * k * stride;
+        if (blockScratch.size() != static_cast<size_t>(2*threads)) blockScratch.resize(2*threads);
+        for (int w = 0; w < threads; ++w){
+            if (blockScratch[2*w].size() < ringCells) blockScratch[2*w].resize(ringCells);
+            if (blockScratch[2*w+1].size() < haloCells) blockScratch[2*w+1].resize(haloCells);
+        }
+
+        const double *source = temperatureMapL3;
+        double *target = temperatureMapL2;
+        auto job = [this, k, threads, source, target](int worker){
+            const int yMin = static_cast<int>(static_cast<long long>(temperatureMapSizeY) * worker / threads);
+            const int yMax = static_cast<int>(static_cast<long long>(temperatureMapSizeY) * (worker+1) / threads);
+            calcWavefrontSteps(source, target, yMin, yMax, k, blockScratch[2*worker].data(),
+                               blockScratch[2*worker+1].data());
+        };
+        if (workerPool) workerPool->run(job);
+        else job(0);
+
+        swapBuffers();
+        currentSimulationStep += k;
+        for (int i = 0; i < k; ++i) simulatedTime += timeStep;
+        steps -= k;
+        if (isInterrupted()) break;
+    }
+}
+
+void HeatSolver::calcWavefrontSteps(const double *source, double *target, int yMin, int yMax, int k,
+                                    double *ring, double *haloHeater){
+    const int nx = temperatureMapSizeX;
+    const int ny = temperatureMapSizeY;
+    const int stride = temperatureMapStride;
+    // halo rows above and below the strip, the plate border is never a halo
+    const int haloTop = std::max(0, yMin - k);
+    const int haloBottom = std::min(ny, yMax + k);
+
+    /* the heater of the halo rows belongs to the neighbour strips: it is copied
+     * before anybody starts to update it in place */
+    std::copy(temperatureMapL0.row(haloTop), temperatureMapL0.row(yMin), haloHeater);
+    std::copy(temperatureMapL0.row(yMax), temperatureMapL0.row(haloBottom),
+              haloHeater + static_cast<size_t>(k) * stride);
+    if (workerPool) workerPool->barrier();
+
+    auto heaterRow = [&](int y) -> double *{
+        if (y < yMin) return haloHeater + static_cast<size_t>(y - haloTop) * stride;
+        if (y >= yMax) return haloHeater + static_cast<size_t>(k + y - yMax) * stride;
+        return temperatureMapL0.row(y);
+    };
+    // row y of step s, 0 - the source, k - the target, the others in the ring buffer
+    auto stateRow = [&](int s, int y) -> double *{
+        if (s == 0) return const_cast<double *>(source) + static_cast<size_t>(y) * stride;
+        if (s == k) return target + static_cast<size_t>(y) * stride;
+        return ring + (static_cast<size_t>(s - 1) * 3 + y % 3) * stride;
+    };
+    // rows valid after s steps, they shrink by one row per step on the halo sides
+    auto validMin = [&](int s){ return haloTop == 0 ? 0 : haloTop + s; };
+    auto validMax = [&](int s){ return haloBottom == ny ? ny : haloBottom - s; };
+
+    const StencilCoefficients c = stencilCoefficients();
+    for (int t = validMin(1); t < validMax(k) + k - 1; ++t){
+        for (int s = 1; s <= k; ++s){
+            const int y = t - (s - 1);
+            if (y < validMin(s) || y >= validMax(s)) continue;
+
+            double *heater = heaterRow(y);
+            double *out = stateRow(s, y);
+            const double *sourceRow = source + static_cast<size_t>(y) * stride;
+            calcHeaterRow(y, heater, 0, nx);
+            if (y == 0 || y == ny-1){
+                // constant boundary rows
+                if (out != sourceRow) std::copy(sourceRow, sourceRow + nx, out);
+                continue;
+            }
+
+            out[0] = sourceRow[0];
+            out[nx-1] = sourceRow[nx-1];
+            stencilRow(stateRow(s-1, y-1) + 1, stateRow(s-1, y) + 1, stateRow(s-1, y+1) + 1,
+                       heater + 1, out + 1, nx-2, c);
+        }
+    }
+}
+
+void HeatSolver::setActiveTileTracking(bool enabled){
+    activeTileTracking = enabled;
+}
+
+void HeatSolver::setActiveTileEpsilon(double epsilon){
+    activeTileEpsilon = std::max(0., epsilon);
+}
+
+int HeatSolver::countActiveTiles() const{
+    return static_cast<int>(std::count(activeTiles.begin(), activeTiles.end(), 1));
+}
+
+void HeatSolver::resetActiveTiles(){
+    // the plate is uniform, only the tiles at the constant border can deviate from the ambient
+    ambientTemperature = outsideTemperature;
+    activeTiles.assign(static_cast<size_t>(tileCountX) * tileCountY, 0);
+    for (int tileY = 0; tileY < tileCountY; ++tileY){
+        for (int tileX = 0; tileX < tileCountX; ++tileX){
+            if (tileX == 0 || tileY == 0 || tileX == tileCountX-1 || tileY == tileCountY-1){
+                activeTiles[tileY * tileCountX + tileX] = 1;
+            }
+        }
+    }
+}
+
+void HeatSolver::activateAllTiles(){
+    // the inactive tiles are filled with the ambient temperature, so the whole plate can be stepped
+    if (std::find(activeTiles.begin(), activeTiles.end(), 0) == activeTiles.end()) return;
+    for (int tileY = 0; tileY < tileCountY; ++tileY){
+        for (int tileX = 0; tileX < tileCountX; ++tileX){
+            if (!isTileActive(tileX, tileY)) fillTile(temperatureMapL3, tileX, tileY, ambientTemperature, 0, tileSize);
+        }
+    }
+    std::fill(activeTiles.begin(), activeTiles.end(), 1);
+}
+
+void HeatSolver::fillTile(double *state, int tileX, int tileY, double value, int rowMin, int rowMax){
+    // rows rowMin..rowMax of the tile, counted from its top
+    const int xMin = tileX * tileSize;
+    const int xMax = std::min(temperatureMapSizeX, xMin + tileSize);
+    const int yMax = std::min(temperatureMapSizeY, tileY * tileSize + rowMax);
+    for (int y = tileY * tileSize + rowMin; y < yMax; ++y){
+        std::fill(state + index(xMin, y), state + index(xMax, y), value);
+    }
+}
+
+double HeatSolver::ambientAfterStep(double ambient, const StencilCoefficients &c) const{
+    // a point surrounded by the ambient temperature, through the same kernel so it is bit-identical
+    const double up = ambient;
+    const double mid[3] = {ambient, ambient, ambient};
+    const double down = ambient;
+    const double heater = outsideTemperature;
+    double out;
+    stencilRow(&up, mid + 1, &down, &heater, &out, 1, c);
+    return out;
+}
+
+void HeatSolver::calcActiveTileSteps(int steps){
+    ProfileScope scope(ProfilePhase::Solve);
+    /* the same as calcHeatingSteps, but only the active tiles are stepped. The inactive ones
+     * are not stored, they are all at the ambient temperature; only their edges read by
+     * the stencil of an active neighbour are written. After every step the active tiles
+     * with an edge off the ambient by more than activeTileEpsilon activate the neighbour
+     * on that side (the stencil does not reach further in one step). Every worker owns a
+     * strip of tile rows and only writes its own tiles; the spreading flags alternate
+     * with the step parity, so the barrier between the stencil and the spreading is the
+     * only one, and the edge rows of the inactive tiles facing the other strips are
+     * always written by the stencil sweep. With epsilon 0 the result is bit-identical to
+     * the whole plate; otherwise, below the stability limit (positive weights summing
+     * to less than 1, no amplification) the error stays of the order of epsilon */
+    const int threads = getNumberOfThreads();
+    const StencilCoefficients c = stencilCoefficients();
+    for (std::vector<char> &spreading : spreadingTiles) spreading.assign(activeTiles.size(), 0);
+
+    // the heater of a burner tile changes while the burner is on
+    if (burnerOn){
+        for (int tileY = 0; tileY < tileCountY; ++tileY){
+            for (int tileX = 0; tileX < tileCountX; ++tileX){
+                const int t = tileY * tileCountX + tileX;
+                if (!burnerTiles[t] || activeTiles[t]) continue;
+                activeTiles[t] = 1;
+                fillTile(temperatureMapL3, tileX, tileY, ambientTemperature, 0, tileSize);
+            }
+        }
+        fillInactiveEdges(temperatureMapL3, 0, tileCountY, ambientTemperature);
+    }
+
+    double *previous = temperatureMapL3;
+    double *current = temperatureMapL2;
+    stepsToTake.store(steps, std::memory_order_relaxed);
+    const double startAmbient = ambientTemperature;
+    auto job = [this, steps, threads, previous, current, c, startAmbient](int worker){
+        const int tileYMin = static_cast<int>(static_cast<long long>(tileCountY) * worker / threads);
+        const int tileYMax = static_cast<int>(static_cast<long long>(tileCountY) * (worker+1) / threads);
+        // every worker advances its own copy of the ambient, they all stop at the same step
+        double ambient = startAmbient;
+        for (int i = 0; i < steps; ++i){
+            char *spreading = spreadingTiles[i % 2].data();
+            double *target = (i % 2 == 0) ? current : previous;
+            ambient = ambientAfterStep(ambient, c);
+            calcActiveTileRows(target == current ? previous : current, target, tileYMin, tileYMax,
+                               ambient, spreading);
+            markInterruption(worker, i);
+            if (workerPool) workerPool->barrier();
+            spreadActiveTiles(spreading, target, tileYMin, tileYMax, ambient);
+            if (isLastStep(i)) break;
+        }
+        if (worker == 0) ambientTemperature = ambient;
+    };
+    if (workerPool) workerPool->run(job);
+    else job(0);
+
+    const int done = stepsToTake.load(std::memory_order_relaxed);
+    if (done % 2 == 1) std::swap(temperatureMapL2, temperatureMapL3);
+    currentSimulationStep += done;
+    for (int i = 0; i < done; ++i) simulatedTime += timeStep;
+}
+
+void HeatSolver::calcActiveTileRows(const double *previous, double *current, int tileYMin, int tileYMax,
+                                    double nextAmbient, char *spreading){
+    const int nx = temperatureMapSizeX;
+    const int ny = temperatureMapSizeY;
+    const int stride = temperatureMapStride;
+    const StencilCoefficients c = stencilCoefficients();
+    // the first and the last row of the strip are read by the neighbour strips
+    const int stripTop = (tileYMin > 0) ? tileYMin * tileSize : -1;
+    const int stripBottom = (tileYMax < tileCountY) ? tileYMax * tileSize - 1 : -1;
+    for (int tileY = tileYMin; tileY < tileYMax; ++tileY){
+        const char *active = activeTiles.data() + static_cast<size_t>(tileY) * tileCountX;
+        const int yMax = std::min(ny, (tileY + 1) * tileSize);
+        for (int y = tileY * tileSize; y < yMax; ++y){
+            const int row = index(0, y);
+            // runs of active (or inactive) tiles in one go, as in calcStepRows
+            for (int tileX = 0; tileX < tileCountX;){
+                int runEnd = tileX + 1;
+                while (runEnd < tileCountX && active[runEnd] == active[tileX]) ++runEnd;
+                const int xMin = tileX * tileSize;
+                const int xMax = std::min(nx, runEnd * tileSize);
+
+                if (active[tileX]){
+                    const int innerMin = std::max(1, xMin);
+                    const int innerMax = std::min(nx-1, xMax);
+                    calcHeaterRow(y, temperatureMapL0.data() + row, xMin, xMax);
+                    if (y != 0 && y != ny-1 && innerMin < innerMax){
+                        stencilRow(previous + row - stride + innerMin, previous + row + innerMin, previous + row + stride + innerMin,
+                                   temperatureMapL0.data() + row + innerMin, current + row + innerMin, innerMax - innerMin, c);
+                    }
+                }
+                else if (y == stripTop || y == stripBottom){
+                    // never at the border, the border tiles are always active
+                    std::fill(current + row + xMin, current + row + xMax, nextAmbient);
+                }
+                tileX = runEnd;
+            }
+        }
+
+        for (int tileX = 0; tileX < tileCountX; ++tileX){
+            spreading[tileY * tileCountX + tileX] = active[tileX] ? tileDeviates(current, tileX, tileY, nextAmbient,
+                                                                                 tileYMin, tileYMax) : 0;
+        }
+    }
+}
+char HeatSolver::tileDeviates(const double *current, int tileX, int tileY, double nextAmbient,
+                              int tileYMin, int tileYMax) const{
+    /* only the edges are read by the neighbour tiles, one bit per edge that has an inactive
+     * neighbour (the activity of the other strips is not known, they are always checked);
+     * the constant border points are not read by anybody */
+    const int nx = temperatureMapSizeX;
+    const int ny = temperatureMapSizeY;
+    const int xMin = tileX * tileSize;
+    const int xMax = std::min(nx, xMin + tileSize);
+    const int yMin = tileY * tileSize;
+    const int yMax = std::min(ny, yMin + tileSize);
+    const int innerXMin = std::max(1, xMin), innerXMax = std::min(nx-1, xMax);
+    const int innerYMin = std::max(1, yMin), innerYMax = std::min(ny-1, yMax);
+    auto rowDeviates = [&](int y){
+        const double *T = current + index(0, y);
+        for (int x = innerXMin; x < innerXMax; ++x){
+            if (std::abs(T[x] - nextAmbient) > activeTileEpsilon) return true;
+        }
+        return false;
+    };
+    auto columnDeviates = [&](int x){
+        for (int y = innerYMin; y < innerYMax; ++y){
+            if (std::abs(current[index(x, y)] - nextAmbient) > activeTileEpsilon) return true;
+        }
+        return false;
+    };
+
+    auto inactive = [&](int x, int y){ return y < tileYMin || y >= tileYMax || !isTileActive(x, y); };
+
+    char edges = 0;
+    if (tileY > 0 && inactive(tileX, tileY-1) && rowDeviates(yMin)) edges |= EdgeUp;
+    if (tileY < tileCountY-1 && inactive(tileX, tileY+1) && rowDeviates(yMax-1)) edges |= EdgeDown;
+    if (tileX > 0 && inactive(tileX-1, tileY) && columnDeviates(xMin)) edges |= EdgeLeft;
+    if (tileX < tileCountX-1 && inactive(tileX+1, tileY) && columnDeviates(xMax-1)) edges |= EdgeRight;
+    return edges;
+}
+
+void HeatSolver::spreadActiveTiles(const char *spreading, double *state, int tileYMin, int tileYMax, double ambient){
+    /* dilation: a tile becomes active if the facing edge of one of its 4 neighbours deviates,
+     * it starts from the ambient temperature. The edge rows facing the other strips are
+     * already written, and may be read by them right now */
+    for (int tileY = tileYMin; tileY < tileYMax; ++tileY){
+        const int rowMin = (tileY == tileYMin && tileY > 0) ? 1 : 0;
+        const int rowMax = (tileY == tileYMax-1 && tileY < tileCountY-1) ? tileSize-1 : tileSize;
+        for (int tileX = 0; tileX < tileCountX; ++tileX){
+            const int t = tileY * tileCountX + tileX;
+            if (activeTiles[t]) continue;
+            if ((tileX > 0 && (spreading[t-1] & EdgeRight)) || (tileX < tileCountX-1 && (spreading[t+1] & EdgeLeft))
+                    || (tileY > 0 && (spreading[t-tileCountX] & EdgeDown))
+                    || (tileY < tileCountY-1 && (spreading[t+tileCountX] & EdgeUp))){
+                activeTiles[t] = 1;
+                fillTile(state, tileX, tileY, ambient, rowMin, rowMax);
+            }
+        }
+    }
+    fillInactiveEdges(state, tileYMin, tileYMax, ambient);
+}
+
+void HeatSolver::fillInactiveEdges(double *state, int tileYMin, int tileYMax, double ambient){
+    // the edges of the inactive tiles read by the stencil of an active neighbour in the same strip
+    const int nx = temperatureMapSizeX;
+    const int ny = temperatureMapSizeY;
+    for (int tileY = tileYMin; tileY < tileYMax; ++tileY){
+        const int yMin = tileY * tileSize;
+        const int yMax = std::min(ny, yMin + tileSize);
+        // the edge rows facing the other strips are already written, and may be read by them right now
+        const int columnMin = (tileY == tileYMin && tileY > 0) ? yMin + 1 : yMin;
+        const int columnMax = (tileY == tileYMax-1 && tileY < tileCountY-1) ? yMax - 1 : yMax;
+        for (int tileX = 0; tileX < tileCountX; ++tileX){
+            if (isTileActive(tileX, tileY)) continue;
+            const int xMin = tileX * tileSize;
+            const int xMax = std::min(nx, xMin + tileSize);
+            // inactive tiles are never at the border, all the neighbours exist
+            if (tileY > tileYMin && isTileActive(tileX, tileY-1)){
+                std::fill(state + index(xMin, yMin), state + index(xMax, yMin), ambient);
+            }
+            if (tileY < tileYMax-1 && isTileActive(tileX, tileY+1)){
+                std::fill(state + index(xMin, yMax-1), state + index(xMax, yMax-1), ambient);
+            }
+            if (isTileActive(tileX-1, tileY)){
+                for (int y = columnMin; y < columnMax; ++y) state[index(xMin, y)] = ambient;
+            }
+            if (isTileActive(tileX+1, tileY)){
+                for (int y = columnMin; y < columnMax; ++y) state[index(xMax-1, y)] = ambient;
+            }
+        }
+    }
+}
+
+void HeatSolver::setKernelIsa(KernelIsa isa){
+    // unsupported instruction sets fall back to the best supported one
+    kernelIsa = isKernelIsaSupported(isa) ? isa : detectKernelIsa();
+    stencilRow = stencilRowKernel(kernelIsa);
+    floatStencilRow = floatStencilRowKernel(kernelIsa);
+    mixedStencilRow = mixedStencilRowKernel(kernelIsa);
+    layeredStencilRow = layeredStencilRowKernel(kernelIsa);
+    layerSweepRow = layerSweepRowKernel(kernelIsa);
+    monitoredStencilRow = monitoredStencilRowKernel(kernelIsa);
+}
+
+void HeatSolver::setPrecision(Precision newPrecision){
+    precision = newPrecision;
+}
+
+void HeatSolver::calcReducedPrecisionSteps(int steps){
+    ProfileScope scope(ProfilePhase::Solve);
+    /* the same as calcHeatingSteps on float layers: every worker narrows its strip of the
+     * double state, steps it as many times as asked and widens the result back; the
+     * barrier after the narrowing makes the rows of the neighbour strips ready */
+    const int nx = temperatureMapSizeX;
+    const int ny = temperatureMapSizeY;
+    const bool floatHeaterUsed = precision == Precision::Float;
+    activateAllTiles();
+    for (PlateGrid<float> *layer : {&floatBuffers[0], &floatBuffers[1], &floatHeater}){
+        if (layer == &floatHeater && !floatHeaterUsed) continue;
+        if (layer->sizeX() != nx || layer->sizeY() != ny) layer->resize(nx, ny, static_cast<float>(outsideTemperature));
+    }
+
+    const int threads = getNumberOfThreads();
+    float *previous = floatBuffers[0].data();
+    float *current = floatBuffers[1].data();
+    stepsToTake.store(steps, std::memory_order_relaxed);
+    auto job = [this, steps, threads, nx, ny, floatHeaterUsed, previous, current](int worker){
+        const int yMin = static_cast<int>(static_cast<long long>(ny) * worker / threads);
+        const int yMax = static_cast<int>(static_cast<long long>(ny) * (worker+1) / threads);
+        for (int y = yMin; y < yMax; ++y){
+            // both buffers, for their constant border points
+            const double *T = temperatureMapL3 + index(0, y);
+            std::transform(T, T + nx, floatBuffers[0].row(y), [](double t){ return static_cast<float>(t); });
+            std::copy(floatBuffers[0].row(y), floatBuffers[0].row(y) + nx, floatBuffers[1].row(y));
+            if (floatHeaterUsed){
+                const double *heater = temperatureMapL0.row(y);
+                std::transform(heater, heater + nx, floatHeater.row(y), [](double h){ return static_cast<float>(h); });
+            }
+        }
+        if (workerPool) workerPool->barrier();
+
+        for (int i = 0; i < steps; ++i){
+            if (i % 2 == 0) calcReducedPrecisionRows(previous, current, yMin, yMax);
+            else calcReducedPrecisionRows(current, previous, yMin, yMax);
+            markInterruption(worker, i);
+            if (workerPool) workerPool->barrier();
+            if (isLastStep(i)) break;
+        }
+
+        const float *result = (stepsToTake.load(std::memory_order_relaxed) % 2 == 1) ? current : previous;
+        const int stride = floatBuffers[0].stride();
+        for (int y = yMin; y < yMax; ++y){
+            const float *T = result + static_cast<size_t>(y) * stride;
+            std::copy(T, T + nx, temperatureMapL3 + index(0, y));
+            if (floatHeaterUsed) std::copy(floatHeater.row(y), floatHeater.row(y) + nx, temperatureMapL0.row(y));
+        }
+    };
+    if (workerPool) workerPool->run(job);
+    else job(0);
+
+    const int done = stepsToTake.load(std::memory_order_relaxed);
+    currentSimulationStep += done;
+    for (int i = 0; i < done; ++i) simulatedTime += timeStep;
+}
+
+void HeatSolver::calcReducedPrecisionRows(const float *previous, float *current, int yMin, int yMax){
+    // calcStepRows with the float or mixed kernel, the heater is float in float precision
+    const int nx = temperatureMapSizeX;
+    const int ny = temperatureMapSizeY;
+    const int stride = floatBuffers[0].stride();
+    const StencilCoefficients c = stencilCoefficients();
+    for (int y = yMin; y < yMax; ++y){
+        const size_t row = static_cast<size_t>(y) * stride;
+        if (precision == Precision::Float){
+            float *heater = floatHeater.row(y);
+            calcHeaterRow(y, heater, 0, nx);
+            if (y == 0 || y == ny-1) continue;
+            floatStencilRow(previous + row - stride + 1, previous + row + 1, previous + row + stride + 1,
+                            heater + 1, current + row + 1, nx-2, c);
+        }
+        else {
+            double *heater = temperatureMapL0.row(y);
+            calcHeaterRow(y, heater, 0, nx);
+            if (y == 0 || y == ny-1) continue;
+            mixedStencilRow(previous + row - stride + 1, previous + row + 1, previous + row + stride + 1,
+                            heater + 1, current + row + 1, nx-2, c);
+        }
+    }
+}
+
+void HeatSolver::fillPlateLayers(){
+    // both buffers, for their constant border points
+    const int nx = temperatureMapSizeX;
+    const int ny = temperatureMapSizeY;
+    activateAllTiles();
+    for (PlateGrid<double> &layers : layerBuffers){
+        if (layers.sizeX() != nx || layers.sizeY() != ny * plateLayers) layers.resize(nx, ny * plateLayers, outsideTemperature);
+        for (int y = 0; y < ny; ++y){
+            const double *T = temperatureMapL3 + index(0, y);
+            for (int layer = 0; layer < plateLayers; ++layer) std::copy(T, T + nx, layers.data() + layerIndex(0, y, layer));
+        }
+    }
+    currentLayers = 0;
+}
+
+StencilCoefficients HeatSolver::layeredCoefficients() const{
+    StencilCoefficients c = stencilCoefficients();
+    const double zLayer = zStep / plateLayers;
+    c.z = alpha*timeStep/zLayer/zLayer;
+    c.center = 1. - 2*(c.x + c.y);
+    return c;
+}
+
+void HeatSolver::fillLayerSweep(const StencilCoefficients &c){
+    /* the tridiagonal system of a column, the same in every column:
+     *   -z*T[l-1] + (1 + 2z)*T[l] - z*T[l+1] = explicit part (+ z*heater at the bottom)
+     * the top has one neighbour and loses z/layers to the air, as in calcLayeredRows;
+     * the Thomas algorithm only needs the factors of its elimination, kept here (upper
+     * is minus the eliminated upper diagonal, the back substitution adds upper*T[l+1]) */
+    layerSweep.resize(2 * static_cast<size_t>(plateLayers));
+    double upper = 0;
+    for (int layer = 0; layer < plateLayers; ++layer){
+        const bool top = layer == plateLayers - 1;
+        const double diagonal = top ? 1. + c.z + c.z / plateLayers : 1. + 2*c.z;
+        const double pivot = 1. / (diagonal - (layer > 0 ? c.z * upper : 0.));
+        upper = top ? 0. : c.z * pivot;
+        layerSweep[2*layer] = pivot;
+        layerSweep[2*layer+1] = upper;
+    }
+}
+
+void HeatSolver::calcLayeredSteps(int steps){
+    ProfileScope scope(ProfilePhase::Solve);
+    /* as calcHeatingSteps: every worker steps the same strip of plate rows (all their
+     * layers) for all the steps, on the buffer picked by the parity of the step, with one
+     * barrier per step; then it copies the top layer of its strip to the plate */
+    const int ny = temperatureMapSizeY;
+    if (layerBuffers[0].sizeY() != ny * plateLayers || layerBuffers[0].sizeX() != temperatureMapSizeX) fillPlateLayers();
+    activateAllTiles();
+
+    const int threads = getNumberOfThreads();
+    fillLayerSweep(layeredCoefficients());
+    double *previous = layerBuffers[currentLayers].data();
+    double *current = layerBuffers[1 - currentLayers].data();
+    stepsToTake.store(steps, std::memory_order_relaxed);
+    auto job = [this, steps, threads, ny, previous, current](int worker){
+        const int yMin = static_cast<int>(static_cast<long long>(ny) * worker / threads);
+        const int yMax = static_cast<int>(static_cast<long long>(ny) * (worker+1) / threads);
+        for (int i = 0; i < steps; ++i){
+            if (i % 2 == 0) calcLayeredRows(previous, current, yMin, yMax);
+            else calcLayeredRows(current, previous, yMin, yMax);
+            markInterruption(worker, i);
+            if (workerPool){
+                ProfileScope scope(ProfilePhase::Barrier);
+                workerPool->barrier();
+            }
+            if (isLastStep(i)) break;
+        }
+        const double *result = (stepsToTake.load(std::memory_order_relaxed) % 2 == 1) ? current : previous;
+        for (int y = yMin; y < yMax; ++y){
+            const double *T = result + layerIndex(0, y, plateLayers - 1);
+            std::copy(T, T + temperatureMapSizeX, temperatureMapL3 + index(0, y));
+        }
+    };
+    if (workerPool) workerPool->run(job);
+    else job(0);
+
+    const int done = stepsToTake.load(std::memory_order_relaxed);
+    if (done % 2 == 1) currentLayers = 1 - currentLayers;
+    currentSimulationStep += done;
+    for (int i = 0; i < done; ++i) simulatedTime += timeStep;
+}
+
+void HeatSolver::calcLayeredRows(const double *previous, double *current, int yMin, int yMax){
+    /* the heater of a plate row first, then the layers of the row, IMEX as the ADI steps:
+     * x and y explicitly, a row of every layer from the bottom with the 7 point kernel and
+     * no z term, then z implicitly, one tridiagonal solve per column (fillLayerSweep) for all
+     * the columns of the row at once, the layers being one row stride apart. The lowest
+     * layer is heated by the heater one layer under it, the ones between only exchange with
+     * their neighbours and the top one loses to the air as the top of the single layer plate
+     * does, whatever the number of layers: the air (min(outside, 0.7*T) of the previous
+     * state, zStep above in the single layer model) is one layer over the top, its
+     * difference to the top scaled by zStep/layer */
+    const int nx = temperatureMapSizeX;
+    const int ny = temperatureMapSizeY;
+    const int stride = temperatureMapStride;
+    const size_t plateRow = static_cast<size_t>(plateLayers) * stride;   // to the same layer of the next plate row
+    const StencilCoefficients c = layeredCoefficients();
+    const double airCoupling = c.z / plateLayers;
+    StencilCoefficients planar = c;
+    planar.z = 0;
+    const double *sweep = layerSweep.data();
+    const int n = nx-2;
+    const bool profiling = Profiler::isEnabled();
+    if (profiling){
+        // two passes to time them apart, as calcStepRows
+        ProfileScope scope(ProfilePhase::Heater);
+        for (int y = yMin; y < yMax; ++y) calcHeaterRow(y, temperatureMapL0.row(y), 0, nx);
+    }
+    ProfileScope scope(ProfilePhase::Stencil);
+    for (int y = yMin; y < yMax; ++y){
+        double *heater = temperatureMapL0.row(y);
+        if (!profiling) calcHeaterRow(y, heater, 0, nx);
+        if (y == 0 || y == ny-1) continue;
+
+        // x and y with the kernel without its z term, then z: the forward elimination of every
+        // layer row while it is in cache, then the back substitution from the top
+        for (int layer = 0; layer < plateLayers; ++layer){
+            const double *mid = previous + layerIndex(1, y, layer);
+            double *T = current + layerIndex(1, y, layer);
+            layeredStencilRow(mid - plateRow, mid, mid + plateRow, mid, mid, T, n, planar);
+            if (layer == plateLayers - 1){
+                for (int i = 0; i < n; ++i) T[i] += airCoupling * std::min(c.outside, mid[i]*0.7);
+            }
+            layerSweepRow(layer == 0 ? heater + 1 : T - stride, T, n, c.z, sweep[2*layer]);
+        }
+        for (int layer = plateLayers - 2; layer >= 0; --layer){
+            double *T = current + layerIndex(1, y, layer);
+            layerSweepRow(T + stride, T, n, sweep[2*layer+1], 1.);
+        }
+    }
+}
+
+double HeatSolver::maxTemperature() const{
+    // the inactive tiles are at the ambient temperature, whatever is in their memory
+    const int nx = temperatureMapSizeX;
+    double maximum = -std::numeric_limits<double>::infinity();
+    for (int tileY = 0; tileY < tileCountY; ++tileY){
+        const int yMax = std::min(temperatureMapSizeY, (tileY + 1) * tileSize);
+        for (int tileX = 0; tileX < tileCountX; ++tileX){
+            if (!isTileActive(tileX, tileY)){
+                maximum = std::max(maximum, ambientTemperature);
+                continue;
+            }
+            const int xMin = tileX * tileSize;
+            const int xMax = std::min(nx, xMin + tileSize);
+            for (int y = tileY * tileSize; y < yMax; ++y){
+                // std::max drops NaN, a diverged plate must not look cold
+                for (const double *t = temperatureMapL3 + index(xMin, y); t != temperatureMapL3 + index(xMax, y); ++t){
+                    if (std::isnan(*t)) return *t;
+                    maximum = std::max(maximum, *t);
+                }
+            }
+        }
+    }
+    return maximum;
+}
+
+MemoryUsage HeatSolver::memoryUsage() const{
+    MemoryUsage usage;
+    const size_t plate = static_cast<size_t>(temperatureMapSizeX) * temperatureMapSizeY * sizeof(double);
+    usage.temperatureLayers = temperatureBuffers[0].bytes() + temperatureBuffers[1].bytes();
+    usage.heaterLayer = temperatureMapL0.bytes();
+    usage.padding = usage.temperatureLayers + usage.heaterLayer - 3*plate;
+    usage.burnerMap = burnerMap.capacity() * sizeof(uint64_t) + (burnerCells.capacity() + burnerRowStart.capacity()) * sizeof(int)
+            + burnerTiles.capacity();
+    usage.activeTiles = activeTiles.capacity() + spreadingTiles[0].capacity() + spreadingTiles[1].capacity();
+    usage.integratorScratch = adiSolver.memoryBytes() + multigridSolver.memoryBytes() + rkcSolver.memoryBytes();
+    for (const std::vector<double> &scratch : blockScratch) usage.blockingScratch += scratch.capacity() * sizeof(double);
+    usage.floatLayers = floatBuffers[0].bytes() + floatBuffers[1].bytes() + floatHeater.bytes();
+    usage.plateLayers = layerBuffers[0].bytes() + layerBuffers[1].bytes();
+    return usage;
+}
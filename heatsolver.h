@@ -0,0 +1,524 @@
+#ifndef HEATSOLVER_H
+#define HEATSOLVER_H
+
+/* Heat model of the stove top, independent of any widget.
+ * Only the C++ standard library is used here, so the solver can be driven
+ * by the GUI (DrawArea) as well as by the headless batch runner (stovecli). */
+
+// C++ libs
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "adisolver.h"
+#include "multigridsolver.h"
+#include "plategrid.h"
+#include "rkcsolver.h"
+#include "stencilkernel.h"
+#include "workerpool.h"
+
+/* Explicit - the 5 point stencil, ADI - Peaceman-Rachford, unconditionally stable,
+ * Multigrid - backward Euler solved with multigrid, stable and without oscillations at any step,
+ * RKC - Runge-Kutta-Chebyshev, explicit stages, the step adapts to the local error */
+enum class Integrator { Explicit, ADI, Multigrid, RKC };
+
+// bytes held by a solver, by what they are used for
+struct MemoryUsage{
+    size_t temperatureLayers = 0;   // the two plate states
+    size_t heaterLayer = 0;
+    size_t padding = 0;             // row padding of the three layers above
+    size_t burnerMap = 0;           // bit mask, points and tiles of the burner
+    size_t activeTiles = 0;
+    size_t integratorScratch = 0;   // ADI, multigrid and RKC
+    size_t blockingScratch = 0;     // temporal blocking ring buffers
+    size_t floatLayers = 0;         // plate (and heater) of the float and mixed precisions
+    size_t plateLayers = 0;         // the two states of the layered plate
+
+    size_t total() const{
+        return temperatureLayers + heaterLayer + burnerMap + activeTiles + integratorScratch + blockingScratch
+                + floatLayers + plateLayers;
+    }
+};
+
+// a box of points, the max sides excluded
+struct BurnerBounds{
+    int xMin = 0, yMin = 0;
+    int xMax = 0, yMax = 0;
+
+    bool isEmpty() const { return xMin >= xMax || yMin >= yMax; }
+
+    void add(int x0, int y0, int x1, int y1);
+};
+
+// gathered by the explicit steps for a convergence monitor, see HeatSolver::setSteadyStateMonitor
+struct StepStatistics{
+    bool valid = false;
+    double maxRate = 0;         // the fastest changing point, deg C per second
+    double heatContent = 0;     // sum of (T - outside) over the plate times the volume of a point, deg C*mm^3
+    double heaterGap = 0;       // the burner point furthest from the limit of the heater, deg C
+    double simulatedTime = 0;   // at the end of the step
+};
+
+/* what a run is resumed from (see Checkpoint): the current plate and the heater, sizeY rows
+ * of PlateGrid<double>::paddedStride(sizeX) points each, are used in place by the solver
+ * and kept alive by owner, e.g. a mapped file; the other members are copied */
+struct SolverState{
+    int sizeX = 0, sizeY = 0;
+    double *temperatures = nullptr;
+    double *heater = nullptr;
+    int plateLayers = 1;
+    double *layers = nullptr;           // the z-blocked layers of a layered plate (see layerRow)
+    std::shared_ptr<void> owner;
+    std::vector<uint64_t> burnerMap;    // one bit per point of the layers, padding included
+    std::vector<char> activeTiles;
+    double ambientTemperature = 20.;
+    long long step = 0;
+    double simulatedTime = 0;
+    double alpha = 5.;
+    int watts = 5000;
+    bool burnerOn = false;
+    double proposedStep = 0;            // RKC: the next step, 0 - the explicit limit
+};
+
+//______________________________________________Heat Solver________________//
+class HeatSolver{
+public:
+    HeatSolver(int sizeX = 202, int sizeY = 202);
+
+    void resize(int newSizeX, int newSizeY);
+
+    int sizeX() const { return temperatureMapSizeX; }
+
+    int sizeY() const { return temperatureMapSizeY; }
+
+    // distance between two rows of the layers, in points (see PlateGrid)
+    int rowStride() const { return temperatureMapStride; }
+
+    MemoryUsage memoryUsage() const;
+
+    // parameters
+    void setAlpha(double);
+
+    double getAlpha() const { return alpha; }
+
+    void setWatts(int);
+
+    int getWatts() const { return W; }
+
+    void setBurner(bool);
+
+    bool isBurnerOn() const { return burnerOn; }
+
+    void updatePower();
+
+    void updateTimeStep();
+
+    // RKC: the last step taken
+    double getTimeStep() const { return timeStep; }
+
+    void setMaxTimeStep(double);
+
+    double getMaxTimeStep() const { return maxTimeStep; }
+
+    int stepsPerPeriod(double periodSeconds) const;
+
+    void setIntegrator(Integrator);
+
+    Integrator getIntegrator() const { return integrator; }
+
+    void setTimeStepFactor(double);
+
+    double getTimeStepFactor() const { return timeStepFactor; }
+
+    void setMultigridTolerance(double);
+
+    double getMultigridTolerance() const { return multigridSolver.getTolerance(); }
+
+    int getLastMultigridCycles() const { return multigridSolver.getLastCycles(); }
+
+    // RKC: relative (and absolute, in deg C) local error allowed per step
+    void setAdaptiveTolerance(double);
+
+    double getAdaptiveTolerance() const { return rkcSolver.getTolerance(); }
+
+    long long getAcceptedSteps() const { return rkcSolver.getAcceptedSteps(); }
+
+    long long getRejectedSteps() const { return rkcSolver.getRejectedSteps(); }
+
+    int getLastStages() const { return rkcSolver.getLastStages(); }
+
+    void setNumberOfThreads(int);
+
+    int getNumberOfThreads() const { return workerPool ? workerPool->size() : 1; }
+
+    void setTemporalBlocking(int steps);
+
+    int getTemporalBlockSteps() const { return temporalBlockSteps; }
+
+    void setKernelIsa(KernelIsa);
+
+    KernelIsa getKernelIsa() const { return kernelIsa; }
+
+    /* float or mixed precision of the explicit steps, the whole plate is stepped (no temporal
+     * blocking, no active tiles); the state is converted from and back to double once per
+     * calcHeatingSteps, so everything reading the solver still sees doubles */
+    void setPrecision(Precision);
+
+    Precision getPrecision() const { return precision; }
+
+    /* the thickness of the top as layers of zStep/layers between the heater and the air, with
+     * real gradients through it: x and y explicit, z implicit (a tridiagonal solve per column),
+     * so the time step does not shrink with thin layers; always in double precision
+     * (the integrator, precision, temporal blocking and active tiles are then not used);
+     * 1 - the single layer model. The plate read from the solver (temperature, temperatureRow,
+     * maxTemperature...) is the top layer, the one that is seen and touched */
+    void setPlateLayers(int layers);
+
+    int getPlateLayers() const { return plateLayers; }
+
+    // row y of a layer of the layered plate (0 - on the heater), only with more than one layer
+    const double *layerRow(int y, int layer) const{
+        return layerBuffers[currentLayers].data() + layerIndex(0, y, layer);
+    }
+
+    static constexpr int maxPlateLayers = 64;
+
+    // active tiles, only the explicit steps (calcHeatingStep, calcHeatingSteps without blocking) use them
+    void setActiveTileTracking(bool);
+
+    bool isActiveTileTracking() const { return activeTileTracking; }
+
+    void setActiveTileEpsilon(double);
+
+    double getActiveTileEpsilon() const { return activeTileEpsilon; }
+
+    int getTileCountX() const { return tileCountX; }
+
+    int getTileCountY() const { return tileCountY; }
+
+    bool isTileActive(int tileX, int tileY) const { return activeTiles[tileY * tileCountX + tileX] != 0; }
+
+    int countActiveTiles() const;
+
+    double getAmbientTemperature() const { return ambientTemperature; }
+
+    // burner map
+    void clearBurnerMap();
+
+    void setBurnerCell(int x, int y, bool status);
+
+    bool isBurnerCell(int x, int y) const{
+        const int i = index(x, y);
+        return (burnerMap[static_cast<size_t>(i) >> 6] >> (i & 63)) & 1;
+    }
+
+    void setBurnerDisc(int centerX, int centerY, int diameter, bool status);
+
+    /* the stroke of a round pen of the diameter from (x0, y0) to (x1, y1): every point not
+     * further than diameter/2 from the segment, a disc if the ends are the same. Filled
+     * row by row, a span per row from the caps (a table of half widths per diameter, no
+     * square root per row) and the band between them, whole words of the mask at once;
+     * the work is the area of the stroke, not of the plate */
+    void setBurnerCapsule(int x0, int y0, int x1, int y1, int diameter, bool status);
+
+    void countBurnerPixels();
+
+    // the points of the mask changed since the burner cells were last built, empty if none
+    const BurnerBounds &getBurnerDirtyBounds() const { return burnerDirty; }
+
+    int getNumberOfBurnerPixels() const { return numberOfBurnerPixels; }
+
+    double getDeltaT(int x, int y) const;
+
+    // simulation
+    void resetTemperatureMapLayers();
+
+    void calcHeatingStep();
+
+    void calcHeatingSteps(int steps);
+
+    /* steps exactly the given simulated time: whole steps and a shorter last one, the
+     * adaptive steps of RKC are cut to land on it; the simulated time does not drift */
+    void advanceTime(double seconds);
+
+    /* cooperative interruption of calcHeatingSteps and advanceTime: the flag is read with a
+     * relaxed load once per step (once per sweep of temporal blocking), never in the loops
+     * over the points, and once it is set they return after the step being done, so the
+     * state is always the one of whole steps; nullptr - never interrupted */
+    void setInterruptFlag(const std::atomic<bool> *flag) { interruptFlag = flag; }
+
+    bool isInterrupted() const { return interruptFlag && interruptFlag->load(std::memory_order_relaxed); }
+
+    /* convergence monitor: the explicit steps in double precision gather the fastest change
+     * of a point and the heat content of the plate in their stencil sweep (see
+     * MonitoredStencilRowKernel), temporal blocking and active tiles are not used while it
+     * is on; the other integrators, precisions and the layered plate do not gather them */
+    void setSteadyStateMonitor(bool enabled) { steadyStateMonitor = enabled; }
+
+    bool isSteadyStateMonitor() const { return steadyStateMonitor; }
+
+    // of the last step, not valid if it did not gather them
+    const StepStatistics &getLastStepStatistics() const { return lastStepStatistics; }
+
+    /* jumps to the equilibrium of the current setting: the heater at its limit (maxHeaterTemp
+     * on the burner if it is on, the outside temperature if it is off) and the steady plate
+     * over it solved with multigrid (see MultigridSolver::solveSteady), again from its result
+     * until no point moves by more than tolerance deg C (the air term follows the plate).
+     * The simulated time is left as it is. Not for the layered plate, false then */
+    bool solveSteadyState(double tolerance = 1e-6);
+
+    int getLastSteadyStateIterations() const { return lastSteadyStateIterations; }
+
+    void swapBuffers();
+
+    void calcStepRows(int yMin, int yMax);
+
+    void finishStep();
+
+    // the heater of the whole plate alone, without stepping the plate (stovebench)
+    void calcHeaterRows();
+
+    /* the stencil alone over the points xMin..xMax of the rows yMin..yMax (the border is
+     * left out), from the previous state into the current one: a step split in parts, after
+     * swapBuffers and calcHeaterRows, for the blocks of a distributed plate (DistributedSolver) */
+    void calcStencilRect(int xMin, int xMax, int yMin, int yMax);
+
+    // row y of the previous state, the halos of a block are received into its border
+    double *previousRow(int y) { return temperatureMapL2 + index(0, y); }
+
+    /* the burner points the power is spread over, when the plate is a block of a larger
+     * one and the burner is cut between the blocks; 0 - the burner of this plate */
+    void setPowerPixels(int pixels);
+
+    long long getCurrentStep() const { return currentSimulationStep; }
+
+    void resetStepCounter() { currentSimulationStep = 0; }
+
+    double getSimulatedTime() const { return simulatedTime; }
+
+    double temperature(int x, int y) const{
+        return activeTiles[tileIndex(x, y)] ? temperatureMapL3[index(x, y)] : ambientTemperature;
+    }
+
+    // row y of the current state, only valid in the active tiles (see isTileActive)
+    const double *temperatureRow(int y) const { return temperatureMapL3 + index(0, y); }
+
+    double heaterTemperature(int x, int y) const { return temperatureMapL0.data()[index(x, y)]; }
+
+    const double *heaterRow(int y) const { return temperatureMapL0.data() + index(0, y); }
+
+    // the burner mask, one bit per point of the layers (index(x, y)), 64 points per word
+    const std::vector<uint64_t> &getBurnerMap() const { return burnerMap; }
+
+    double getProposedStep() const { return rkcSolver.getProposedStep(); }
+
+    /* resumes from a saved state: its size, plate, heater, burner, active tiles, step, time
+     * and material and power; the settings of the run (integrator, threads...) are kept */
+    void restoreState(SolverState state);
+
+    // NaN if any point is NaN (a diverged run)
+    double maxTemperature() const;
+
+    // physical constants
+    static constexpr double outsideTemperature = 20.;
+
+    static constexpr double density = 8.96e-3;             // Cu, density in g/mm^3 // rho in literature
+    static constexpr double volHeatCapCu = 3.45e-3;       // Cu, specific heat capacity in J/mm^3/deg C // c in literature
+    static constexpr double resistivity = 1.68e-5;       // Cu, resistivity in Ohm*mm // again rho in literature
+    static constexpr double thermalResCoef = 3.86e-3;   // Cu, thermal sensitivity of resistivity, in a.u./deg C // again alpha in literature
+    static constexpr int maxHeaterTemp = 800;          // max temperature set for Cu heater, it will be not able to heat further
+
+    // simulation constants
+    static constexpr double xStep = 0.26;           // 1 px = 0.26 mm // value for my monitor
+    static constexpr double yStep = 0.26;          // one pixel - one small block of burner
+    static constexpr double zStep = 2.;           // thickness of the stove top (glass or other)
+                                                 // consider there is burner at 0-zStep and air at 0+zStep
+    static constexpr double burnerSizeZ = 1.;   // burner Z size
+                                               // these values are used for calculation of the size of the burner,
+                                              // stove top, as well as x, y and z simulation steps
+    static constexpr int tileSize = 16;     // active tiles are tileSize*tileSize points
+
+private:
+    int index(int x, int y) const { return y * temperatureMapStride + x; }
+
+    void setBurnerBit(int i, bool status);
+
+    // the points xMin..xMax-1 of row y, xMin and xMax inside the plate
+    void setBurnerSpan(int y, int xMin, int xMax, bool status);
+
+    void updateBurnerCells();
+
+    template <typename T>
+    void calcHeaterRow(int y, T *heater, int xMin, int xMax) const;
+
+    StencilCoefficients stencilCoefficients() const;
+
+    StencilCoefficients rateCoefficients() const;
+
+    // stats - nullptr, or where the monitored kernel gathers the step
+    void calcStepRows(const double *previous, double *current, int yMin, int yMax, StencilRowStats *stats = nullptr);
+
+    void recordStepStatistics(const StencilRowStats *stats, int count);
+
+    void calcHeatingStepsBlocked(int steps);
+
+    void calcImplicitStep();
+
+    void calcAdaptiveStep(double maxStep);
+
+    void calcReducedPrecisionSteps(int steps);
+
+    void calcReducedPrecisionRows(const float *previous, float *current, int yMin, int yMax);
+
+    void calcLayeredSteps(int steps);
+
+    void calcLayeredRows(const double *previous, double *current, int yMin, int yMax);
+
+    // c.z is the coupling of two layers, c.center only counts x and y
+    StencilCoefficients layeredCoefficients() const;
+
+    void fillLayerSweep(const StencilCoefficients &c);
+
+    void fillPlateLayers();
+
+    // point x of row y of a layer: the rows of all the layers of a plate row y follow each other
+    size_t layerIndex(int x, int y, int layer) const{
+        return (static_cast<size_t>(y) * plateLayers + layer) * temperatureMapStride + x;
+    }
+
+    /* the worker loops stop together after the same step: worker 0 cuts stepsToTake after
+     * step i before the barrier of the step, all of them read it after the barrier */
+    void markInterruption(int worker, int step){
+        if (worker == 0 && isInterrupted() && stepsToTake.load(std::memory_order_relaxed) > step + 1){
+            stepsToTake.store(step + 1, std::memory_order_relaxed);
+        }
+    }
+
+    bool isLastStep(int step) const { return step + 1 >= stepsToTake.load(std::memory_order_relaxed); }
+
+    void calcWavefrontSteps(const double *source, double *target, int yMin, int yMax, int k,
+                            double *ring, double *haloHeater);
+
+    void calcActiveTileSteps(int steps);
+
+    void calcActiveTileRows(const double *previous, double *current, int tileYMin, int tileYMax,
+                            double nextAmbient, char *spreading);
+
+    enum TileEdge : char { EdgeUp = 1, EdgeDown = 2, EdgeLeft = 4, EdgeRight = 8 };
+
+    char tileDeviates(const double *current, int tileX, int tileY, double nextAmbient,
+                      int tileYMin, int tileYMax) const;
+
+    void spreadActiveTiles(const char *spreading, double *state, int tileYMin, int tileYMax, double ambient);
+
+    void fillInactiveEdges(double *state, int tileYMin, int tileYMax, double ambient);
+
+    void fillTile(double *state, int tileX, int tileY, double value, int rowMin, int rowMax);
+
+    void resetActiveTiles();
+
+    void activateAllTiles();
+
+    double ambientAfterStep(double ambient, const StencilCoefficients &c) const;
+
+    int tileIndex(int x, int y) const { return (y / tileSize) * tileCountX + x / tileSize; }
+
+    // 202*202 by default - 2 extra points in each dimention are used as boundary,
+    // so main calc area is 200*200; the layers are stored row by row (y major),
+    // temperatureMapStride points apart
+    int temperatureMapSizeX = 0;
+    int temperatureMapSizeY = 0;
+    int temperatureMapStride = 0;
+
+    // bit map of where the burner was drawn, 64 points per word
+    std::vector<uint64_t> burnerMap;
+    // the burner points (indices, sorted) and where every row starts in them, from burnerMap
+    std::vector<int> burnerCells;
+    std::vector<int> burnerRowStart;
+    // the rows of the tiles under it are scanned again by updateBurnerCells
+    BurnerBounds burnerDirty;
+    // half widths of the disc of capsuleDiameter at 0, 1, 2... rows from its centre
+    std::vector<int> capsuleSpans;
+    int capsuleDiameter = -1;
+
+    PlateGrid<double> temperatureMapL0;         // Burner map, under main stove top
+    PlateGrid<double> temperatureBuffers[2];    // the two stove temp maps, swapped every step
+    double *temperatureMapL2 = nullptr;        // Previous state stove temp map
+    double *temperatureMapL3 = nullptr;       // Current state stove temp map
+
+    // stencil row kernel, the best one the CPU supports unless set otherwise
+    KernelIsa kernelIsa = detectKernelIsa();
+    StencilRowKernel stencilRow = stencilRowKernel(kernelIsa);
+    FloatStencilRowKernel floatStencilRow = floatStencilRowKernel(kernelIsa);
+    MixedStencilRowKernel mixedStencilRow = mixedStencilRowKernel(kernelIsa);
+    LayeredStencilRowKernel layeredStencilRow = layeredStencilRowKernel(kernelIsa);
+    LayerSweepRowKernel layerSweepRow = layerSweepRowKernel(kernelIsa);
+    MonitoredStencilRowKernel monitoredStencilRow = monitoredStencilRowKernel(kernelIsa);
+
+    // the plate in float while the float and mixed precision steps run, the heater too in float precision
+    Precision precision = Precision::Double;
+    PlateGrid<float> floatBuffers[2];
+    PlateGrid<float> floatHeater;
+
+    /* layered plate, z-blocked: a grid of sizeY*plateLayers rows where plate row y holds the
+     * row y of every layer, bottom to top, so the z neighbours of a point are one row stride
+     * apart and the three plate rows read by the stencil (all their layers) stay in cache */
+    int plateLayers = 1;
+    PlateGrid<double> layerBuffers[2];
+    int currentLayers = 0;                     // the buffer of the current state
+    std::vector<double> layerSweep;            // per layer: the pivot and the upper factor of the z solve
+
+    // implicit integrators, their time step is timeStepFactor times the explicit stability limit
+    Integrator integrator = Integrator::Explicit;
+    double timeStepFactor = 20.;
+    AdiSolver adiSolver;
+    MultigridSolver multigridSolver;
+    RkcSolver rkcSolver;             // its first step is the explicit limit, then it adapts
+
+    // temporal blocking: number of steps done in one sweep over the plate, 1 - off
+    int temporalBlockSteps = 1;
+    std::vector<std::vector<double>> blockScratch; // ring buffer and halo heater of every worker
+
+    /* active tiles: the points far from the burner all follow the same uniform
+     * ambientTemperature, a tile is only stepped once the heat (or the cold border)
+     * spreading from its neighbours deviates from it by more than activeTileEpsilon;
+     * an inactive tile is exactly at ambientTemperature (only the edges read by active
+     * neighbours are stored), the active ones stay active */
+    bool activeTileTracking = false;
+    double activeTileEpsilon = 1e-3;
+    double ambientTemperature = outsideTemperature;
+    int tileCountX = 0;
+    int tileCountY = 0;
+    std::vector<char> activeTiles;
+    std::vector<char> burnerTiles;           // tiles with burner points
+    std::vector<char> spreadingTiles[2];     // deviating edges of the active tiles, by step parity
+
+    // persistent threads for calcHeatingSteps, none if single threaded
+    std::unique_ptr<WorkerPool> workerPool;
+
+    // convergence monitor, the statistics of the last step of every worker
+    bool steadyStateMonitor = false;
+    StepStatistics lastStepStatistics;
+    std::vector<StencilRowStats> workerStats;
+    int lastSteadyStateIterations = 0;
+
+    // see setInterruptFlag, stepsToTake is the number of steps of the worker loop being ran
+    const std::atomic<bool> *interruptFlag = nullptr;
+    std::atomic<int> stepsToTake{0};
+
+    long long currentSimulationStep = 0;
+    double simulatedTime = 0;              // in seconds
+
+    // simulation variables
+    bool burnerOn = false;
+    double alpha = 5.;               // Thermal diffusivity in mm^2/s, denepds on stove top material, which can be changed
+    double maxTimeStep = 0.1;       // time step is never larger than this, in seconds
+    double timeStep = 0.002;       // 1/(2*alpha*(1/dx^2 + 1/dy^2 + 1/dz^2)) (no z term with layers), in seconds; updated when alpha is changed
+    int W = 5000;                 // Total power supplied, Wh; user will be able to change it
+    double power = 0;            // power = f(W), shows the temperature increase of the burner based on W
+    int numberOfBurnerPixels = 0;// number of pixels coloured as a burner
+    int powerPixels = 0;        // the burner of the whole plate if this is a block of it, see setPowerPixels
+};
+
+#endif // HEATSOLVER_H
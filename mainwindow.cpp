@@ -12,7 +12,87 @@ MainWindow::MainWindow(QWidget *parent)
 
     connect(ui->drawArea, SIGNAL(signalError()), this, SLOT(errorMessage()));
     connect(ui->drawArea, SIGNAL(signalNoErrors()), this, SLOT(errorMessage()));
-
+    connect(ui->drawArea, SIGNAL(signalCheckpointWritten(QString,QString)), this, SLOT(checkpointMessage(QString,QString)));
+    connect(ui->drawArea, SIGNAL(signalSteadyStateReached(double,double,bool)), this, SLOT(steadyStateMessage(double,double,bool)));
+    connect(ui->drawArea, SIGNAL(signalSimulationRate(double,double)), this, SLOT(showSimulationRate(double,double)));
+
+    layersBox = new QSpinBox(this);
+    layersBox->setRange(1, HeatSolver::maxPlateLayers);
+    layersBox->setSuffix(" layers");
+    layersBox->setToolTip("Layers through the thickness of the top, 1 - a single layer");
+    ui->statusbar->addPermanentWidget(layersBox);
+    connect(layersBox, SIGNAL(valueChanged(int)), this, SLOT(setPlateLayers(int)));
+
+    pauseButton = new QPushButton("Pause", this);
+    pauseButton->setCheckable(true);
+    stepButton = new QPushButton("Step", this);
+    stepButton->setEnabled(false);
+    stepsBox = new QSpinBox(this);
+    stepsBox->setRange(1, 100000);
+    stepsBox->setSuffix(" steps");
+    stepsBox->setToolTip("Steps done by Step while paused");
+    ui->statusbar->addPermanentWidget(pauseButton);
+    ui->statusbar->addPermanentWidget(stepButton);
+    ui->statusbar->addPermanentWidget(stepsBox);
+    connect(pauseButton, SIGNAL(toggled(bool)), this, SLOT(pauseSimulation(bool)));
+    connect(stepButton, SIGNAL(released()), this, SLOT(stepSimulation()));
+
+    // in the order of SteadyStateAction
+    steadyStateBox = new QComboBox(this);
+    steadyStateBox->addItems({"Run on", "Stop when steady", "Jump to equilibrium"});
+    steadyStateBox->setToolTip("What the simulation does once the plate stops changing");
+    ui->statusbar->addPermanentWidget(steadyStateBox);
+    connect(steadyStateBox, SIGNAL(currentIndexChanged(int)), this, SLOT(setSteadyStateAction(int)));
+
+    // 0 is shown as the special text, the thread takes anything above it as at least minRealTimeFactor
+    speedBox = new QDoubleSpinBox(this);
+    speedBox->setRange(0, SimulationThread::maxRealTimeFactor);
+    speedBox->setDecimals(1);
+    speedBox->setStepType(QAbstractSpinBox::AdaptiveDecimalStepType);
+    speedBox->setSpecialValueText("max speed");
+    speedBox->setSuffix("x");
+    speedBox->setValue(1.);
+    speedBox->setToolTip("Simulated seconds per second of wall time, 0 - as fast as possible");
+    rateLabel = new QLabel(this);
+    rateLabel->setToolTip("Simulated time and simulated seconds per second of wall time achieved");
+    ui->statusbar->addPermanentWidget(speedBox);
+    ui->statusbar->addPermanentWidget(rateLabel);
+    connect(speedBox, SIGNAL(valueChanged(double)), this, SLOT(setRealTimeFactor(double)));
+
+    Profiler::instance().setThreadName("ui");
+    profileBox = new QCheckBox("Profile", this);
+    profileLabel = new QLabel(this);
+    traceWindow = new QSpinBox(this);
+    traceWindow->setRange(1, 60);
+    traceWindow->setValue(5);
+    traceWindow->setSuffix(" s");
+    traceWindow->setToolTip("Length of the saved trace, the last seconds");
+    traceButton = new QPushButton("Save trace", this);
+    ui->statusbar->addPermanentWidget(profileLabel);
+    ui->statusbar->addPermanentWidget(profileBox);
+    ui->statusbar->addPermanentWidget(traceWindow);
+    ui->statusbar->addPermanentWidget(traceButton);
+    profileTimer = new QTimer(this);
+
+    connect(profileBox, SIGNAL(toggled(bool)), this, SLOT(setProfiling(bool)));
+    connect(profileTimer, SIGNAL(timeout()), this, SLOT(updateProfile()));
+    connect(traceButton, SIGNAL(released()), this, SLOT(saveTrace()));
+
+    playbackSlider = new QSlider(Qt::Horizontal, this);
+    playbackSlider->setMinimumWidth(200);
+    playButton = new QPushButton("Play", this);
+    playbackLabel = new QLabel(this);
+    ui->statusbar->addWidget(playbackSlider);
+    ui->statusbar->addWidget(playButton);
+    ui->statusbar->addWidget(playbackLabel);
+    playbackSlider->hide();
+    playButton->hide();
+    playbackLabel->hide();
+    playbackTimer = new QTimer(this);
+
+    connect(playbackSlider, SIGNAL(valueChanged(int)), this, SLOT(showRecordedFrame(int)));
+    connect(playButton, SIGNAL(released()), this, SLOT(togglePlayback()));
+    connect(playbackTimer, SIGNAL(timeout()), this, SLOT(nextRecordedFrame()));
 }
 
 MainWindow::~MainWindow()
@@ -30,18 +110,101 @@ void MainWindow::errorMessage(int errIndex)
     }
 }
 
+void MainWindow::setPlateLayers(int layers){
+    ui->drawArea->setPlateLayers(layers);
+}
+
+void MainWindow::setSteadyStateAction(int index){
+    ui->drawArea->setSteadyStateAction(static_cast<SteadyStateAction>(index));
+}
+
+void MainWindow::steadyStateMessage(double simulatedTime, double secondsToSteady, bool solved){
+    pauseButton->setChecked(false);
+    if (!solved){
+        ui->statusbar->showMessage(QString("Steady state reached after %1 s.").arg(simulatedTime, 0, 'f', 1));
+    }
+    else if (secondsToSteady < 0){
+        ui->statusbar->showMessage(QString("Jumped to the equilibrium at %1 s.").arg(simulatedTime, 0, 'f', 1));
+    }
+    else {
+        ui->statusbar->showMessage(QString("Jumped to the equilibrium at %1 s, about %2 s of simulated time skipped.")
+                                   .arg(simulatedTime, 0, 'f', 1).arg(secondsToSteady, 0, 'f', 0));
+    }
+}
+
+void MainWindow::setRealTimeFactor(double factor){
+    ui->drawArea->setRealTimeFactor(factor);
+}
+
+void MainWindow::showSimulationRate(double simulatedTime, double realTimeFactor){
+    rateLabel->setText(QString("%1 s, %2x").arg(simulatedTime, 0, 'f', 1).arg(realTimeFactor, 0, 'g', 3));
+}
+
+void MainWindow::setProfiling(bool enabled){
+    Profiler::instance().setEnabled(enabled);
+    if (enabled){
+        lastProfile = Profiler::instance().totals();
+        profileClock.start();
+        profileTimer->start(profilePeriod);
+    }
+    else {
+        profileTimer->stop();
+        profileLabel->clear();
+    }
+}
+
+void MainWindow::updateProfile(){
+    // time spent in every phase per second of wall time, summed over the threads
+    const ProfileTotals totals = Profiler::instance().totals();
+    const double seconds = profileClock.restart() / 1000.;
+    QStringList phases;
+    for (int i = 0; i < profilePhaseCount; ++i){
+        if (totals.calls[i] == lastProfile.calls[i] || seconds <= 0) continue;
+        const double milliseconds = (totals.nanoseconds[i] - lastProfile.nanoseconds[i]) / 1e6 / seconds;
+        phases << QString("%1 %2").arg(profilePhaseName(static_cast<ProfilePhase>(i))).arg(milliseconds, 0, 'f', 1);
+    }
+    profileLabel->setText(phases.isEmpty() ? QString() : "ms/s: " + phases.join(", "));
+    lastProfile = totals;
+}
+
+void MainWindow::saveTrace(){
+    // the phases of the last traceWindow seconds, as far as the ring buffers reach
+    const QString fileName = QFileDialog::getSaveFileName(this, "Save trace", "stove-trace.json",
+                                                          "Chrome trace (*.json)");
+    if (fileName.isEmpty()) return;
+    const uint64_t to = Profiler::instance().now();
+    const uint64_t window = static_cast<uint64_t>(traceWindow->value()) * 1000000000ULL;
+    std::ostringstream trace;
+    const size_t count = Profiler::instance().writeChromeTrace(trace, to > window ? to - window : 0, to);
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)){
+        ui->statusbar->showMessage("Can not write " + fileName);
+        return;
+    }
+    const std::string json = trace.str();
+    file.write(json.data(), static_cast<qint64>(json.size()));
+    ui->statusbar->showMessage(QString("%1 phases written to %2").arg(count).arg(fileName), 5000);
+}
+
 //______________________________________________DRAW AREA CLASS________________//
 DrawArea::DrawArea(QWidget *parent)
     : QWidget(parent){
-    timeStep = qMin(static_cast<double>(timerPeriod/1000.), xStep * yStep / 4. / alpha);
+    solver.setMaxTimeStep(timerPeriod/1000.);
+    // only the tiles reached by the heat are stepped and painted
+    solver.setActiveTileTracking(true);
+    solver.setActiveTileEpsilon(activeTileEpsilon);
     timer = new QTimer(this);
 
     connect(timer, SIGNAL(timeout()), this, SLOT(paintTemperatureMap()));
-    connect(timer, SIGNAL(timeout()), this, SLOT(doSimulation()));
-    connect(this, SIGNAL(signalDoSimulation()), this, SLOT(doSimulation()));
     connect(this, SIGNAL(signalCreateBurnerMap()), this, SLOT(createBurnerMap()));
     connect(this, SIGNAL(signalCreateTemperatureLayers()), this, SLOT(createTemperatureMapLayers()));
     connect(this, SIGNAL(signalAlphaUpdated()), this, SLOT(updateTimeStep()));
+    connect(&simulationThread, SIGNAL(checkpointWritten(QString,QString)), this, SIGNAL(signalCheckpointWritten(QString,QString)));
+    connect(&simulationThread, SIGNAL(steadyStateReached(double,double,bool)), this, SLOT(steadyStateReached(double,double,bool)));
+    connect(&simulationThread, SIGNAL(finished()), this, SLOT(simulationFinished()));
+    simulationThread.setRecorder(&recorder);
+    simulationThread.setRealTimeFactor(defaultRealTimeFactor);
 }
 
 
@@ -57,64 +220,132 @@ void DrawArea::setPenColor(const QColor &newColor){
 }
 
 void DrawArea::setNumberOfThreads(int newThreads){
+    // 0 and 1 are both single threaded, the worker pool is kept between the frames
     numberOfThreads = newThreads;
+    simulationThread.setNumberOfThreads(newThreads);
+    if (!simulationRunning) solver.setNumberOfThreads(newThreads);
 }
 
+/* while the simulation runs the solver belongs to the simulation thread,
+ * the settings are passed to it and applied between two batches of steps */
 void DrawArea::setAlpha(double newAlpha){
-    alpha = newAlpha;
+    simulationThread.setAlpha(newAlpha);
+    if (simulationRunning) return;
+    solver.setAlpha(newAlpha);
     emit signalAlphaUpdated(); // signal to update time step
 }
 
+void DrawArea::setPlateLayers(int layers){
+    // the single layer model has a z term in its time step limit, the layered one solves z implicitly
+    simulationThread.setPlateLayers(layers);
+    if (simulationRunning) return;
+    solver.setPlateLayers(layers);
+    emit signalAlphaUpdated();
+}
+
 void DrawArea::setWatts(int newW){
-    W = newW;
+    simulationThread.setWatts(newW);
+    if (!simulationRunning) solver.setWatts(newW);
 }
 
 void DrawArea::setBurner(bool status){
-    burnerOn = status;
+    simulationThread.setBurner(status);
+    if (!simulationRunning) solver.setBurner(status);
 }
 
 void DrawArea::updatePower(){
-    if (numberOfBurnerPixels == 0) return;
-    // convert watts/hour into watts/second and then to temperature increase per second
-    // volHeatCapCu indicates how much energy is needed to increase the temperature of
-    // 1 mm^3 of Cu by 1 K, our volume is number of pixels * size of one pixel
-    power = W/3600. / (numberOfBurnerPixels*xStep*yStep*burnerSizeZ * volHeatCapCu);
+    if (simulationRunning) return;
+    solver.updatePower();
 }
 
 void DrawArea::setSimulation(){
-    numberOfBurnerPixels = 0;
-    for (int x = 0; x < temperatureMapSizeX; ++x){
-        for (int y = 0; y < temperatureMapSizeY; ++y){
-            if (burnerMap[x][y]){
-                ++numberOfBurnerPixels;
-            }
-        }
-    }
-    updatePower();
+    // the solver belongs to the simulation thread while it runs
+    if (simulationRunning) return;
+    // count the burner pixels, power per pixel depends on it
+    solver.countBurnerPixels();
 }
 
 void DrawArea::stopSimulation(){
     simulationRunning = false;
     timer->stop();
+    // waits for the current batch of steps, the solver is the UI's again
+    simulationThread.stopSimulation();
 }
 
-double DrawArea::getDeltaT(int x, int y){
-    if (burnerMap[x][y]) {
-        return power;
+bool DrawArea::saveCheckpoint(const QString &fileName, QString *error){
+    // the simulation thread captures the state after its current batch, the UI does not wait
+    if (simulationRunning){
+        simulationThread.requestCheckpoint(fileName);
+        return true;
     }
-    return 0;
+    Checkpoint checkpoint;
+    checkpoint.capture(solver);
+    return checkpoint.write(fileName, error);
 }
 
-/*void DrawArea::pauseSimulation(){
-    if (simulationRunning){
-        timer->stop();
-        simulationRunning = false;
-    }
-    else{
-        timer->start(timerPeriod);
-        simulationRunning = true;
-    }
-}*/// currently not used
+bool DrawArea::restoreCheckpoint(const QString &fileName, QString *error){
+    stopSimulation();
+    // the plate is one point per pixel of the draw area, only a plate of its size fits
+    if (!Checkpoint::restore(solver, fileName, error, image.size())) return false;
+    // the settings waiting for the next run would override the restored ones
+    simulationThread.setWatts(solver.getWatts());
+    simulationThread.setAlpha(solver.getAlpha());
+    simulationThread.setBurner(solver.isBurnerOn());
+    simulationThread.setPlateLayers(solver.getPlateLayers());
+    return true;
+}
+
+void DrawArea::setAutosave(const QString &fileName){
+    simulationThread.setPeriodicCheckpoint(fileName, autosavePeriod);
+}
+
+bool DrawArea::startRecording(const QString &fileName, double cadence, QString *error){
+    // the recorder can be started and stopped while the simulation runs
+    return recorder.start(fileName, cadence, error);
+}
+
+void DrawArea::stopRecording(){
+    recorder.stop();
+}
+
+int DrawArea::openRecording(const QString &fileName, QString *error){
+    stopSimulation();
+    if (!player.open(fileName, error)) return 0;
+    image.fill(qRgb(0,0,0));
+    paintedAmbientColor = 0;
+    update();
+    showRecordedFrame(0);
+    return player.frameCount();
+}
+
+bool DrawArea::showRecordedFrame(int frame){
+    if (!player.readFrame(frame, playbackFrame)) return false;
+    paintFrame(playbackFrame);
+    return true;
+}
+
+void DrawArea::closeRecording(){
+    player.close();
+}
+
+void DrawArea::pauseSimulation(bool paused){
+    // the timer keeps painting the frames published by the single steps
+    if (!simulationRunning) return;
+    if (paused) simulationThread.pauseSimulation();
+    else simulationThread.resumeSimulation();
+}
+
+void DrawArea::stepSimulation(int steps){
+    if (simulationRunning) simulationThread.stepSimulation(steps);
+}
+
+void DrawArea::setSteadyStateAction(SteadyStateAction action){
+    simulationThread.setSteadyStateAction(action, steadyStateTolerance);
+}
+
+void DrawArea::setRealTimeFactor(double factor){
+    simulationThread.setRealTimeFactor(factor);
+}
 
 
 
@@ -124,10 +355,11 @@ double DrawArea::getDeltaT(int x, int y){
 void DrawArea::updateTimeStep(){
     // time step is calc from simulation parameters,
     // but it can not be less than screen update time step
-    timeStep = qMin(static_cast<double>(timerPeriod/1000.), xStep * yStep / 4. / alpha);
+    solver.setMaxTimeStep(timerPeriod/1000.);
 }
 
 void DrawArea::clearImage(){
+    closeRecording();
     image.fill(qRgb(255,255,255));
     createBurnerMap();
     createTemperatureMapLayers();
@@ -135,29 +367,17 @@ void DrawArea::clearImage(){
 }
 
 void DrawArea::createBurnerMap(){
-    burnerMap.clear();
-    burnerMap.squeeze(); /* squeeze is needed for resize option,
-                           shoud it ever be implemented */
-    for (int i = 0; i < this->width(); ++i){
-        // fill the map with falses
-        QVector<bool> row(this->height(), false);
-        burnerMap.append(row);
-    }
-    /*qDebug() << "Burner map created, width: "
-             << burnerMap.size() << ", height: " << burnerMap[0].size();*/
+    // the solver belongs to the simulation thread while it runs
+    if (simulationRunning) return;
+    // fill the map with falses
+    solver.clearBurnerMap();
 }
 
 void DrawArea::createTemperatureMapLayers(){
     /* fill temperature layers for simulation
      * with outside temperature */
-    for (int x = 0; x < temperatureMapSizeX; ++x){
-        for (int y = 0; y < temperatureMapSizeY; ++y){
-            temperatureMapL0[x][y] = outsideTemperature;
-            temperatureMapL1[x][y] = outsideTemperature;
-            temperatureMapL2[x][y] = outsideTemperature;
-            temperatureMapL3[x][y] = outsideTemperature;
-        }
-    }
+    if (simulationRunning) return;
+    solver.resetTemperatureMapLayers();
 }
 
 void DrawArea::paintBurnerMap(){
@@ -171,9 +391,9 @@ void DrawArea::paintBurnerMap(){
     setPenColor(Qt::red);
     setPenWidth(1);
     painter.setPen(QPen(myPenColor, myPenWidth, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
-    for (int i = 0; i < burnerMap.size(); ++i){
-        for (int j = 0; j < burnerMap[0].size(); ++j){
-            if (burnerMap[i][j]) painter.drawPoint(i,j);
+    for (int i = 0; i < solver.sizeX(); ++i){
+        for (int j = 0; j < solver.sizeY(); ++j){
+            if (solver.isBurnerCell(i,j)) painter.drawPoint(i,j);
         }
     }
     setPenWidth(currentPenWidth);
@@ -181,99 +401,99 @@ void DrawArea::paintBurnerMap(){
 }
 
 void DrawArea::paintTemperatureMap(){
-    /* this function draws the current state of the simulation */
-    // use current image for painting
-    QPainter painter(&image);
-    // save the user defined pen width
-    int currentPenWidth = penWidth();
-    // set our pen width to 1 pixel
-    setPenWidth(1);
-
-    for (int x = 0; x < temperatureMapSizeX; ++x){
-        for (int y = 0; y < temperatureMapSizeY; ++y){
-            /* for each point in the temperature map draw a pixel,
-             * the color of which corresponds to the temperature 1 to 1,
-             * 0-255 : red, 256-510 : full_red+green, 511-766 : full_red+full_green+blue
-             * i.e. colour goes from black at T = 0 to white at T = 766,
-             * heaviside function give value > 0 ? value : 0 */
-            setPenColor(qRgb
-                        (qMin(255., temperatureMapL3[x][y]),
-                         qMin(255. , heaviside(temperatureMapL3[x][y] - 255.)),
-                         qMin(255. , heaviside(temperatureMapL3[x][y] - 510.))));
-            painter.setPen(QPen(myPenColor, myPenWidth));
-            painter.drawPoint(x, y);
+    /* this function draws the newest frame of the simulation thread straight into
+     * the pixels of the image, bands of tile rows in parallel */
+    if (!simulationThread.takeFrame()) return;
+    const SimulationFrame &frame = simulationThread.frame();
+    // max simulation step is for safety, will be removed in release
+    if (frame.step >= simulationStepLimit) qDebug() << "Maximum simulation step reached.";
+    paintFrame(frame);
+    emit signalSimulationRate(frame.simulatedTime, frame.realTimeFactor);
+}
+
+void DrawArea::paintFrame(const SimulationFrame &frame){
+    ProfileScope scope(ProfilePhase::Colormap);
+
+    const int tileCountX = frame.tileCountX;
+    const int tileCountY = frame.tileCountY;
+    const QRgb ambientColor = temperaturePainter.temperatureColor(frame.ambientTemperature);
+    const bool repaintAmbient = ambientColor != paintedAmbientColor;
+    dirtyTiles.fill(0, tileCountX * tileCountY);
+
+    // bits() and data() detach the image and the tiles here, not in the workers
+    uchar *pixels = image.bits();
+    char *dirty = dirtyTiles.data();
+    const int bands = qBound(1, numberOfThreads, tileCountY);
+    auto paintBand = [this, &frame, pixels, dirty, bands, tileCountY, ambientColor, repaintAmbient](int &band){
+        temperaturePainter.paintTileRows(frame, pixels, image.width(), image.height(), image.bytesPerLine(),
+                                         tileCountY * band / bands, tileCountY * (band+1) / bands,
+                                         ambientColor, repaintAmbient, dirty);
+    };
+    QVector<int> bandIndices(bands);
+    std::iota(bandIndices.begin(), bandIndices.end(), 0);
+    if (bands == 1) paintBand(bandIndices[0]);
+    else QtConcurrent::blockingMap(bandIndices, paintBand);
+    paintedAmbientColor = ambientColor;
+
+    // only the tiles with a changed colour are repainted on the widget
+    const int tileSize = HeatSolver::tileSize;
+    for (int tileY = 0; tileY < tileCountY; ++tileY){
+        for (int tileX = 0; tileX < tileCountX; ++tileX){
+            if (dirtyTiles[tileY * tileCountX + tileX]) update(tileX*tileSize, tileY*tileSize, tileSize, tileSize);
         }
     }
-
-    // restore user defined pen width
-    setPenWidth(currentPenWidth);
-    update();
-
 }
 
 void DrawArea::startSimulation()
 {
+    // the running thread would ignore the start, the image and the step limit stay
+    if (simulationRunning) return;
     // if nothing is drawn, emit error, do not start simulation
-    if (numberOfBurnerPixels == 0){
+    if (solver.getNumberOfBurnerPixels() == 0){
         emit signalError(1);
         return;
     }
     emit signalNoErrors(0);
+    closeRecording();
     image.fill(qRgb(0,0,0));
+    paintedAmbientColor = 0;
     update();
-    currentSimulationStep = 0;
-    // start timer which is connected to doSimulation
-    timer->start(timerPeriod);
+    // the step counter goes on from the previous run or from a restored checkpoint
+    simulationStepLimit = solver.getCurrentStep() + maxSimulationSteps;
+    // the simulation thread steps as fast as it can, the timer paints its newest frame
     simulationRunning = true;
-    // start first simulation without waiting for 1st timer timeout
-    emit signalDoSimulation();
+    simulationThread.startSimulation(simulationStepLimit);
+    timer->start(timerPeriod);
 }
 
-void DrawArea::doSimulation()
-{
-    // max simulation step is for safety, will be removed in release
-    if (currentSimulationStep >= maxSimulationSteps) qDebug() << "Maximum simulation step reached.";
-    if (!simulationRunning || currentSimulationStep > maxSimulationSteps) return;
-
-    // do not start new simulation if the old one is not complete
-    if (multithreadRunning) return;
-
-    QElapsedTimer simulationStepTimer;
-    simulationStepTimer.start();
-
-    for (int i = 0; i < static_cast<int>(timerPeriod / timeStep / 1000); ++i){
-        if (numberOfThreads == 0) calcHeatingStep();
-        else calcHeatingStepParallel(numberOfThreads);
-
-        for (int x = 0; x < temperatureMapSizeX; ++x){
-            for(int y = 0; y < temperatureMapSizeY; ++y){
-                temperatureMapL2[x][y] = temperatureMapL3[x][y];
-            }
-        }
+void DrawArea::steadyStateReached(double simulatedTime, double secondsToSteady, bool solved){
+    // the thread ends on its own after its last frame, simulationFinished follows
+    emit signalSteadyStateReached(simulatedTime, secondsToSteady, solved);
+}
 
-        ++currentSimulationStep;
-    }
-    /*qDebug() << "The whole simulation instance (" << static_cast<int>(timerPeriod / timeStep / 1000) << " steps) took "
-             << simulationStepTimer.elapsed() << "milliseconds. " << "Central point: " << temperatureMapL3[100][100]
-             << " Heater centre: " << temperatureMapL0[100][100] << " Time step: " << timeStep << "Alpha: " << alpha << "\n";*/
+void DrawArea::simulationFinished(){
+    // queued, a new run may have been started in between
+    if (simulationThread.isRunning()) return;
+    simulationRunning = false;
+    timer->stop();
+    paintTemperatureMap();
 }
 
 /*                                             PROTECTED METHODS                                */
 void DrawArea::mousePressEvent(QMouseEvent *event){
     // functions untill "addBurnerRegion" are from sample examples, you may skip them
-    if (simulationRunning) return;
+    // nothing is drawn over a recording played back
+    if (simulationRunning || player.isOpen()) return;
 
     if (event->button() == Qt::LeftButton) {
         lastPoint = event->pos();
         drawLineTo(event->pos(), true);
-        addBurnerRegion(event->pos(), penWidth());
         drawing = true;
         clearing = false;
     }
     if (event->button() == Qt::RightButton) {
         lastPoint = event->pos();
         drawLineTo(event->pos(), false);
-        removeBurnerRegion(event->pos(), penWidth());
         clearing = true;
         drawing = false;
     }
@@ -306,20 +526,22 @@ void DrawArea::mouseReleaseEvent(QMouseEvent *event){
 }
 
 void DrawArea::paintEvent(QPaintEvent *event){
+    ProfileScope scope(ProfilePhase::Blit);
     QPainter painter(this);
     QRect dirtyRect = event->rect();
     painter.drawImage(dirtyRect, image, dirtyRect);
 }
 
 void DrawArea::drawLineTo(const QPoint &endPoint, bool drawStatus){
+    // the burner map gets the same round capped segment as the image
     QPainter painter(&image);
     if (drawStatus) {
-        addBurnerRegion(endPoint, penWidth());
+        addBurnerRegion(lastPoint, endPoint, penWidth());
         setPenColor(Qt::black);
     }
     else{
         setPenColor(Qt::white);
-        removeBurnerRegion(endPoint, penWidth());
+        removeBurnerRegion(lastPoint, endPoint, penWidth());
     }
 
     painter.setPen(QPen(myPenColor, myPenWidth, Qt::SolidLine, Qt::RoundCap));
@@ -351,6 +573,10 @@ void DrawArea::resizeEvent (QResizeEvent *event){
         update();
     }
     QWidget::resizeEvent(event);
+    // the plate has one point per pixel of the draw area, it is reset only when its size has to change
+    if (simulationRunning) return;
+    if (solver.sizeX() == image.width() && solver.sizeY() == image.height()) return;
+    solver.resize(image.width(), image.height());
     emit signalCreateBurnerMap();
     emit signalCreateTemperatureLayers();
 }
@@ -369,146 +595,19 @@ void DrawArea::resizeImage(QImage *image, const QSize &newSize){
 
 
 
-void DrawArea::addBurnerRegion(QPoint pos, int penWidth){
+void DrawArea::addBurnerRegion(QPoint from, QPoint to, int penWidth){
     // do not do anything is the simulation is running
     if (simulationRunning) return;
 
-    /* some specific math to define a circle of diameter penWidth
-     * and fill the burnerMap with true within this circle */
-    int yMin = qMax(0, pos.y() - int(penWidth/2));
-    int yMax = qMin(burnerMap[0].size(), pos.y() + int(penWidth/2));
-
-    for (int y = yMin; y < yMax; ++y ){
-        int offset = qSqrt((penWidth/2)*(penWidth/2) - (y - pos.y())*(y - pos.y()));
-        int xMin = qMax(0, pos.x() - offset);
-        int xMax = qMin(burnerMap.size(), pos.x() + offset);
-
-        for (int x = xMin; x < xMax; ++x){
-            burnerMap[x][y] = true;
-        }
-    }
+    // fill the burnerMap with true within the stroke of diameter penWidth from one point to the other
+    solver.setBurnerCapsule(from.x(), from.y(), to.x(), to.y(), penWidth, true);
 }
 
-void DrawArea::removeBurnerRegion(QPoint pos, int penWidth){
+void DrawArea::removeBurnerRegion(QPoint from, QPoint to, int penWidth){
     // same as addBurnerRegion, but remove (false instead of true)
     if (simulationRunning) return;
 
-    int yMin = qMax(0, pos.y() - int(penWidth/2));
-    int yMax = qMin(burnerMap[0].size(), pos.y() + int(penWidth/2));
-
-    for (int y = yMin; y < yMax; ++y ){
-        int offset = qSqrt((penWidth/2)*(penWidth/2) - (y - pos.y())*(y - pos.y()));
-        int xMin = qMax(0, pos.x() - offset);
-        int xMax = qMin(burnerMap.size(), pos.x() + offset);
-
-        for (int x = xMin; x < xMax; ++x){
-            burnerMap[x][y] = false;
-        }
-    }
-}
-
-void DrawArea::calcHeatingStep()
-{
-    // we are not calculating at border points, constant boundary condition works there
-
-    /* first we calculate the current temperature of the burner,
-     * calculation only at the point where burner is drawn.
-     * Approximation - burner cools down at the same rate as it
-     * heats up. If burner is on, we heat, if off, we cool untill outside temp */
-    for (int x = 0; x < temperatureMapSizeX; ++x){
-        for (int y = 0; y < temperatureMapSizeY; ++y){
-            if (burnerMap[x][y]){
-                if (burnerOn) {
-                    temperatureMapL0[x][y] = temperatureMapL0[x][y] + timeStep * (
-                                getDeltaT(x,y) *
-                                std::pow((maxHeaterTemp - temperatureMapL0[x][y])/maxHeaterTemp, 2));
-                }
-                else {
-                    temperatureMapL0[x][y] = qMax(outsideTemperature,
-                                                  temperatureMapL0[x][y] - timeStep * getDeltaT(x,y)); }
-            }
-        }
-    }
-
-    /* simple solution of a differential equation, explicit type.
-     * for z it is outside temperature from the top
-     * and burner (temperatureMap0) from the bottom */
-    for (int x = 1; x < temperatureMapSizeX-1; ++x){
-        for (int y = 1; y < temperatureMapSizeY-1; ++y){
-            temperatureMapL3[x][y] = temperatureMapL2[x][y] + alpha*timeStep * (
-                        (temperatureMapL2[x+1][y] - 2*temperatureMapL2[x][y] + temperatureMapL2[x-1][y])/xStep/xStep +   // x
-                        (temperatureMapL2[x][y+1] - 2*temperatureMapL2[x][y] + temperatureMapL2[x][y-1])/yStep/yStep +   // y
-                        (qMin(outsideTemperature, temperatureMapL2[x][y]*0.7) - 2*temperatureMapL2[x][y] + temperatureMapL0[x][y])/zStep/zStep );          // z
-        }
-    }
-}
-
-void DrawArea::calcHeatingStepParallel(int numberOfThreads)
-{
-    // we are not calculating at border points, constant boundary conditions work there
-
-    int batch = (temperatureMapSizeX-2) / numberOfThreads;
-
-    multithreadRunning = true;
-    QVector<QFuture<void>> results(numberOfThreads);
-    for (int i = 0; i < numberOfThreads; ++i){
-        QFuture<void> future = QtConcurrent::run(&DrawArea::calcHeatingStepPartial, this, i*batch+1, (i+1)*batch+1);
-        results.push_back(future);
-    }
-
-    for (auto result : results){
-        if (!simulationRunning){
-            result.cancel();
-        }
-        result.waitForFinished();
-    }
-    multithreadRunning = false;
-}
-
-void DrawArea::calcHeatingStepPartial(QPromise<void> &promise, int xMin, int xMax)
-{   
-    // we are not calculating at border points, constant boundary condition works there
-    // although for burner is would be better to calculate
-
-    /* first we calculate the current temperature of the burner,
-     * calculation only at the point where burner is drawn.
-     * Approximation - burner cools down at the same rate as it
-     * heats up. If burner is on, we heat, if off, we cool untill outside temp */
-    for (int x = xMin; x < xMax; ++x){
-        for (int y = 1; y < temperatureMapSizeY-1; ++y){
-            // Cancel all calculations if needed
-            promise.suspendIfRequested();
-            if (promise.isCanceled()){
-                qDebug() << "Simulation aborted.";
-                return;
-            }
-
-            if (burnerMap[x][y]){
-                if (burnerOn) {
-                    // restrict heater from reachin maxHeaterTemp by multiplying getDeltaT by a coef
-                    // ranging from 1 at T = 0, to 0 at T = maxHeatingTemp
-                    temperatureMapL0[x][y] = temperatureMapL0[x][y] + timeStep * (
-                                getDeltaT(x,y) *
-                                std::pow((maxHeaterTemp - temperatureMapL0[x][y])/maxHeaterTemp, 2));
-                }
-                else {
-                    temperatureMapL0[x][y] = qMax(outsideTemperature,
-                                                  temperatureMapL0[x][y] - timeStep * getDeltaT(x,y)); }
-            }
-        }
-    }
-
-    /* simple solution of a differential equation, explicit type.
-     * for z it is outside temperature from the top
-     * and burner (temperatureMapL0) from the bottom */
-    for (int x = xMin; x < xMax; ++x){
-        for (int y = 1; y < temperatureMapSizeY-1; ++y){
-            temperatureMapL3[x][y] = temperatureMapL2[x][y] + alpha*timeStep * (
-                        (temperatureMapL2[x+1][y] - 2*temperatureMapL2[x][y] + temperatureMapL2[x-1][y])/xStep/xStep +   // x
-                        (temperatureMapL2[x][y+1] - 2*temperatureMapL2[x][y] + temperatureMapL2[x][y-1])/yStep/yStep +   // y
-                        (qMin(outsideTemperature, temperatureMapL2[x][y]*0.7) - temperatureMapL2[x][y] + temperatureMapL0[x][y])/zStep/zStep );  // z
-        }
-    }
+    solver.setBurnerCapsule(from.x(), from.y(), to.x(), to.y(), penWidth, false);
 }
 
 //______________________________________________Main Window________________//
@@ -521,6 +620,7 @@ void MainWindow::on_actionNew_triggered()
 
     ui->drawArea->stopSimulation();
     ui->drawArea->clearImage();
+    hidePlayback();
 }
 
 void MainWindow::on_actionExit_triggered()
@@ -550,21 +650,33 @@ void MainWindow::on_PenSize_valueChanged(int value)
 
 void MainWindow::on_startSimulation_released()
 {
+    if (ui->drawArea->isSimulationRunning()) return;
     ui->drawArea->setSimulation();
     ui->drawArea->startSimulation();
+    pauseButton->setChecked(false);
+    if (!ui->drawArea->isPlayingBack()) hidePlayback();
 }
 
 
 void MainWindow::on_stopSimulation_released()
 {
     ui->drawArea->stopSimulation();
+    pauseButton->setChecked(false);
 }
 
 
-/*void MainWindow::on_pauseSimulation_released()
+void MainWindow::pauseSimulation(bool paused)
 {
-    ui->drawArea->pauseSimulation();
-}*/
+    ui->drawArea->pauseSimulation(paused);
+    stepButton->setEnabled(ui->drawArea->isSimulationPaused());
+    if (paused && !ui->drawArea->isSimulationPaused()) pauseButton->setChecked(false);
+}
+
+
+void MainWindow::stepSimulation()
+{
+    ui->drawArea->stepSimulation(stepsBox->value());
+}
 
 
 void MainWindow::on_threadsNumber_valueChanged(int arg1)
@@ -633,3 +745,151 @@ void MainWindow::on_powerDial_valueChanged(int value)
     ui->labelPowerSupply->setText(QString("Power supply (in kWh) : ") + QString::number(watts));
 }
 
+
+void MainWindow::on_actionSaveState_triggered()
+{
+    const QString fileName = QFileDialog::getSaveFileName(this, "Save state", "stove.checkpoint",
+                                                          "Checkpoint (*.checkpoint)");
+    if (fileName.isEmpty()) return;
+    QString error;
+    if (!ui->drawArea->saveCheckpoint(fileName, &error)) ui->statusbar->showMessage(error);
+    else ui->statusbar->showMessage("Saving state to " + fileName, 5000);
+}
+
+
+void MainWindow::on_actionOpenState_triggered()
+{
+    const QString fileName = QFileDialog::getOpenFileName(this, "Open state", QString(), "Checkpoint (*.checkpoint)");
+    if (fileName.isEmpty()) return;
+    QString error;
+    if (!ui->drawArea->restoreCheckpoint(fileName, &error)){
+        ui->statusbar->showMessage(error);
+        return;
+    }
+    // the controls show the restored power, heater, material and layers without setting them again
+    const int watts = ui->drawArea->getWatts();
+    const QSignalBlocker blockDial(ui->powerDial);
+    const QSignalBlocker blockHeater(ui->HeaterOn);
+    const QSignalBlocker blockLayers(layersBox);
+    layersBox->setValue(ui->drawArea->getPlateLayers());
+    ui->powerDial->setValue(watts / 1000);
+    ui->labelPowerSupply->setText(QString("Power supply (in kWh) : ") + QString::number(watts / 1000.));
+    ui->HeaterOn->setChecked(ui->drawArea->isBurnerOn());
+    ui->HeaterOff->setChecked(!ui->drawArea->isBurnerOn());
+    ui->labelTopMaterial->setText(QString("Stove top diffusivity: ") + QString::number(ui->drawArea->getAlpha())
+                                  + " mm^2/s");
+    ui->statusbar->showMessage("State restored from " + fileName + ", start the simulation to resume it", 5000);
+}
+
+
+void MainWindow::on_actionAutosave_toggled(bool checked)
+{
+    if (!checked){
+        ui->drawArea->setAutosave(QString());
+        return;
+    }
+    const QString fileName = QFileDialog::getSaveFileName(this, "Save state every minute", "autosave.checkpoint",
+                                                          "Checkpoint (*.checkpoint)");
+    if (fileName.isEmpty()){
+        const QSignalBlocker block(ui->actionAutosave);
+        ui->actionAutosave->setChecked(false);
+        return;
+    }
+    ui->drawArea->setAutosave(fileName);
+}
+
+
+void MainWindow::on_actionRecord_toggled(bool checked)
+{
+    if (!checked){
+        ui->drawArea->stopRecording();
+        const FrameRecorder &recorder = ui->drawArea->getRecorder();
+        if (!recorder.errorString().isEmpty()) ui->statusbar->showMessage(recorder.errorString());
+        else ui->statusbar->showMessage(QString("%1 frames recorded, %2 dropped").arg(recorder.getRecordedFrames())
+                                        .arg(recorder.getDroppedFrames()), 5000);
+        return;
+    }
+    const QSignalBlocker block(ui->actionRecord);
+    const QString fileName = QFileDialog::getSaveFileName(this, "Record runs", "stove.recording",
+                                                          "Recording (*.recording)");
+    bool ok = !fileName.isEmpty();
+    const double cadence = ok ? QInputDialog::getDouble(this, "Record runs", "Simulated seconds between two frames "
+                                                        "(0 - every frame shown):", 0.1, 0, 3600, 3, &ok) : 0;
+    QString error;
+    if (ok && !ui->drawArea->startRecording(fileName, cadence, &error)){
+        ui->statusbar->showMessage(error);
+        ok = false;
+    }
+    ui->actionRecord->setChecked(ok);
+}
+
+
+void MainWindow::on_actionPlayRecording_triggered()
+{
+    const QString fileName = QFileDialog::getOpenFileName(this, "Play recording", QString(), "Recording (*.recording)");
+    if (fileName.isEmpty()) return;
+    playbackTimer->stop();
+    QString error;
+    const int frames = ui->drawArea->openRecording(fileName, &error);
+    if (frames == 0){
+        ui->statusbar->showMessage(error);
+        return;
+    }
+    const QSignalBlocker block(playbackSlider);
+    playbackSlider->setRange(0, frames - 1);
+    playbackSlider->setValue(0);
+    playButton->setText("Play");
+    playbackLabel->setText(QString("t = %1 s").arg(ui->drawArea->recordedFrameTime(0), 0, 'f', 2));
+    playbackSlider->show();
+    playButton->show();
+    playbackLabel->show();
+}
+
+
+void MainWindow::showRecordedFrame(int frame)
+{
+    if (!ui->drawArea->isPlayingBack()) return;
+    ui->drawArea->showRecordedFrame(frame);
+    playbackLabel->setText(QString("t = %1 s").arg(ui->drawArea->recordedFrameTime(frame), 0, 'f', 2));
+}
+
+
+void MainWindow::hidePlayback()
+{
+    playbackTimer->stop();
+    playbackSlider->hide();
+    playButton->hide();
+    playbackLabel->hide();
+}
+
+
+void MainWindow::togglePlayback()
+{
+    if (playbackTimer->isActive()){
+        playbackTimer->stop();
+        playButton->setText("Play");
+        return;
+    }
+    if (playbackSlider->value() == playbackSlider->maximum()) playbackSlider->setValue(0);
+    playbackTimer->start(SimulationThread::framePeriod);
+    playButton->setText("Pause");
+}
+
+
+void MainWindow::nextRecordedFrame()
+{
+    // at the rate of the frames published by a running simulation
+    if (playbackSlider->value() == playbackSlider->maximum()){
+        togglePlayback();
+        return;
+    }
+    playbackSlider->setValue(playbackSlider->value() + 1);
+}
+
+
+void MainWindow::checkpointMessage(const QString &fileName, const QString &error)
+{
+    if (error.isEmpty()) ui->statusbar->showMessage("State saved to " + fileName, 5000);
+    else ui->statusbar->showMessage(error);
+}
+
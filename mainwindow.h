@@ -9,6 +9,14 @@
 
 // Qt objects
 #include <QLabel>
+#include <QCheckBox>
+#include <QComboBox>
+#include <QSpinBox>
+#include <QDoubleSpinBox>
+#include <QPushButton>
+#include <QFileDialog>
+#include <QInputDialog>
+#include <QSlider>
 
 // Qt libs for painting
 #include <QPainter>
@@ -21,18 +29,30 @@
 #include <QHash>
 #include <QQueue>
 
+// Qt multithreading
+#include <QtConcurrent>
+
 // Qt timer
 #include <QTime>
 #include <QTimer>
 #include <QElapsedTimer>
 
-// Qt multithreading
-#include <QtConcurrent>
-
 // C++ chrono libs
 #include <chrono>
 #include <thread>
 
+// C++ algorithms
+#include <numeric>
+#include <sstream>
+
+// heat model
+#include "checkpoint.h"
+#include "framerecorder.h"
+#include "heatsolver.h"
+#include "profiler.h"
+#include "simulationthread.h"
+#include "temperaturepainter.h"
+
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
 QT_END_NAMESPACE
@@ -60,8 +80,6 @@ private slots:
 
     void on_stopSimulation_released();
 
-    // void on_pauseSimulation_released();
-
     void on_actionExit_triggered();
 
     void on_threadsNumber_valueChanged(int arg1);
@@ -82,8 +100,79 @@ private slots:
 
     void on_powerDial_valueChanged(int value);
 
+    void on_actionSaveState_triggered();
+
+    void on_actionOpenState_triggered();
+
+    void on_actionAutosave_toggled(bool checked);
+
+    void checkpointMessage(const QString &fileName, const QString &error);
+
+    void on_actionRecord_toggled(bool checked);
+
+    void on_actionPlayRecording_triggered();
+
+    void showRecordedFrame(int frame);
+
+    void togglePlayback();
+
+    void nextRecordedFrame();
+
+    void setPlateLayers(int layers);
+
+    void pauseSimulation(bool paused);
+
+    void stepSimulation();
+
+    void setSteadyStateAction(int index);
+
+    void steadyStateMessage(double simulatedTime, double secondsToSteady, bool solved);
+
+    void setRealTimeFactor(double factor);
+
+    void showSimulationRate(double simulatedTime, double realTimeFactor);
+
+    void setProfiling(bool enabled);
+
+    void updateProfile();
+
+    void saveTrace();
+
 private:
+    void hidePlayback();
+
     Ui::MainWindow *ui;
+
+    // layers through the thickness of the top
+    QSpinBox *layersBox;
+
+    // pause and single steps of the running simulation
+    QPushButton *pauseButton;
+    QPushButton *stepButton;
+    QSpinBox *stepsBox;
+
+    // run on, stop when steady or jump to the equilibrium
+    QComboBox *steadyStateBox;
+
+    // simulated seconds per wall second asked for, and the ones achieved
+    QDoubleSpinBox *speedBox;
+    QLabel *rateLabel;
+
+    // profiling: rolling averages of the phases in the status bar, a trace of the last seconds on demand
+    QCheckBox *profileBox;
+    QLabel *profileLabel;
+    QSpinBox *traceWindow;
+    QPushButton *traceButton;
+    QTimer *profileTimer;
+    QElapsedTimer profileClock;
+    ProfileTotals lastProfile;
+    const int profilePeriod = 1000;   // ms between two updates of the averages
+
+    // playback of a recording: scrub with the slider, play at the rate of the published frames
+    QSlider *playbackSlider;
+    QPushButton *playButton;
+    QLabel *playbackLabel;
+    QTimer *playbackTimer;
 };
 
 //______________________________________________Draw Area________________//
@@ -101,6 +190,8 @@ public:
 
     void setAlpha(double);
 
+    void setPlateLayers(int);
+
     void setWatts(int);
 
     void setBurner(bool);
@@ -111,16 +202,61 @@ public:
 
     void stopSimulation();
 
-    void pauseSimulation();
+    // the steps stop within one step, the painting goes on; no effect if nothing runs
+    void pauseSimulation(bool paused);
+
+    // while paused, steps more steps
+    void stepSimulation(int steps);
+
+    bool isSimulationRunning() const { return simulationRunning; }
+
+    bool isSimulationPaused() const { return simulationRunning && simulationThread.isPaused(); }
+
+    // also while the simulation runs, see SimulationThread::setSteadyStateAction
+    void setSteadyStateAction(SteadyStateAction action);
+
+    // simulated seconds per wall second, 0 - as fast as it can; also while the simulation runs
+    void setRealTimeFactor(double factor);
+
+    /* checkpoints of the whole state: written in the background while the simulation
+     * runs (signalCheckpointWritten tells when), restored with the simulation stopped */
+    bool saveCheckpoint(const QString &fileName, QString *error);
+
+    bool restoreCheckpoint(const QString &fileName, QString *error);
+
+    void setAutosave(const QString &fileName);
+
+    // recording of the frames of the runs, one every cadence seconds of simulated time
+    bool startRecording(const QString &fileName, double cadence, QString *error);
+
+    void stopRecording();
+
+    const FrameRecorder &getRecorder() const { return recorder; }
+
+    /* playback of a recording instead of the simulation, nothing is stepped; returns the
+     * number of frames, 0 if it can not be opened. Starting a simulation ends it */
+    int openRecording(const QString &fileName, QString *error);
+
+    bool showRecordedFrame(int frame);
+
+    double recordedFrameTime(int frame) const { return player.frameTime(frame); }
 
-    double getDeltaT(int x, int y);
+    void closeRecording();
+
+    bool isPlayingBack() const { return player.isOpen(); }
+
+    bool isBurnerOn() const { return solver.isBurnerOn(); }
+
+    double getAlpha() const { return solver.getAlpha(); }
+
+    int getPlateLayers() const { return solver.getPlateLayers(); }
 
     int penWidth() { return myPenWidth; }
 
-    int getWatts() { return W; }
+    int getWatts() { return simulationThread.getWatts(); }
 
     template <typename T>
-    T heaviside(T number){ return (number >= 0 ? number : 0 ); }
+    T heaviside(T number) const { return (number >= 0 ? number : 0 ); }
 
 
 
@@ -139,21 +275,29 @@ public slots:
 
     void startSimulation();
 
-    void doSimulation();
+    void steadyStateReached(double simulatedTime, double secondsToSteady, bool solved);
+
+    // the simulation thread ended, on its own or stopped
+    void simulationFinished();
 
 signals:
     void signalCreateBurnerMap();
 
     void signalCreateTemperatureLayers();
 
-    void signalDoSimulation();
-
     void signalAlphaUpdated();
 
     void signalError(int errIndex);
 
     void signalNoErrors(int errIndex);
 
+    void signalCheckpointWritten(const QString &fileName, const QString &error);
+
+    void signalSteadyStateReached(double simulatedTime, double secondsToSteady, bool solved);
+
+    // with every painted frame of the simulation
+    void signalSimulationRate(double simulatedTime, double realTimeFactor);
+
 protected:
     void paintEvent(QPaintEvent *) override;
 
@@ -165,15 +309,9 @@ protected:
 
     void mouseMoveEvent(QMouseEvent *) override;
 
-    void addBurnerRegion(QPoint pos, int penWidth);
-
-    void removeBurnerRegion(QPoint pos, int penWidth);
-
-    void calcHeatingStep();
-
-    void calcHeatingStepParallel(int numberOfThreads);
+    void addBurnerRegion(QPoint from, QPoint to, int penWidth);
 
-    void calcHeatingStepPartial(QPromise<void> &promise, int xMin, int xMax);
+    void removeBurnerRegion(QPoint from, QPoint to, int penWidth);
 
 
 private:
@@ -181,12 +319,12 @@ private:
 
     void resizeImage(QImage *image, const QSize &newSize);
 
+    void paintFrame(const SimulationFrame &frame);
+
     // status bools
     bool drawing = false;
     bool clearing = false;
     bool simulationRunning = false;
-    bool multithreadRunning = false;
-    bool burnerOn = false;
 
     int myPenWidth = 50; // starting defalut pen width
     QColor myPenColor = Qt::black;       // and colour
@@ -194,48 +332,35 @@ private:
     QPoint lastPoint;
     QTimer *timer;
 
-    // bool map of where the burner was drawn
-    QVector<QVector<bool>> burnerMap;
+    // heat model: burner map and temperature layers, resized with the draw area
+    // (one point per pixel), border points are used as boundary
+    HeatSolver solver{202, 202};
+
+    // records the frames of the simulation thread, outlives it
+    FrameRecorder recorder;
+
+    // steps the solver while the simulation runs, the UI only reads its frames
+    SimulationThread simulationThread{solver};
 
-    // setting temperature maps of the burner and stove top
-    static const int temperatureMapSizeX = 202;  // 202*202 - Fixed size of simulation window/widget (drawArea)
-    static const int temperatureMapSizeY = 202;  // 2 extra points in each dimention are used as boundary, so main calc area is 200*200
-    double temperatureMapL0 [temperatureMapSizeX][temperatureMapSizeY];  // Burner map, under main stove top
-    double temperatureMapL1 [temperatureMapSizeX][temperatureMapSizeY];  // Initial stove temperature map
-    double temperatureMapL2 [temperatureMapSizeX][temperatureMapSizeY];  // Previous state stove temp map
-    double temperatureMapL3 [temperatureMapSizeX][temperatureMapSizeY];  // Current state stove temp map
+    // plays a recording back, the frame shown
+    FramePlayer player;
+    SimulationFrame playbackFrame;
 
     // simulation parameters
-    const int maxSimulationSteps = 1000000;     // For safety, execution will stop after this step is reached
-    int currentSimulationStep = 0;
+    const int maxSimulationSteps = 1000000;     // For safety, execution will stop after this many steps of a run
+    long long simulationStepLimit = 0;          // step the current run stops at
+    const int autosavePeriod = 60;              // s between two checkpoints of the autosave
     int numberOfThreads = 1;
+    const double defaultRealTimeFactor = 1.;    // the stove heats up as it would in the kitchen
+    const double activeTileEpsilon = 0.01;   // deg C, far below the colour resolution
+    const double steadyStateTolerance = 0.01;   // deg C/s, a hundred seconds for a degree
+    QRgb paintedAmbientColor = 0;            // colour of the inactive tiles on the image, 0 - not painted
 
-    // physical constants
-    const double outsideTemperature = 20.;
-
-    const double density = 8.96e-3;             // Cu, density in g/mm^3 // rho in literature
-    const double volHeatCapCu = 3.45e-3;       // Cu, specific heat capacity in J/mm^3/deg C // c in literature
-    const double resistivity = 1.68e-5;       // Cu, resistivity in Ohm*mm // again rho in literature
-    const double thermalResCoef = 3.86e-3;   // Cu, thermal sensitivity of resistivity, in a.u./deg C // again alpha in literature
-    const int maxHeaterTemp = 800;          // max temperature set for Cu heater, it will be not able to heat further
-
-    // simulation constants
-    const double xStep = 0.26;           // 1 px = 0.26 mm // value for my monitor
-    const double yStep = 0.26;          // one pixel - one small block of burner
-    const double zStep = 2.;           // thickness of the stove top (glass or other)
-                                      // consider there is burner at 0-zStep and air at 0+zStep
-    const double burnerSizeZ = 1.;   // burner Z size
-                                    // these values are used for calculation of the size of the burner,
-                                   // stove top, as well as x, y and z simulation steps
-    const int timerPeriod = 100;  // How often to show the current simulation state, each timerPeriod the update will run, in ms
-
-    // simulation variables
-    double alpha = 5.;               // Thermal diffusivity in mm^2/s, denepds on stove top material, which can be changed
-    double timeStep = 0.002;        // xStep*yStep / 4 / alpha, in seconds; updated when the widget is created and when alpha is changed
-    int W = 5000;                  // Total power supplied, Wh; user will be able to change it
-    double power = 0;             // power = f(W), shows the temperature increase of the burner based on W
-    int numberOfBurnerPixels = 0;// number of pixels coloured as a burner
+    // temperature colour map, black - red - yellow - white over 0..766 deg C
+    TemperaturePainter temperaturePainter;
+    QVector<char> dirtyTiles;                // tiles changed by the last paintTemperatureMap
 
+    const int timerPeriod = 100;  // How often to show the current simulation state, each timerPeriod the newest frame is painted, in ms
 
 
     // currently unused parts
@@ -0,0 +1,227 @@
+#include "multigridsolver.h"
+
+#include <algorithm>
+#include <cmath>
+
+void MultigridSolver::rowRange(int rows, int worker, int threads, int &first, int &last){
+    // interior rows 1..rows of a level split between the workers
+    first = 1 + static_cast<int>(static_cast<long long>(rows) * worker / threads);
+    last = 1 + static_cast<int>(static_cast<long long>(rows) * (worker+1) / threads);
+}
+
+void MultigridSolver::buildLevels(int nx, int ny, int stride, const StencilCoefficients &c, double mass){
+    // the coarse grids are built once per plate size, only the coefficients change
+    int mx = nx - 2;
+    int my = ny - 2;
+    int rowStride = stride;
+    double x = c.x;
+    double y = c.y;
+    size_t count = 0;
+    for (;;){
+        if (levels.size() <= count) levels.emplace_back();
+        Level &level = levels[count++];
+        const size_t cells = static_cast<size_t>(rowStride) * (my + 2);
+        level.mx = mx;
+        level.my = my;
+        level.rowStride = rowStride;
+        level.x = x;
+        level.y = y;
+        level.diagonal = mass + 2*x + 2*y + 2*c.z;
+        level.u.resize(cells);
+        level.b.resize(cells);
+        level.r.resize(cells);
+
+        if (mx < 4 || my < 4) break;
+        mx = (mx + 1) / 2;
+        my = (my + 1) / 2;
+        rowStride = mx + 2;
+        // twice the step - a quarter of the coupling
+        x /= 4;
+        y /= 4;
+    }
+    levels.resize(count);
+}
+
+int MultigridSolver::step(const double *previous, double *current, const double *heater,
+                          int nx, int ny, int stride, const StencilCoefficients &c, WorkerPool *pool){
+    return solve(previous, current, heater, nx, ny, stride, c, 1., pool);
+}
+
+int MultigridSolver::solveSteady(const double *guess, double *current, const double *heater,
+                                 int nx, int ny, int stride, const StencilCoefficients &c, WorkerPool *pool){
+    // still diagonally dominant without the mass, the air term (z) keeps it so
+    return solve(guess, current, heater, nx, ny, stride, c, 0., pool);
+}
+
+int MultigridSolver::solve(const double *previous, double *current, const double *heater, int nx, int ny, int stride,
+                           const StencilCoefficients &c, double mass, WorkerPool *pool){
+    buildLevels(nx, ny, stride, c, mass);
+    const int threads = pool ? pool->size() : 1;
+    partialSums.assign(threads, 0.);
+    int cycles = 0;
+    double residualNorm = 0;
+
+    auto job = [&, this](int worker){
+        Level &fine = levels[0];
+        int first, last;
+        rowRange(fine.my, worker, threads, first, last);
+        // the whole plate including the boundary, the previous state is the first guess
+        const int firstRow = (worker == 0) ? 0 : first;
+        const int lastRow = (worker == threads-1) ? ny : last;
+        std::copy(previous + static_cast<size_t>(firstRow) * stride, previous + static_cast<size_t>(lastRow) * stride,
+                  fine.u.begin() + static_cast<size_t>(firstRow) * stride);
+
+        double sum = 0;
+        for (int j = first; j < last; ++j){
+            for (int i = 1; i <= fine.mx; ++i){
+                const size_t k = static_cast<size_t>(j) * stride + i;
+                fine.b[k] = mass * previous[k] + c.z * (std::min(c.outside, previous[k]*0.7) + heater[k]);
+                sum += fine.b[k] * fine.b[k];
+            }
+        }
+        partialSums[worker] = sum;
+        if (pool) pool->barrier();
+        double rightHandSideNorm = 0;
+        for (double partial : partialSums) rightHandSideNorm += partial;
+        rightHandSideNorm = std::sqrt(rightHandSideNorm);
+
+        int cycle = 0;
+        double norm = 0;
+        while (cycle < maxCycles){
+            vCycle(0, worker, threads, pool);
+            ++cycle;
+
+            if (pool) pool->barrier();
+            partialSums[worker] = residual(fine, worker, threads);
+            if (pool) pool->barrier();
+            norm = 0;
+            for (double partial : partialSums) norm += partial;
+            norm = std::sqrt(norm);
+            // every worker sees the same sums, so they all stop at the same cycle
+            if (pool) pool->barrier();
+            if (norm <= tolerance * rightHandSideNorm) break;
+        }
+
+        std::copy(fine.u.begin() + static_cast<size_t>(firstRow) * stride, fine.u.begin() + static_cast<size_t>(lastRow) * stride,
+                  current + static_cast<size_t>(firstRow) * stride);
+        if (worker == 0){
+            cycles = cycle;
+            residualNorm = rightHandSideNorm > 0 ? norm / rightHandSideNorm : 0;
+        }
+    };
+    if (pool) pool->run(job);
+    else job(0);
+
+    lastCycles = cycles;
+    lastResidual = residualNorm;
+    return cycles;
+}
+
+size_t MultigridSolver::memoryBytes() const{
+    size_t count = partialSums.capacity();
+    for (const Level &level : levels) count += level.u.capacity() + level.b.capacity() + level.r.capacity();
+    return count * sizeof(double);
+}
+
+void MultigridSolver::smooth(Level &level, int sweeps, int worker, int threads, WorkerPool *pool){
+    // red-black Gauss-Seidel, a colour only reads the other one, so the rows can be split
+    int first, last;
+    rowRange(level.my, worker, threads, first, last);
+    const int stride = level.stride();
+    const double inverseDiagonal = 1. / level.diagonal;
+    for (int sweep = 0; sweep < sweeps; ++sweep){
+        for (int colour = 0; colour < 2; ++colour){
+            for (int j = first; j < last; ++j){
+                double *u = level.u.data() + static_cast<size_t>(j) * stride;
+                const double *b = level.b.data() + static_cast<size_t>(j) * stride;
+                for (int i = 1 + ((j + 1 + colour) & 1); i <= level.mx; i += 2){
+                    u[i] = (b[i] + level.x*(u[i-1] + u[i+1]) + level.y*(u[i-stride] + u[i+stride])) * inverseDiagonal;
+                }
+            }
+            if (pool) pool->barrier();
+        }
+    }
+}
+
+double MultigridSolver::residual(Level &level, int worker, int threads){
+    int first, last;
+    rowRange(level.my, worker, threads, first, last);
+    const int stride = level.stride();
+    double sum = 0;
+    for (int j = first; j < last; ++j){
+        const double *u = level.u.data() + static_cast<size_t>(j) * stride;
+        const double *b = level.b.data() + static_cast<size_t>(j) * stride;
+        double *r = level.r.data() + static_cast<size_t>(j) * stride;
+        for (int i = 1; i <= level.mx; ++i){
+            r[i] = b[i] - (level.diagonal*u[i] - level.x*(u[i-1] + u[i+1]) - level.y*(u[i-stride] + u[i+stride]));
+            sum += r[i] * r[i];
+        }
+    }
+    return sum;
+}
+
+void MultigridSolver::restrictResidual(const Level &fine, Level &coarse, int worker, int threads){
+    // average of the (up to) 2x2 fine cells of a coarse cell, the coarse correction starts at 0
+    int first, last;
+    rowRange(coarse.my, worker, threads, first, last);
+    const int fineStride = fine.stride();
+    const int stride = coarse.stride();
+    const int firstRow = (worker == 0) ? 0 : first;
+    const int lastRow = (worker == threads-1) ? coarse.my + 2 : last;
+    std::fill(coarse.u.begin() + static_cast<size_t>(firstRow) * stride,
+              coarse.u.begin() + static_cast<size_t>(lastRow) * stride, 0.);
+
+    for (int J = first; J < last; ++J){
+        for (int I = 1; I <= coarse.mx; ++I){
+            double sum = 0;
+            int count = 0;
+            for (int j = 2*J - 1; j <= std::min(2*J, fine.my); ++j){
+                for (int i = 2*I - 1; i <= std::min(2*I, fine.mx); ++i){
+                    sum += fine.r[static_cast<size_t>(j) * fineStride + i];
+                    ++count;
+                }
+            }
+            coarse.b[static_cast<size_t>(J) * stride + I] = sum / count;
+        }
+    }
+}
+
+void MultigridSolver::prolongate(const Level &coarse, Level &fine, int worker, int threads){
+    /* bilinear interpolation between the cell centres: a fine cell takes 3/4 of its
+     * coarse cell and 1/4 of the next one in each direction, outside is 0 */
+    int first, last;
+    rowRange(fine.my, worker, threads, first, last);
+    const int fineStride = fine.stride();
+    const int stride = coarse.stride();
+    for (int j = first; j < last; ++j){
+        const int J = (j + 1) / 2;
+        const int J2 = (j & 1) ? J - 1 : J + 1;
+        const double *row = coarse.u.data() + static_cast<size_t>(J) * stride;
+        const double *row2 = coarse.u.data() + static_cast<size_t>(J2) * stride;
+        double *u = fine.u.data() + static_cast<size_t>(j) * fineStride;
+        for (int i = 1; i <= fine.mx; ++i){
+            const int I = (i + 1) / 2;
+            const int I2 = (i & 1) ? I - 1 : I + 1;
+            u[i] += 0.5625*row[I] + 0.1875*(row[I2] + row2[I]) + 0.0625*row2[I2];
+        }
+    }
+}
+
+void MultigridSolver::vCycle(int index, int worker, int threads, WorkerPool *pool){
+    Level &level = levels[index];
+    if (index + 1 == static_cast<int>(levels.size())){
+        // the coarsest grid is a few cells, smoothing solves it
+        smooth(level, coarsestSweeps, worker, threads, pool);
+        return;
+    }
+
+    smooth(level, preSweeps, worker, threads, pool);
+    residual(level, worker, threads);
+    if (pool) pool->barrier();
+    restrictResidual(level, levels[index + 1], worker, threads);
+    if (pool) pool->barrier();
+    vCycle(index + 1, worker, threads, pool);
+    prolongate(levels[index + 1], level, worker, threads);
+    if (pool) pool->barrier();
+    smooth(level, postSweeps, worker, threads, pool);
+}
@@ -0,0 +1,84 @@
+#ifndef MULTIGRIDSOLVER_H
+#define MULTIGRIDSOLVER_H
+
+/* Backward Euler step of the stove top, the linear system
+ *   (1 + 2x + 2y + 2z) T - x (E + W) - y (N + S) = previous + z (min(outside, 0.7 previous) + heater)
+ * (x, y, z are alpha*timeStep/step^2) is solved with geometric multigrid V-cycles:
+ * red-black Gauss-Seidel smoothing, restriction by averaging 2x2 cells and bilinear
+ * prolongation, with the coarse operators rediscretised on the twice coarser grid.
+ * The grids are cell centred, so any plate size can be coarsened. Every phase is
+ * split over the rows of the worker pool. The work of a cycle is O(cells), and the
+ * number of cycles barely depends on the time step, so huge steps are cheap. */
+
+// C++ libs
+#include <vector>
+
+#include "stencilkernel.h"
+#include "workerpool.h"
+
+//______________________________________________Multigrid Solver________________//
+class MultigridSolver{
+public:
+    // previous and current are nx*ny plates stored row by row, stride points apart, the border points are constant
+    int step(const double *previous, double *current, const double *heater,
+             int nx, int ny, int stride, const StencilCoefficients &c, WorkerPool *pool);
+
+    /* the steady state: the same system without the previous state (an infinite step),
+     *   (2x + 2y + 2z) T - x (E + W) - y (N + S) = z (min(outside, 0.7 guess) + heater)
+     * with the coefficients of one second (x = alpha/xStep^2...); guess is the first guess
+     * and gives the air term, so it is solved again from its result until the air settles */
+    int solveSteady(const double *guess, double *current, const double *heater,
+                    int nx, int ny, int stride, const StencilCoefficients &c, WorkerPool *pool);
+
+    size_t memoryBytes() const;
+
+    void setTolerance(double newTolerance) { tolerance = newTolerance; }
+
+    double getTolerance() const { return tolerance; }
+
+    int getLastCycles() const { return lastCycles; }
+
+    double getLastResidual() const { return lastResidual; }
+
+private:
+    struct Level{
+        int mx = 0, my = 0;         // interior cells, the arrays have a ring of boundary cells
+        int rowStride = 0;          // the finest level has the layout of the plate
+        double x = 0, y = 0;        // coupling to the neighbours
+        double diagonal = 1;
+        std::vector<double> u, b, r;
+        int stride() const { return rowStride; }
+    };
+
+    // mass - the weight of the previous state, 1 for a step, 0 for the steady state
+    int solve(const double *previous, double *current, const double *heater, int nx, int ny, int stride,
+              const StencilCoefficients &c, double mass, WorkerPool *pool);
+
+    void buildLevels(int nx, int ny, int stride, const StencilCoefficients &c, double mass);
+
+    void smooth(Level &level, int sweeps, int worker, int threads, WorkerPool *pool);
+
+    double residual(Level &level, int worker, int threads);
+
+    void restrictResidual(const Level &fine, Level &coarse, int worker, int threads);
+
+    void prolongate(const Level &coarse, Level &fine, int worker, int threads);
+
+    void vCycle(int index, int worker, int threads, WorkerPool *pool);
+
+    static void rowRange(int rows, int worker, int threads, int &first, int &last);
+
+    std::vector<Level> levels;
+    std::vector<double> partialSums;   // one per worker, for the residual norm
+
+    double tolerance = 1e-8;           // relative to the norm of the right hand side
+    int maxCycles = 50;
+    int preSweeps = 2;
+    int postSweeps = 2;
+    int coarsestSweeps = 40;
+
+    int lastCycles = 0;
+    double lastResidual = 0;
+};
+
+#endif // MULTIGRIDSOLVER_H
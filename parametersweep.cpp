@@ -0,0 +1,179 @@
+#include "parametersweep.h"
+
+#include <QElapsedTimer>
+#include <QPair>
+#include <QSettings>
+#include <QStringList>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <numeric>
+#include <thread>
+
+#include "workerpool.h"
+
+bool ParameterSweep::load(const QString &fileName, const Scenario &scenario){
+    base = scenario;
+    cases.clear();
+    results.clear();
+    QSettings settings(fileName, QSettings::IniFormat);
+    if (settings.status() != QSettings::NoError){
+        error = QString("Scenario file %1 can not be parsed.").arg(fileName);
+        return false;
+    }
+    duration = settings.value("sweep/duration", duration).toDouble();
+    targetTemperature = settings.value("sweep/target", targetTemperature).toDouble();
+    sampleInterval = settings.value("sweep/sample", sampleInterval).toDouble();
+    if (duration <= 0 || sampleInterval <= 0){
+        error = QString("Scenario %1: sweep duration and sample must be positive.").arg(fileName);
+        return false;
+    }
+
+    // "name", "label alpha" or "alpha"
+    QVector<QPair<QString, double>> materials;
+    for (const QString &item : settings.value("sweep/materials").toStringList()){
+        const QStringList words = item.simplified().split(' ', Qt::SkipEmptyParts);
+        if (words.isEmpty()) continue;
+        bool ok = false;
+        double alpha = words.last().toDouble(&ok);
+        QString label = words.size() > 1 ? words.first() : QString("alpha %1").arg(alpha);
+        if (!ok && words.size() == 1){
+            label = words.first();
+            ok = materialAlpha(label, &alpha);
+        }
+        if (!ok || words.size() > 2 || alpha <= 0){
+            error = QString("Scenario %1: unknown sweep material \"%2\".").arg(fileName, item);
+            return false;
+        }
+        materials.append(qMakePair(label, alpha));
+    }
+    if (materials.isEmpty()) materials.append(qMakePair(QString("alpha %1").arg(base.alpha), base.alpha));
+
+    QVector<int> watts;
+    for (const QString &item : settings.value("sweep/watts").toStringList()){
+        if (item.trimmed().isEmpty()) continue;
+        bool ok = false;
+        watts.append(item.trimmed().toInt(&ok));
+        if (!ok || watts.last() < 0){
+            error = QString("Scenario %1: bad sweep power \"%2\".").arg(fileName, item);
+            return false;
+        }
+    }
+    if (watts.isEmpty()) watts.append(base.watts);
+
+    // the shapes of one burner are joined by +
+    QVector<QVector<BurnerShape>> burners;
+    for (const QString &item : settings.value("sweep/burners").toStringList()){
+        if (item.trimmed().isEmpty()) continue;
+        QVector<BurnerShape> shapes;
+        for (const QString &shapeItem : item.split('+')){
+            BurnerShape shape;
+            if (!base.parseShape(fileName, shapeItem, &shape)){
+                error = base.errorString();
+                return false;
+            }
+            shapes.append(shape);
+        }
+        burners.append(shapes);
+    }
+    if (burners.isEmpty()) burners.append(base.shapes);
+
+    for (const auto &material : materials){
+        for (int power : watts){
+            for (int burner = 0; burner < burners.size(); ++burner){
+                SweepCase sweepCase;
+                sweepCase.material = material.first;
+                sweepCase.alpha = material.second;
+                sweepCase.watts = power;
+                sweepCase.burner = burner;
+                sweepCase.shapes = burners[burner];
+                cases.append(sweepCase);
+            }
+        }
+    }
+    return true;
+}
+
+void ParameterSweep::run(KernelIsa isa, int jobs){
+    usedJobs = jobs > 0 ? jobs : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    usedJobs = std::max(1, std::min(usedJobs, static_cast<int>(cases.size())));
+    results.clear();
+    results.resize(cases.size());
+
+    // the largest alpha first: most explicit steps, the longest runs
+    std::vector<int> order(cases.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [this](int a, int b){ return cases[a].alpha > cases[b].alpha; });
+
+    QElapsedTimer sweepTimer;
+    sweepTimer.start();
+    std::atomic<int> next{0};
+    SweepResult *out = results.data();
+    auto sweepJob = [this, isa, &order, &next, out](int){
+        // every result is written by the worker that ran it
+        for (int i = next.fetch_add(1, std::memory_order_relaxed); i < static_cast<int>(order.size());
+             i = next.fetch_add(1, std::memory_order_relaxed)){
+            out[order[i]] = runCase(cases.at(order[i]), isa);
+        }
+    };
+    WorkerPool pool(usedJobs);
+    pool.run(sweepJob);
+    wallSeconds = sweepTimer.nsecsElapsed() / 1e9;
+}
+
+SweepResult ParameterSweep::runCase(const SweepCase &sweepCase, KernelIsa isa) const{
+    QElapsedTimer caseTimer;
+    caseTimer.start();
+    SweepResult result;
+    result.parameters = sweepCase;
+
+    Scenario scenario = base;
+    scenario.alpha = sweepCase.alpha;
+    scenario.watts = sweepCase.watts;
+    scenario.shapes = sweepCase.shapes;
+    scenario.threads = 0;
+    HeatSolver solver;
+    if (!scenario.apply(solver)){
+        result.error = scenario.errorString();
+        return result;
+    }
+    scenario.configure(solver, isa);
+    result.burnerPixels = solver.getNumberOfBurnerPixels();
+
+    double previousTime = 0;
+    double previousMaximum = solver.maxTemperature();
+    result.peakTemperature = previousMaximum;
+    if (previousMaximum >= targetTemperature) result.timeToTarget = 0;
+    const double end = duration * (1 - 1e-12);
+    while (solver.getSimulatedTime() < end){
+        // up to the next sample or heater switch, the samples stay on their grid
+        const double now = solver.getSimulatedTime();
+        solver.setBurner(scenario.heaterStateAt(now));
+        double until = (std::floor(now / sampleInterval + 1e-9) + 1) * sampleInterval;
+        until = std::min({until, duration, scenario.nextSwitchAfter(now)});
+        solver.advanceTime(until - now);
+
+        const double time = solver.getSimulatedTime();
+        const double maximum = solver.maxTemperature();
+        // no point can get hotter than the heater, a larger one is a run going to infinity
+        if (!std::isfinite(maximum) || maximum > HeatSolver::maxHeaterTemp + 1.){
+            result.error = QString("diverged at %1 s").arg(time);
+            break;
+        }
+        if (result.timeToTarget < 0 && maximum >= targetTemperature){
+            result.timeToTarget = previousTime + (targetTemperature - previousMaximum) / (maximum - previousMaximum)
+                    * (time - previousTime);
+        }
+        if (maximum > result.peakTemperature){
+            result.peakTemperature = maximum;
+            result.peakTime = time;
+        }
+        previousTime = time;
+        previousMaximum = maximum;
+    }
+    result.finalTemperature = previousMaximum;
+    result.steps = solver.getCurrentStep();
+    result.wallSeconds = caseTimer.nsecsElapsed() / 1e9;
+    return result;
+}
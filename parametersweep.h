@@ -0,0 +1,87 @@
+#ifndef PARAMETERSWEEP_H
+#define PARAMETERSWEEP_H
+
+// Qt data structures
+#include <QString>
+#include <QVector>
+
+#include "scenario.h"
+
+/* Sweep over the designs of a scenario, its [sweep] section:
+ *
+ *   [sweep]
+ *   materials=iron, quartz, brick, test 5    ; a name of the GUI tops, or a label and an alpha
+ *   watts=2000, 5000, 10000
+ *   burners=circle 101 101 120, circle 60 60 40 + circle 140 140 40   ; shapes of a burner joined by +
+ *   duration=60                ; simulated seconds of every run
+ *   target=150                 ; deg C, when the hottest point of the plate reaches it
+ *   sample=0.5                 ; simulated seconds between two looks at the plate
+ *
+ * Every combination of material, power and burner is a run of its own, the keys left out
+ * take the one value of the scenario (its alpha, watts, shapes). A burner of the sweep
+ * replaces the shapes of the scenario, a mask is kept under all of them.
+ * The runs are independent, so they are not split over threads: every worker of a pinned
+ * pool takes the next run, steps it single threaded with its own solver (allocated, thus
+ * first touched, by that worker) and takes another one, so many small plates are packed on
+ * a core one after the other and no barrier is ever waited for; the runs with the larger
+ * alpha, which take the most explicit steps, go first so the last ones are short. */
+
+struct SweepCase{
+    QString material;
+    double alpha = 0;
+    int watts = 0;
+    int burner = 0;                 // index in the burners of the sweep
+    QVector<BurnerShape> shapes;
+};
+
+struct SweepResult{
+    SweepCase parameters;
+    int burnerPixels = 0;
+    double timeToTarget = -1;       // simulated seconds, interpolated between two samples, < 0 - never reached
+    double peakTemperature = 0;     // hottest point of the plate over all the samples
+    double peakTime = 0;
+    double finalTemperature = 0;    // hottest point at the end
+    long long steps = 0;
+    double wallSeconds = 0;
+    QString error;
+};
+
+//______________________________________________Parameter Sweep________________//
+class ParameterSweep{
+public:
+    // the [sweep] section of the scenario file, around the settings of scenario
+    bool load(const QString &fileName, const Scenario &scenario);
+
+    int caseCount() const { return cases.size(); }
+
+    // runs all the cases on jobs workers (<= 0 - one per core), blocks until they are done
+    void run(KernelIsa isa, int jobs = 0);
+
+    // in the order of the combinations: materials, then watts, then burners
+    const QVector<SweepResult> &getResults() const { return results; }
+
+    int getJobs() const { return usedJobs; }
+
+    double getWallSeconds() const { return wallSeconds; }
+
+    double getDuration() const { return duration; }
+
+    double getTargetTemperature() const { return targetTemperature; }
+
+    QString errorString() const { return error; }
+
+private:
+    SweepResult runCase(const SweepCase &sweepCase, KernelIsa isa) const;
+
+    Scenario base;
+    QVector<SweepCase> cases;
+    QVector<SweepResult> results;
+    double duration = 60.;
+    double targetTemperature = 100.;
+    double sampleInterval = 0.5;
+    int usedJobs = 0;
+    double wallSeconds = 0;
+    QString error;
+};
+
+#endif // PARAMETERSWEEP_H
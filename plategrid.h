@@ -0,0 +1,90 @@
+#ifndef PLATEGRID_H
+#define PLATEGRID_H
+
+/* Runtime sized 2D grid of the stove top, stored row by row in one block.
+ * The block starts on a cache line (64 bytes) and every row is padded to an
+ * odd number of cache lines: all the rows start on a cache line, and the rows
+ * read by a stencil column never map to the same cache sets, as they would
+ * with a power of two row length (e.g. 4096 points). The padding is filled
+ * like the plate but never read by the kernels, which take row pointers and
+ * work on any size. A grid can also use a block it does not own, e.g. a layer
+ * of a mapped checkpoint (see adopt). */
+
+// C++ libs
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+
+//______________________________________________Plate Grid________________//
+template <typename T>
+class PlateGrid{
+public:
+    static constexpr size_t alignment = 64;     // bytes, one cache line
+
+    PlateGrid() = default;
+
+    PlateGrid(const PlateGrid &) = delete;
+
+    PlateGrid &operator=(const PlateGrid &) = delete;
+
+    PlateGrid(PlateGrid &&) = default;
+
+    PlateGrid &operator=(PlateGrid &&) = default;
+
+    void resize(int newSizeX, int newSizeY, T value){
+        gridSizeX = newSizeX;
+        gridSizeY = newSizeY;
+        gridStride = paddedStride(newSizeX);
+        cells.reset(::operator new[](bytes(), std::align_val_t(alignment)), AlignedDelete());
+        fill(value);
+    }
+
+    /* uses the block at data (sizeY rows of paddedStride(sizeX) points, aligned on a cache line)
+     * in place of its own; owner keeps the block alive as long as the grid uses it */
+    void adopt(T *data, int newSizeX, int newSizeY, std::shared_ptr<void> owner){
+        gridSizeX = newSizeX;
+        gridSizeY = newSizeY;
+        gridStride = paddedStride(newSizeX);
+        cells = std::shared_ptr<void>(std::move(owner), data);
+    }
+
+    void fill(T value) { std::fill(data(), data() + static_cast<size_t>(gridStride) * gridSizeY, value); }
+
+    int sizeX() const { return gridSizeX; }
+
+    int sizeY() const { return gridSizeY; }
+
+    // distance between two rows, in points
+    int stride() const { return gridStride; }
+
+    T *data() { return static_cast<T *>(cells.get()); }
+
+    const T *data() const { return static_cast<const T *>(cells.get()); }
+
+    T *row(int y) { return data() + static_cast<size_t>(y) * gridStride; }
+
+    const T *row(int y) const { return data() + static_cast<size_t>(y) * gridStride; }
+
+    size_t bytes() const { return static_cast<size_t>(gridStride) * gridSizeY * sizeof(T); }
+
+    static int paddedStride(int sizeX){
+        // whole cache lines, an odd number of them
+        const int perLine = static_cast<int>(alignment / sizeof(T));
+        int lines = (sizeX + perLine - 1) / perLine;
+        if (lines % 2 == 0) ++lines;
+        return lines * perLine;
+    }
+
+private:
+    struct AlignedDelete{
+        void operator()(void *p) const { ::operator delete[](p, std::align_val_t(alignment)); }
+    };
+
+    int gridSizeX = 0;
+    int gridSizeY = 0;
+    int gridStride = 0;
+    std::shared_ptr<void> cells;      // its own block or an adopted one, never shared between two grids
+};
+
+#endif // PLATEGRID_H
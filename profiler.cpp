@@ -0,0 +1,167 @@
+#include "profiler.h"
+
+#include <cstdio>
+
+namespace {
+// the ring of the calling thread, given back to the profiler when the thread ends
+struct ThreadRingHandle{
+    void *ring = nullptr;
+    std::atomic<bool> *inUse = nullptr;
+    std::string name;
+
+    ~ThreadRingHandle(){
+        if (inUse) inUse->store(false, std::memory_order_release);
+    }
+};
+
+thread_local ThreadRingHandle threadHandle;
+
+void writeJsonString(std::ostream &out, const std::string &text){
+    out << '"';
+    for (char c : text){
+        if (c == '"' || c == '\\') out << '\\';
+        out << c;
+    }
+    out << '"';
+}
+}
+
+std::atomic<bool> Profiler::enabled{false};
+
+const char *profilePhaseName(ProfilePhase phase){
+    switch (phase){
+    case ProfilePhase::Heater: return "heater";
+    case ProfilePhase::Stencil: return "stencil";
+    case ProfilePhase::Barrier: return "barrier";
+    case ProfilePhase::Swap: return "swap";
+    case ProfilePhase::Solve: return "solve";
+    case ProfilePhase::Publish: return "publish";
+    case ProfilePhase::Colormap: return "colormap";
+    case ProfilePhase::Blit: return "blit";
+    default: return "unknown";
+    }
+}
+
+Profiler::Profiler()
+    : start(std::chrono::steady_clock::now()){
+}
+
+Profiler &Profiler::instance(){
+    static Profiler profiler;
+    return profiler;
+}
+
+uint64_t Profiler::now() const{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::steady_clock::now() - start).count());
+}
+
+void Profiler::setThreadName(const std::string &name){
+    // taken by the ring when the thread records its first phase
+    threadHandle.name = name;
+    if (threadHandle.ring){
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        static_cast<Ring *>(threadHandle.ring)->name = name;
+    }
+}
+
+Profiler::Ring *Profiler::threadRing(){
+    if (threadHandle.ring) return static_cast<Ring *>(threadHandle.ring);
+
+    // the rings of the threads that ended are reused, e.g. when the worker pool is rebuilt
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    Ring *ring = nullptr;
+    for (const std::unique_ptr<Ring> &candidate : rings){
+        bool free = false;
+        if (candidate->inUse.compare_exchange_strong(free, true, std::memory_order_acquire)){
+            ring = candidate.get();
+            break;
+        }
+    }
+    if (!ring){
+        rings.push_back(std::make_unique<Ring>());
+        ring = rings.back().get();
+        ring->threadId = static_cast<int>(rings.size());
+    }
+    ring->name = threadHandle.name.empty() ? "thread " + std::to_string(ring->threadId) : threadHandle.name;
+    threadHandle.ring = ring;
+    threadHandle.inUse = &ring->inUse;
+    return ring;
+}
+
+void Profiler::record(ProfilePhase phase, uint64_t begin, uint64_t end){
+    Ring *ring = threadRing();
+    const uint64_t duration = end - begin;
+    const int index = static_cast<int>(phase);
+
+    // started is raised before the slot is overwritten, the readers check it after reading
+    const uint64_t n = ring->written.load(std::memory_order_relaxed);
+    ring->started.store(n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    Slot &slot = ring->slots[n % ringSize];
+    slot.begin.store(begin, std::memory_order_relaxed);
+    slot.durationAndPhase.store(duration << 8 | static_cast<uint64_t>(index), std::memory_order_relaxed);
+    ring->written.store(n + 1, std::memory_order_release);
+
+    // only this thread writes the totals of its ring
+    ring->nanoseconds[index].store(ring->nanoseconds[index].load(std::memory_order_relaxed) + duration,
+                                   std::memory_order_relaxed);
+    ring->calls[index].store(ring->calls[index].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+ProfileTotals Profiler::totals() const{
+    ProfileTotals totals;
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    for (const std::unique_ptr<Ring> &ring : rings){
+        for (int i = 0; i < profilePhaseCount; ++i){
+            totals.nanoseconds[i] += ring->nanoseconds[i].load(std::memory_order_relaxed);
+            totals.calls[i] += ring->calls[i].load(std::memory_order_relaxed);
+        }
+    }
+    return totals;
+}
+
+size_t Profiler::writeChromeTrace(std::ostream &out, uint64_t from, uint64_t to) const{
+    struct Event{
+        uint64_t position, begin, durationAndPhase;
+    };
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    size_t count = 0;
+    bool first = true;
+    char buffer[192];
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    std::vector<Event> events;
+    for (const std::unique_ptr<Ring> &ring : rings){
+        out << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring->threadId
+            << ",\"args\":{\"name\":";
+        writeJsonString(out, ring->name);
+        out << "}}";
+        first = false;
+
+        // copy the ring, then drop what the thread overwrote while it was copied
+        const uint64_t written = ring->written.load(std::memory_order_acquire);
+        events.clear();
+        for (uint64_t i = written > ringSize ? written - ringSize : 0; i < written; ++i){
+            const Slot &slot = ring->slots[i % ringSize];
+            events.push_back({i, slot.begin.load(std::memory_order_relaxed),
+                              slot.durationAndPhase.load(std::memory_order_relaxed)});
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t started = ring->started.load(std::memory_order_relaxed);
+
+        for (const Event &event : events){
+            if (event.position + ringSize < started) continue;
+            const uint64_t duration = event.durationAndPhase >> 8;
+            const uint64_t end = event.begin + duration;
+            if (end < from || end > to) continue;
+            const ProfilePhase phase = static_cast<ProfilePhase>(event.durationAndPhase & 0xff);
+            std::snprintf(buffer, sizeof(buffer),
+                          ",\n{\"name\":\"%s\",\"cat\":\"stove\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                          profilePhaseName(phase), ring->threadId, event.begin / 1e3, duration / 1e3);
+            out << buffer;
+            ++count;
+        }
+    }
+    out << "\n]}\n";
+    return count;
+}
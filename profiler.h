@@ -0,0 +1,113 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+/* Low overhead per phase profiling of the simulation and of the painting.
+ * Every thread records its phases (start and duration) into its own ring buffer,
+ * so recording never locks nor writes a shared cache line; a ring keeps the last
+ * ringSize phases of its thread, the older ones are overwritten. Profiling is off
+ * by default, a ProfileScope then costs one relaxed load.
+ * The rings are read while they are written: the slots are atomics and a reader
+ * drops the slots the writer may have overwritten meanwhile, as with a seqlock.
+ * Only the standard library is used, the solver records its phases too. */
+
+// C++ libs
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/* heater, stencil - the explicit sweep, split in two passes while profiling (same result)
+ * barrier - waiting for the other workers, swap - buffer swap before a step,
+ * solve - the integrators and modes that are not split into phases,
+ * publish - the copy of a frame for the UI, colormap - painting it, blit - paintEvent */
+enum class ProfilePhase : uint8_t { Heater, Stencil, Barrier, Swap, Solve, Publish, Colormap, Blit, Count };
+
+constexpr int profilePhaseCount = static_cast<int>(ProfilePhase::Count);
+
+const char *profilePhaseName(ProfilePhase phase);
+
+// time spent in every phase and number of phases, over all the threads since the start
+struct ProfileTotals{
+    uint64_t nanoseconds[profilePhaseCount] = {};
+    uint64_t calls[profilePhaseCount] = {};
+};
+
+//______________________________________________Profiler________________//
+class Profiler{
+public:
+    static Profiler &instance();
+
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+    void setEnabled(bool status) { enabled.store(status, std::memory_order_relaxed); }
+
+    // nanoseconds since the profiler was created
+    uint64_t now() const;
+
+    // name of the calling thread in the trace, "thread N" if not set
+    void setThreadName(const std::string &name);
+
+    void record(ProfilePhase phase, uint64_t begin, uint64_t end);
+
+    ProfileTotals totals() const;
+
+    /* the phases that ended between from and to (now() time) in the Chrome trace event
+     * format (chrome://tracing, ui.perfetto.dev), returns the number of phases written */
+    size_t writeChromeTrace(std::ostream &out, uint64_t from, uint64_t to) const;
+
+    static constexpr uint64_t ringSize = 1 << 16;   // phases kept per thread, 1 MiB
+
+private:
+    Profiler();
+
+    struct Slot{
+        std::atomic<uint64_t> begin{0};
+        std::atomic<uint64_t> durationAndPhase{0};   // duration << 8 | phase
+    };
+
+    struct Ring{
+        int threadId = 0;
+        std::string name;
+        std::atomic<bool> inUse{true};               // a thread owns it, freed when the thread ends
+        std::atomic<uint64_t> started{0};            // phases whose writing started / is finished
+        std::atomic<uint64_t> written{0};
+        std::unique_ptr<Slot[]> slots{new Slot[ringSize]};
+        std::atomic<uint64_t> nanoseconds[profilePhaseCount] = {};
+        std::atomic<uint64_t> calls[profilePhaseCount] = {};
+    };
+
+    Ring *threadRing();
+
+    static std::atomic<bool> enabled;
+
+    const std::chrono::steady_clock::time_point start;
+    mutable std::mutex ringsMutex;                    // only taken to add a ring and to read the list
+    std::vector<std::unique_ptr<Ring>> rings;
+};
+
+//______________________________________________Profile Scope________________//
+// records the phase from construction to destruction, if profiling is enabled
+class ProfileScope{
+public:
+    explicit ProfileScope(ProfilePhase phase)
+        : phase(phase), active(Profiler::isEnabled()), begin(active ? Profiler::instance().now() : 0) {}
+
+    ~ProfileScope(){
+        if (active) Profiler::instance().record(phase, begin, Profiler::instance().now());
+    }
+
+    ProfileScope(const ProfileScope &) = delete;
+
+    ProfileScope &operator=(const ProfileScope &) = delete;
+
+private:
+    const ProfilePhase phase;
+    const bool active;
+    const uint64_t begin;
+};
+
+#endif // PROFILER_H
@@ -0,0 +1,211 @@
+#include "rkcsolver.h"
+
+#include <algorithm>
+#include <cmath>
+
+void RkcSolver::rowRange(int rows, int worker, int threads, int &first, int &last){
+    // rows 0..rows-1 of the plate split between the workers
+    first = static_cast<int>(static_cast<long long>(rows) * worker / threads);
+    last = static_cast<int>(static_cast<long long>(rows) * (worker+1) / threads);
+}
+
+int RkcSolver::stagesFor(double hTimesRadius){
+    // the damped RKC of s stages is stable up to about 0.65 s^2 spectral radii
+    return std::max(2, 1 + static_cast<int>(std::sqrt(1. + 1.54 * hTimesRadius)));
+}
+
+void RkcSolver::reset(double firstStep){
+    proposedStep = firstStep;
+    lastRejected = false;
+}
+
+void RkcSolver::resetCounters(){
+    acceptedSteps = 0;
+    rejectedSteps = 0;
+    lastStages = 0;
+}
+
+void RkcSolver::buildStages(int stages){
+    /* Chebyshev polynomials T_j(w0) and their first two derivatives by the three term
+     * recurrence, the damping 2/13 keeps the stability region off the negative axis */
+    const double w0 = 1. + 2. / (13. * stages * stages);
+    const double temp1 = w0*w0 - 1.;
+    const double temp2 = std::sqrt(temp1);
+    const double arg = stages * std::log(w0 + temp2);
+    const double w1 = std::sinh(arg) * temp1 / (std::cosh(arg) * stages * temp2 - w0 * std::sinh(arg));
+
+    double bjm1 = 1. / (4. * w0 * w0);
+    double bjm2 = bjm1;
+    firstStageMus = w1 * bjm1;
+    double zjm1 = w0, zjm2 = 1.;
+    double dzjm1 = 1., dzjm2 = 0.;
+    double d2zjm1 = 0., d2zjm2 = 0.;
+
+    stageCoefficients.resize(stages + 1);
+    for (int j = 2; j <= stages; ++j){
+        const double zj = 2*w0*zjm1 - zjm2;
+        const double dzj = 2*w0*dzjm1 - dzjm2 + 2*zjm1;
+        const double d2zj = 2*w0*d2zjm1 - d2zjm2 + 4*dzjm1;
+        const double bj = d2zj / (dzj*dzj);
+
+        Stage &stage = stageCoefficients[j];
+        stage.a = 1. - zjm1*bjm1;
+        stage.mu = 2*w0*bj / bjm1;
+        stage.nu = -bj / bjm2;
+        stage.mus = stage.mu * w1 / w0;
+
+        bjm2 = bjm1;
+        bjm1 = bj;
+        zjm2 = zjm1;
+        zjm1 = zj;
+        dzjm2 = dzjm1;
+        dzjm1 = dzj;
+        d2zjm2 = d2zjm1;
+        d2zjm1 = d2zj;
+    }
+}
+
+void RkcSolver::derivativeRow(const double *state, const double *heater, int y, double *out) const{
+    // the stencil with the rates gives dT/dt of the interior points 1..nx-2 of row y
+    const size_t row = static_cast<size_t>(y) * stride;
+    stencilRow(state + row - stride + 1, state + row + 1, state + row + stride + 1, heater + row + 1,
+               out + 1, nx-2, rates);
+}
+
+double RkcSolver::step(const double *previous, double *current, const double *heater,
+                       int newNx, int newNy, int newStride, const StencilCoefficients &newRates, double maxStep,
+                       StencilRowKernel newStencilRow, WorkerPool *pool){
+    nx = newNx;
+    ny = newNy;
+    stride = newStride;
+    rates = newRates;
+    stencilRow = newStencilRow;
+
+    // Gershgorin bound of the spectral radius, the largest step the stage limit can keep stable
+    const double radius = 4*(rates.x + rates.y) + 2*rates.z;
+    const double stableStep = ((maxStages-1.) * (maxStages-1.) - 1.) / 1.54 / radius;
+    if (proposedStep <= 0) proposedStep = 2. / radius;
+
+    const int threads = pool ? pool->size() : 1;
+    const size_t cells = static_cast<size_t>(stride) * ny;
+    derivative.resize(cells);
+    for (std::vector<double> &buffer : stageBuffers) buffer.resize(cells);
+    if (lines.size() != static_cast<size_t>(threads)) lines.resize(threads);
+    for (std::vector<double> &line : lines) line.resize(nx);
+    partialSums.assign(threads, 0.);
+
+    // F(previous) is shared by all the stages and by the retries of a rejected step
+    auto derivativeJob = [this, previous, heater, threads](int worker){
+        int first, last;
+        rowRange(ny, worker, threads, first, last);
+        for (int y = std::max(1, first); y < std::min(ny-1, last); ++y){
+            derivativeRow(previous, heater, y, derivative.data() + static_cast<size_t>(y) * stride);
+        }
+    };
+    if (pool) pool->run(derivativeJob);
+    else derivativeJob(0);
+
+    for (;;){
+        const double limit = std::min(proposedStep, stableStep);
+        const double h = std::min(limit, maxStep);
+        const double error = attempt(previous, current, heater, h, pool);
+        const double factor = error > 0 ? 0.8 / std::cbrt(error) : 10.;
+        if (error <= 1. || h <= minStep){
+            ++acceptedSteps;
+            // a step cut short by maxStep says nothing about the next one
+            if (h == limit) proposedStep = h * std::min(lastRejected ? 1. : 10., std::max(0.1, factor));
+            lastRejected = false;
+            return h;
+        }
+        ++rejectedSteps;
+        lastRejected = true;
+        proposedStep = h * std::max(0.1, factor);
+    }
+}
+
+double RkcSolver::attempt(const double *previous, double *current, const double *heater, double h, WorkerPool *pool){
+    const int stages = stagesFor(h * (4*(rates.x + rates.y) + 2*rates.z));
+    lastStages = stages;
+    buildStages(stages);
+
+    /* the stages rotate through three buffers, picked so the last one lands in current;
+     * a rejected step only overwrote them, previous is untouched */
+    double *buffers[3] = {current, stageBuffers[0].data(), stageBuffers[1].data()};
+    auto stageBuffer = [&buffers, stages](int j) { return buffers[(stages - j) % 3]; };
+    const int threads = pool ? pool->size() : 1;
+
+    auto job = [&, this](int worker){
+        int first, last;
+        rowRange(ny, worker, threads, first, last);
+        double *line = lines[worker].data();
+
+        // Y1 = Y0 + h mus1 F(Y0), the border points are constant
+        double *target = stageBuffer(1);
+        for (int y = first; y < last; ++y){
+            const size_t row = static_cast<size_t>(y) * stride;
+            if (y == 0 || y == ny-1){
+                std::copy(previous + row, previous + row + nx, target + row);
+                continue;
+            }
+            target[row] = previous[row];
+            target[row + nx-1] = previous[row + nx-1];
+            for (int x = 1; x < nx-1; ++x){
+                target[row + x] = previous[row + x] + h * firstStageMus * derivative[row + x];
+            }
+        }
+        if (pool) pool->barrier();
+
+        for (int j = 2; j <= stages; ++j){
+            const Stage &stage = stageCoefficients[j];
+            const double *yjm1 = stageBuffer(j-1);
+            const double *yjm2 = (j == 2) ? previous : stageBuffer(j-2);
+            target = stageBuffer(j);
+            const double rest = 1. - stage.mu - stage.nu;
+            const double hmus = h * stage.mus;
+            for (int y = first; y < last; ++y){
+                const size_t row = static_cast<size_t>(y) * stride;
+                if (y == 0 || y == ny-1){
+                    std::copy(previous + row, previous + row + nx, target + row);
+                    continue;
+                }
+                derivativeRow(yjm1, heater, y, line);
+                target[row] = previous[row];
+                target[row + nx-1] = previous[row + nx-1];
+                for (int x = 1; x < nx-1; ++x){
+                    const size_t k = row + x;
+                    target[k] = stage.mu * yjm1[k] + stage.nu * yjm2[k] + rest * previous[k]
+                            + hmus * (line[x] - stage.a * derivative[k]);
+                }
+            }
+            // the next stage reads the neighbour rows of this one
+            if (pool) pool->barrier();
+        }
+
+        // error estimate, F(current) is only needed row by row
+        double sum = 0;
+        for (int y = std::max(1, first); y < std::min(ny-1, last); ++y){
+            const size_t row = static_cast<size_t>(y) * stride;
+            derivativeRow(current, heater, y, line);
+            for (int x = 1; x < nx-1; ++x){
+                const size_t k = row + x;
+                const double estimate = 0.8 * (previous[k] - current[k]) + 0.4 * h * (derivative[k] + line[x]);
+                const double weight = tolerance * (1. + std::max(std::abs(previous[k]), std::abs(current[k])));
+                sum += (estimate / weight) * (estimate / weight);
+            }
+        }
+        partialSums[worker] = sum;
+    };
+    if (pool) pool->run(job);
+    else job(0);
+
+    double sum = 0;
+    for (double partial : partialSums) sum += partial;
+    return std::sqrt(sum / (static_cast<double>(nx-2) * (ny-2)));
+}
+
+size_t RkcSolver::memoryBytes() const{
+    size_t count = derivative.capacity() + stageBuffers[0].capacity() + stageBuffers[1].capacity()
+            + partialSums.capacity();
+    for (const std::vector<double> &line : lines) count += line.capacity();
+    return count * sizeof(double) + stageCoefficients.capacity() * sizeof(Stage);
+}
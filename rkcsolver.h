@@ -0,0 +1,91 @@
+#ifndef RKCSOLVER_H
+#define RKCSOLVER_H
+
+/* Adaptive second order Runge-Kutta-Chebyshev step of the stove top (Sommeijer,
+ * Shampine and Verwer, RKC). Every step is a chain of s explicit stages, each one a
+ * stencil sweep, and the stability region grows with s^2 (about 0.65 s^2 spectral
+ * radii), so s is chosen from the step and the spectral radius of the plate: the
+ * step stays stable at any size while costing only ~sqrt of the explicit sweeps.
+ * The local error is estimated from the two ends of the step,
+ *   est = 0.8 (previous - current) + 0.4 h (F(previous) + F(current)),
+ * weighted by tolerance*(1 + |T|) in the RMS norm; a step with an error over one is
+ * rejected and retried smaller, the next step is proposed from the error of the last.
+ * The heater is not stepped here, the plate sees the heater of the previous state. */
+
+// C++ libs
+#include <vector>
+
+#include "stencilkernel.h"
+#include "workerpool.h"
+
+//______________________________________________RKC Solver________________//
+class RkcSolver{
+public:
+    /* previous and current are nx*ny plates stored row by row, stride points apart, the border
+     * points are constant; rates holds alpha/step^2, the stencil with it gives dT/dt.
+     * Tries the proposed step (at most maxStep seconds) until one is accepted, returns its length */
+    double step(const double *previous, double *current, const double *heater,
+                int nx, int ny, int stride, const StencilCoefficients &rates, double maxStep,
+                StencilRowKernel stencilRow, WorkerPool *pool);
+
+    // forgets the step history, the next step tries firstStep
+    void reset(double firstStep);
+
+    void resetCounters();
+
+    size_t memoryBytes() const;
+
+    void setTolerance(double newTolerance) { tolerance = newTolerance; }
+
+    double getTolerance() const { return tolerance; }
+
+    double getProposedStep() const { return proposedStep; }
+
+    long long getAcceptedSteps() const { return acceptedSteps; }
+
+    long long getRejectedSteps() const { return rejectedSteps; }
+
+    int getLastStages() const { return lastStages; }
+
+private:
+    // coefficients of the stages 2..s: Yj = mu Yj-1 + nu Yj-2 + (1-mu-nu) Y0 + h mus (F(Yj-1) - a F(Y0))
+    struct Stage{
+        double mu = 0, nu = 0, mus = 0, a = 0;
+    };
+
+    void buildStages(int stages);
+
+    double attempt(const double *previous, double *current, const double *heater, double h, WorkerPool *pool);
+
+    void derivativeRow(const double *state, const double *heater, int y, double *out) const;
+
+    static int stagesFor(double hTimesRadius);
+
+    static void rowRange(int rows, int worker, int threads, int &first, int &last);
+
+    int nx = 0;
+    int ny = 0;
+    int stride = 0;
+    StencilCoefficients rates;
+    StencilRowKernel stencilRow = nullptr;
+
+    double firstStageMus = 0;          // Y1 = Y0 + h firstStageMus F(Y0)
+    std::vector<Stage> stageCoefficients;
+
+    std::vector<double> derivative;               // F(previous), whole plate with the same stride
+    std::vector<double> stageBuffers[2];          // the stages rotate through these and current
+    std::vector<std::vector<double>> lines;       // one F row per worker
+    std::vector<double> partialSums;              // one per worker, for the error norm
+
+    double tolerance = 1e-4;           // relative, plus the same absolute in deg C
+    double proposedStep = 0;
+    bool lastRejected = false;
+    int maxStages = 200;
+    double minStep = 1e-9;             // accepted whatever the error, never stuck
+
+    long long acceptedSteps = 0;
+    long long rejectedSteps = 0;
+    int lastStages = 0;
+};
+
+#endif // RKCSOLVER_H
@@ -0,0 +1,246 @@
+#include "scenario.h"
+
+#include <QFileInfo>
+#include <QDir>
+#include <QImage>
+#include <QSettings>
+#include <QStringList>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+QString integratorName(Integrator integrator){
+    switch (integrator){
+    case Integrator::ADI: return "adi";
+    case Integrator::Multigrid: return "multigrid";
+    case Integrator::RKC: return "rkc";
+    default: return "explicit";
+    }
+}
+
+bool integratorFromName(const QString &name, Integrator *integrator){
+    for (Integrator candidate : {Integrator::Explicit, Integrator::ADI, Integrator::Multigrid, Integrator::RKC}){
+        if (name == integratorName(candidate)){
+            *integrator = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool materialAlpha(const QString &name, double *alpha){
+    // the tops of the GUI, thermal diffusivity in mm^2/s
+    static const struct { const char *name; double alpha; } materials[] = {
+        {"silver", 165.6}, {"copper", 111.}, {"iron", 23.}, {"quartz", 1.4}, {"brick", 0.52}, {"glass", 0.34}
+    };
+    for (const auto &material : materials){
+        if (name == material.name){
+            *alpha = material.alpha;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Scenario::load(const QString &fileName){
+    if (!QFileInfo::exists(fileName)){
+        error = QString("Scenario file %1 does not exist.").arg(fileName);
+        return false;
+    }
+    QSettings settings(fileName, QSettings::IniFormat);
+    if (settings.status() != QSettings::NoError){
+        error = QString("Scenario file %1 can not be parsed.").arg(fileName);
+        return false;
+    }
+
+    sizeX = settings.value("plate/width", sizeX).toInt();
+    sizeY = settings.value("plate/height", sizeY).toInt();
+    alpha = settings.value("plate/alpha", alpha).toDouble();
+    layers = settings.value("plate/layers", layers).toInt();
+    watts = settings.value("heater/watts", watts).toInt();
+    steps = settings.value("run/steps", steps).toLongLong();
+    threads = settings.value("run/threads", threads).toInt();
+    blockSteps = settings.value("run/block", blockSteps).toInt();
+    timeStepFactor = settings.value("run/dtfactor", timeStepFactor).toDouble();
+    maxTimeStep = settings.value("run/maxdt", maxTimeStep).toDouble();
+    tolerance = settings.value("run/tolerance", tolerance).toDouble();
+    adaptiveTolerance = settings.value("run/rkctolerance", adaptiveTolerance).toDouble();
+    activeEpsilon = settings.value("run/active", activeEpsilon).toDouble();
+    const QString integratorValue = settings.value("run/integrator", integratorName(integrator)).toString();
+    if (!integratorFromName(integratorValue, &integrator)){
+        error = QString("Scenario %1: unknown integrator \"%2\".").arg(fileName, integratorValue);
+        return false;
+    }
+    const QString precisionValue = settings.value("run/precision", precisionName(precision)).toString();
+    if (!precisionFromName(precisionValue.toLatin1().constData(), &precision)){
+        error = QString("Scenario %1: unknown precision \"%2\".").arg(fileName, precisionValue);
+        return false;
+    }
+    if (sizeX < 3 || sizeY < 3 || alpha <= 0 || layers < 1 || layers > HeatSolver::maxPlateLayers || steps < 0
+            || threads < 0 || blockSteps < 1 || maxTimeStep <= 0 || tolerance <= 0 || adaptiveTolerance <= 0){
+        error = QString("Scenario %1: plate size, alpha, layers, steps, threads, block, maxdt or tolerances out of range.").arg(fileName);
+        return false;
+    }
+
+    // mask path is relative to the scenario file
+    maskFile.clear();
+    QString mask = settings.value("burner/mask").toString();
+    if (!mask.isEmpty()){
+        maskFile = QFileInfo(fileName).dir().absoluteFilePath(mask);
+    }
+
+    /* shapes are "kind numbers...", QSettings splits
+     * the comma separated value into a string list */
+    shapes.clear();
+    const QStringList shapeList = settings.value("burner/shapes").toStringList();
+    for (const QString &item : shapeList){
+        if (item.simplified().isEmpty()) continue;
+        BurnerShape shape;
+        if (!parseShape(fileName, item, &shape)) return false;
+        shapes.append(shape);
+    }
+
+    // heater schedule, "time:on" or "time:off", the heater is off before the first entry
+    schedule.clear();
+    const QStringList scheduleList = settings.value("heater/schedule", QString("0:on")).toStringList();
+    for (const QString &item : scheduleList){
+        const QStringList parts = item.trimmed().split(':');
+        bool ok = false;
+        HeaterSwitch heaterSwitch;
+        if (parts.size() == 2) heaterSwitch.time = parts[0].toDouble(&ok);
+        if (!ok || (parts[1] != "on" && parts[1] != "off")){
+            error = QString("Scenario %1: bad heater schedule entry \"%2\".").arg(fileName, item);
+            return false;
+        }
+        heaterSwitch.on = (parts[1] == "on");
+        schedule.append(heaterSwitch);
+    }
+    std::stable_sort(schedule.begin(), schedule.end(),
+                     [](const HeaterSwitch &a, const HeaterSwitch &b){ return a.time < b.time; });
+
+    return true;
+}
+
+bool Scenario::parseShape(const QString &fileName, const QString &item, BurnerShape *shape){
+    const QStringList words = item.simplified().split(' ', Qt::SkipEmptyParts);
+    int expectedArgs = 0;
+    const QString kind = words.isEmpty() ? QString() : words[0];
+    if (kind == "circle")    { shape->kind = BurnerShape::Circle; expectedArgs = 3; }
+    else if (kind == "line") { shape->kind = BurnerShape::Line;   expectedArgs = 5; }
+    else if (kind == "rect") { shape->kind = BurnerShape::Rect;   expectedArgs = 4; }
+    else {
+        error = QString("Scenario %1: unknown burner shape \"%2\".").arg(fileName, kind);
+        return false;
+    }
+    if (words.size() != expectedArgs + 1){
+        error = QString("Scenario %1: shape \"%2\" needs %3 numbers.").arg(fileName, item).arg(expectedArgs);
+        return false;
+    }
+    shape->args.clear();
+    for (int i = 1; i < words.size(); ++i){
+        bool ok = false;
+        shape->args.append(words[i].toInt(&ok));
+        if (!ok){
+            error = QString("Scenario %1: shape \"%2\" has a bad number.").arg(fileName, item);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Scenario::apply(HeatSolver &solver){
+    solver.resize(sizeX, sizeY);
+    solver.setAlpha(alpha);
+
+    if (!maskFile.isEmpty() && !applyMask(solver)) return false;
+    for (const BurnerShape &shape : shapes){
+        applyShape(solver, shape);
+    }
+
+    solver.countBurnerPixels();
+    solver.setWatts(watts);
+    solver.setBurner(heaterStateAt(0));
+    if (solver.getNumberOfBurnerPixels() == 0){
+        error = QString("Nothing is drawn, the scenario has no burner pixels.");
+        return false;
+    }
+    return true;
+}
+
+void Scenario::configure(HeatSolver &solver, KernelIsa isa) const{
+    solver.setKernelIsa(isa);
+    solver.setNumberOfThreads(threads);
+    solver.setTemporalBlocking(blockSteps);
+    solver.setIntegrator(integrator);
+    solver.setMaxTimeStep(maxTimeStep);
+    solver.setTimeStepFactor(timeStepFactor);
+    solver.setMultigridTolerance(tolerance);
+    solver.setAdaptiveTolerance(adaptiveTolerance);
+    solver.setActiveTileTracking(activeEpsilon >= 0);
+    solver.setActiveTileEpsilon(activeEpsilon);
+    solver.setPrecision(precision);
+    solver.setPlateLayers(layers);
+}
+
+bool Scenario::heaterStateAt(double time) const{
+    bool on = false;
+    for (const HeaterSwitch &heaterSwitch : schedule){
+        if (heaterSwitch.time > time) break;
+        on = heaterSwitch.on;
+    }
+    return on;
+}
+
+double Scenario::nextSwitchAfter(double time) const{
+    // infinity if the heater is never switched again
+    for (const HeaterSwitch &heaterSwitch : schedule){
+        if (heaterSwitch.time > time) return heaterSwitch.time;
+    }
+    return std::numeric_limits<double>::infinity();
+}
+
+bool Scenario::applyMask(HeatSolver &solver){
+    QImage mask(maskFile);
+    if (mask.isNull()){
+        error = QString("Burner mask %1 can not be read.").arg(maskFile);
+        return false;
+    }
+    // the mask is stretched over the whole plate, border points included
+    if (mask.size() != QSize(solver.sizeX(), solver.sizeY())){
+        mask = mask.scaled(solver.sizeX(), solver.sizeY(), Qt::IgnoreAspectRatio, Qt::FastTransformation);
+    }
+    mask = mask.convertToFormat(QImage::Format_ARGB32);
+
+    for (int y = 0; y < mask.height(); ++y){
+        const QRgb *line = reinterpret_cast<const QRgb *>(mask.constScanLine(y));
+        for (int x = 0; x < mask.width(); ++x){
+            // dark pixels are the burner, the same as the black pen in the GUI;
+            // fully transparent pixels are never the burner
+            if (qAlpha(line[x]) > 127 && qGray(line[x]) < 128){
+                solver.setBurnerCell(x, y, true);
+            }
+        }
+    }
+    return true;
+}
+
+void Scenario::applyShape(HeatSolver &solver, const BurnerShape &shape){
+    const QVector<int> &a = shape.args;
+    switch (shape.kind){
+    case BurnerShape::Circle:
+        solver.setBurnerDisc(a[0], a[1], a[2], true);
+        break;
+    case BurnerShape::Line:
+        // round capped stroke as the GUI pen
+        solver.setBurnerCapsule(a[0], a[1], a[2], a[3], a[4], true);
+        break;
+    case BurnerShape::Rect:
+        for (int y = a[1]; y < a[1] + a[3]; ++y){
+            for (int x = a[0]; x < a[0] + a[2]; ++x){
+                solver.setBurnerCell(x, y, true);
+            }
+        }
+        break;
+    }
+}
@@ -0,0 +1,106 @@
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+// Qt data structures
+#include <QString>
+#include <QVector>
+
+// heat model
+#include "heatsolver.h"
+
+/* Batch scenario for the headless runner, stored as an ini file:
+ *
+ *   [plate]
+ *   width=202                  ; simulation grid, border points included
+ *   height=202
+ *   alpha=23                   ; thermal diffusivity of the top, mm^2/s
+ *   layers=1                   ; layers through the thickness, 1 - the single layer model
+ *
+ *   [burner]
+ *   mask=burner.png            ; dark (or opaque) pixels are the burner, relative to the ini file
+ *   shapes=circle 101 101 120, line 30 30 170 170 20, rect 10 10 40 20
+ *
+ *   [heater]
+ *   watts=5000
+ *   schedule=0:on, 30:off      ; simulated second : heater state
+ *
+ *   [run]
+ *   steps=100000
+ *   threads=0                  ; 0 - single threaded
+ *   block=1                    ; temporal blocking, steps per sweep over the plate
+ *   integrator=explicit        ; adi, multigrid or rkc
+ *   dtfactor=20                ; time step of adi and multigrid in explicit stability limits
+ *   maxdt=0.1                  ; the time step is never larger, in seconds
+ *   tolerance=1e-8             ; multigrid, relative residual of a step
+ *   rkctolerance=1e-4          ; rkc, local error of a step relative to 1 + |T|
+ *   active=0.01                ; active tiles epsilon in deg C, not set - the whole plate is stepped
+ *   precision=double           ; float or mixed, explicit steps only
+ *
+ * Both mask and shapes are optional, shapes are painted over the mask. */
+
+//______________________________________________Scenario________________//
+QString integratorName(Integrator integrator);
+
+bool integratorFromName(const QString &name, Integrator *integrator);
+
+// thermal diffusivity of a top material by its name (iron, quartz...), false if it is not known
+bool materialAlpha(const QString &name, double *alpha);
+
+struct HeaterSwitch{
+    double time = 0;     // simulated time in seconds
+    bool on = false;
+};
+
+struct BurnerShape{
+    enum Kind { Circle, Line, Rect };
+    Kind kind = Circle;
+    QVector<int> args;   // circle: x y diameter, line: x1 y1 x2 y2 width, rect: x y width height
+};
+
+class Scenario{
+public:
+    bool load(const QString &fileName);
+
+    bool apply(HeatSolver &solver);
+
+    // the [run] settings: kernel, threads, blocking, integrator, time steps, tolerances, active tiles, precision
+    void configure(HeatSolver &solver, KernelIsa isa) const;
+
+    // "kind numbers..." of [burner] shapes, fileName only names the scenario in the error
+    bool parseShape(const QString &fileName, const QString &item, BurnerShape *shape);
+
+    bool heaterStateAt(double time) const;
+
+    double nextSwitchAfter(double time) const;
+
+    QString errorString() const { return error; }
+
+    int sizeX = 202;
+    int sizeY = 202;
+    double alpha = 5.;
+    int layers = 1;
+    int watts = 5000;
+    long long steps = 10000;
+    int threads = 0;
+    int blockSteps = 1;
+    Integrator integrator = Integrator::Explicit;
+    double timeStepFactor = 20.;
+    double maxTimeStep = 0.1;
+    double tolerance = 1e-8;
+    double adaptiveTolerance = 1e-4;
+    double activeEpsilon = -1;       // negative - no active tiles
+    Precision precision = Precision::Double;
+
+    QString maskFile;
+    QVector<BurnerShape> shapes;
+    QVector<HeaterSwitch> schedule;  // sorted by time
+
+private:
+    bool applyMask(HeatSolver &solver);
+
+    static void applyShape(HeatSolver &solver, const BurnerShape &shape);
+
+    QString error;
+};
+
+#endif // SCENARIO_H
@@ -0,0 +1,361 @@
+#include "simulationthread.h"
+
+// Qt timer
+#include <QElapsedTimer>
+
+// Qt multithreading
+#include <QtConcurrent>
+
+// C++ algorithms
+#include <algorithm>
+#include <cmath>
+
+#include "framerecorder.h"
+#include "profiler.h"
+
+SimulationThread::SimulationThread(HeatSolver &solver, QObject *parent)
+    : QThread(parent), solver(solver),
+      burnerOn(solver.isBurnerOn()), watts(solver.getWatts()),
+      alpha(solver.getAlpha()), numberOfThreads(solver.getNumberOfThreads()),
+      plateLayers(solver.getPlateLayers()){
+    solver.setInterruptFlag(&interruptSteps);
+}
+
+SimulationThread::~SimulationThread(){
+    stopSimulation();
+    solver.setInterruptFlag(nullptr);
+}
+
+
+
+/*                                              PUBLIC METHODS                         */
+void SimulationThread::startSimulation(long long maxSteps){
+    if (isRunning()) return;
+    maxSimulationSteps = maxSteps;
+    QMutexLocker lock(&controlMutex);
+    paused.store(false, std::memory_order_relaxed);
+    requestedSteps = 0;
+    interruptSteps.store(false, std::memory_order_relaxed);
+    lock.unlock();
+    start();
+}
+
+void SimulationThread::stopSimulation(){
+    QMutexLocker lock(&controlMutex);
+    requestInterruption();
+    interruptSteps.store(true, std::memory_order_relaxed);
+    controlChanged.wakeAll();
+    lock.unlock();
+    wait();
+}
+
+void SimulationThread::pauseSimulation(){
+    QMutexLocker lock(&controlMutex);
+    paused.store(true, std::memory_order_relaxed);
+    requestedSteps = 0;
+    interruptSteps.store(true, std::memory_order_relaxed);
+}
+
+void SimulationThread::resumeSimulation(){
+    QMutexLocker lock(&controlMutex);
+    paused.store(false, std::memory_order_relaxed);
+    requestedSteps = 0;
+    controlChanged.wakeAll();
+}
+
+void SimulationThread::stepSimulation(int steps){
+    QMutexLocker lock(&controlMutex);
+    if (!paused.load(std::memory_order_relaxed) || steps <= 0) return;
+    requestedSteps += steps;
+    controlChanged.wakeAll();
+}
+
+void SimulationThread::setBurner(bool status){
+    burnerOn.store(status, std::memory_order_relaxed);
+    settingsChanged.store(true, std::memory_order_release);
+}
+
+void SimulationThread::setWatts(int newW){
+    watts.store(newW, std::memory_order_relaxed);
+    settingsChanged.store(true, std::memory_order_release);
+}
+
+void SimulationThread::setAlpha(double newAlpha){
+    alpha.store(newAlpha, std::memory_order_relaxed);
+    settingsChanged.store(true, std::memory_order_release);
+}
+
+void SimulationThread::setNumberOfThreads(int newThreads){
+    numberOfThreads.store(newThreads, std::memory_order_relaxed);
+    settingsChanged.store(true, std::memory_order_release);
+}
+
+void SimulationThread::setPlateLayers(int layers){
+    plateLayers.store(layers, std::memory_order_relaxed);
+    settingsChanged.store(true, std::memory_order_release);
+}
+
+void SimulationThread::setRealTimeFactor(double factor){
+    if (factor > 0) factor = std::max(minRealTimeFactor, std::min(maxRealTimeFactor, factor));
+    realTimeFactor.store(std::max(0., factor), std::memory_order_relaxed);
+    clockChanged.store(true, std::memory_order_relaxed);
+    // a thread waiting for the clock takes the new pace at once
+    QMutexLocker lock(&controlMutex);
+    controlChanged.wakeAll();
+}
+
+void SimulationThread::setSteadyStateAction(SteadyStateAction action, double tolerance){
+    steadyStateAction.store(static_cast<int>(action), std::memory_order_relaxed);
+    steadyStateTolerance.store(tolerance, std::memory_order_relaxed);
+    settingsChanged.store(true, std::memory_order_release);
+}
+
+void SimulationThread::requestCheckpoint(const QString &fileName){
+    QMutexLocker lock(&checkpointMutex);
+    requestedCheckpointFile = fileName;
+    checkpointRequested.store(true, std::memory_order_relaxed);
+    lock.unlock();
+    // a paused thread writes it at once
+    QMutexLocker controlLock(&controlMutex);
+    controlChanged.wakeAll();
+}
+
+void SimulationThread::setPeriodicCheckpoint(const QString &fileName, int periodSeconds){
+    QMutexLocker lock(&checkpointMutex);
+    periodicCheckpointFile = fileName;
+    checkpointPeriod.store(fileName.isEmpty() ? 0 : periodSeconds, std::memory_order_relaxed);
+}
+
+
+
+/*                                              PROTECTED METHODS                      */
+void SimulationThread::run(){
+    /* steps in batches of whole steps, about a framePeriod of wall time each (see
+     * batchSeconds), the settings are only applied between the batches, the frame is
+     * published every framePeriod */
+    Profiler::instance().setThreadName("simulation");
+    steadyStateMonitor.reset();
+    applySettings();
+    resetClock();
+    publishFrame();
+    QElapsedTimer frameTimer;
+    frameTimer.start();
+    QElapsedTimer checkpointTimer;
+    checkpointTimer.start();
+
+    while (solver.getCurrentStep() < maxSimulationSteps){
+        long long pausedSteps = 0;
+        if (waitForControl(&pausedSteps)) break;
+        applySettings();
+        const long long remaining = maxSimulationSteps - solver.getCurrentStep();
+        // the steps asked for while paused are published by waitForControl once they are done
+        if (pausedSteps > 0){
+            solver.calcHeatingSteps(static_cast<int>(std::min(pausedSteps, remaining)));
+        }
+        else if (const double seconds = batchSeconds()){
+            const long long stepsBefore = solver.getCurrentStep();
+            QElapsedTimer batchTimer;
+            batchTimer.start();
+            if (remaining > solver.stepsPerPeriod(seconds)) solver.advanceTime(seconds);
+            else solver.calcHeatingSteps(static_cast<int>(remaining));
+            measureBatch(solver.getCurrentStep() - stepsBefore, batchTimer.nsecsElapsed() / 1e9);
+            if (checkSteadyState()) break;
+        }
+
+        if (frameTimer.elapsed() >= framePeriod){
+            publishFrame();
+            frameTimer.restart();
+        }
+
+        // a checkpoint only waits while the previous one is still being written
+        const int period = checkpointPeriod.load(std::memory_order_relaxed);
+        if (checkpointRequested.load(std::memory_order_relaxed) && !checkpointWrite.isRunning()){
+            writeRequestedCheckpoint();
+        }
+        else if (period > 0 && checkpointTimer.elapsed() >= period * 1000LL && !checkpointWrite.isRunning()){
+            QMutexLocker lock(&checkpointMutex);
+            const QString fileName = periodicCheckpointFile;
+            lock.unlock();
+            if (writeCheckpoint(fileName)) checkpointTimer.restart();
+        }
+    }
+    // the last state and the settings changed during the last batch
+    applySettings();
+    publishFrame();
+    // the checkpoint is on disk once the simulation is stopped
+    checkpointWrite.waitForFinished();
+}
+
+
+
+/*                                              PRIVATE METHODS                        */
+bool SimulationThread::waitForControl(long long *steps){
+    /* between two batches: the interrupt flag is cleared under the mutex, so a pause or
+     * stop asked from here on interrupts the next batch; while paused the last state is
+     * published once and the thread sleeps until it is resumed, stepped or stopped */
+    QMutexLocker lock(&controlMutex);
+    bool published = false;
+    while (!isInterruptionRequested() && paused.load(std::memory_order_relaxed) && requestedSteps == 0){
+        if (!published || checkpointRequested.load(std::memory_order_relaxed)){
+            lock.unlock();
+            if (!published){
+                applySettings();
+                achievedRate = 0;
+                publishFrame();
+                published = true;
+            }
+            if (checkpointRequested.load(std::memory_order_relaxed)){
+                checkpointWrite.waitForFinished();
+                writeRequestedCheckpoint();
+            }
+            lock.relock();
+            continue;
+        }
+        controlChanged.wait(&controlMutex);
+    }
+    if (isInterruptionRequested()) return true;
+    // the wall time spent paused is not owed to the clock
+    if (published) resetClock();
+    *steps = paused.load(std::memory_order_relaxed) ? requestedSteps : 0;
+    requestedSteps = 0;
+    interruptSteps.store(false, std::memory_order_relaxed);
+    return false;
+}
+
+void SimulationThread::applySettings(){
+    // acquire: the values stored before the flag are visible
+    if (!settingsChanged.exchange(false, std::memory_order_acquire)) return;
+    solver.setBurner(burnerOn.load(std::memory_order_relaxed));
+    solver.setWatts(watts.load(std::memory_order_relaxed));
+    solver.setAlpha(alpha.load(std::memory_order_relaxed));
+    solver.setNumberOfThreads(numberOfThreads.load(std::memory_order_relaxed));
+    solver.setPlateLayers(plateLayers.load(std::memory_order_relaxed));
+    // the samples taken before the change tell nothing about the new steady state
+    const SteadyStateAction action = static_cast<SteadyStateAction>(steadyStateAction.load(std::memory_order_relaxed));
+    solver.setSteadyStateMonitor(action != SteadyStateAction::Off);
+    steadyStateMonitor.reset();
+    steadyStateMonitor.setTolerance(steadyStateTolerance.load(std::memory_order_relaxed));
+}
+
+double SimulationThread::batchSeconds(){
+    /* as many steps as take about a framePeriod of wall time by the measured cost of a step
+     * (one step to measure it first); paced, no more than the clock is due, in whole steps
+     * while at least one is due, and while none is the thread waits for it or for a request */
+    if (clockChanged.exchange(false, std::memory_order_relaxed)) resetClock();
+    const double timeStep = solver.getTimeStep();
+    const double steps = stepCost > 0 ? std::max(1., std::floor(framePeriod / 1000. / stepCost)) : 1.;
+    const double factor = realTimeFactor.load(std::memory_order_relaxed);
+    if (factor <= 0) return steps * timeStep;
+
+    const double due = clockStart + factor * clockTimer.nsecsElapsed() / 1e9 - solver.getSimulatedTime();
+    if (due >= timeStep) return std::min(steps, std::floor(due / timeStep)) * timeStep;
+    const int wait = static_cast<int>(std::ceil((timeStep - due) / factor * 1000.));
+    QMutexLocker lock(&controlMutex);
+    if (!isInterruptionRequested() && !paused.load(std::memory_order_relaxed) && requestedSteps == 0
+            && !checkpointRequested.load(std::memory_order_relaxed)){
+        controlChanged.wait(&controlMutex, static_cast<unsigned long>(std::min(wait, framePeriod)));
+    }
+    return 0;
+}
+
+void SimulationThread::resetClock(){
+    clockStart = solver.getSimulatedTime();
+    clockTimer.start();
+    rateStart = clockStart;
+    rateTimer.start();
+}
+
+void SimulationThread::measureBatch(long long steps, double seconds){
+    // the cost of a step follows the plate, the threads and the integrator, a few batches weigh in
+    if (steps > 0){
+        const double cost = seconds / steps;
+        stepCost = stepCost > 0 ? 0.7 * stepCost + 0.3 * cost : cost;
+    }
+    const double factor = realTimeFactor.load(std::memory_order_relaxed);
+    if (factor > 0){
+        const double behind = clockStart + factor * clockTimer.nsecsElapsed() / 1e9 - solver.getSimulatedTime();
+        if (behind > factor * maxClockLag){
+            clockStart = solver.getSimulatedTime();
+            clockTimer.start();
+        }
+    }
+    if (rateTimer.elapsed() >= rateWindow){
+        achievedRate = (solver.getSimulatedTime() - rateStart) / (rateTimer.nsecsElapsed() / 1e9);
+        rateStart = solver.getSimulatedTime();
+        rateTimer.start();
+    }
+}
+
+bool SimulationThread::checkSteadyState(){
+    /* the layered plate and the other integrators gather no statistics, their samples
+     * are skipped and they run on */
+    const SteadyStateAction action = static_cast<SteadyStateAction>(steadyStateAction.load(std::memory_order_relaxed));
+    if (action == SteadyStateAction::Off) return false;
+    steadyStateMonitor.addSample(solver.getLastStepStatistics());
+    if (action == SteadyStateAction::Stop && steadyStateMonitor.isSteady()){
+        emit steadyStateReached(solver.getSimulatedTime(), 0, false);
+        return true;
+    }
+    if (action == SteadyStateAction::Solve && steadyStateMonitor.isSettled()){
+        const double remaining = steadyStateMonitor.secondsToEquilibrium();
+        if (!solver.solveSteadyState()) return false;
+        emit steadyStateReached(solver.getSimulatedTime(), remaining, true);
+        return true;
+    }
+    return false;
+}
+
+void SimulationThread::writeRequestedCheckpoint(){
+    QMutexLocker lock(&checkpointMutex);
+    const QString fileName = requestedCheckpointFile;
+    checkpointRequested.store(false, std::memory_order_relaxed);
+    lock.unlock();
+    writeCheckpoint(fileName);
+}
+
+bool SimulationThread::writeCheckpoint(const QString &fileName){
+    // the state is copied here, between two batches, the file is written on the pool
+    if (fileName.isEmpty()) return false;
+    std::shared_ptr<Checkpoint> checkpoint = std::make_shared<Checkpoint>();
+    checkpoint->capture(solver);
+    checkpointWrite = QtConcurrent::run([this, checkpoint, fileName](){
+        QString error;
+        checkpoint->write(fileName, &error);
+        emit checkpointWritten(fileName, error);
+    });
+    return true;
+}
+
+void SimulationThread::publishFrame(){
+    // the buffers keep their size, nothing is allocated after the first frames
+    ProfileScope scope(ProfilePhase::Publish);
+    frames.writeBuffer().copyFrom(solver);
+    frames.writeBuffer().realTimeFactor = achievedRate;
+    // the recorder copies the frame if it is due, it never waits for its writer
+    if (recorder) recorder->recordFrame(frames.writeBuffer());
+    frames.publish();
+}
+
+
+
+//______________________________________________Simulation Frame________________//
+void SimulationFrame::copyFrom(const HeatSolver &solver){
+    sizeX = solver.sizeX();
+    sizeY = solver.sizeY();
+    tileCountX = solver.getTileCountX();
+    tileCountY = solver.getTileCountY();
+    temperatures.resize(static_cast<size_t>(sizeX) * sizeY);
+    for (int y = 0; y < sizeY; ++y){
+        const double *row = solver.temperatureRow(y);
+        std::copy(row, row + sizeX, temperatures.begin() + static_cast<size_t>(y) * sizeX);
+    }
+    activeTiles.resize(static_cast<size_t>(tileCountX) * tileCountY);
+    for (int tileY = 0; tileY < tileCountY; ++tileY){
+        for (int tileX = 0; tileX < tileCountX; ++tileX){
+            activeTiles[tileY * tileCountX + tileX] = solver.isTileActive(tileX, tileY);
+        }
+    }
+    ambientTemperature = solver.getAmbientTemperature();
+    step = solver.getCurrentStep();
+    simulatedTime = solver.getSimulatedTime();
+}
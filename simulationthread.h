@@ -0,0 +1,211 @@
+#ifndef SIMULATIONTHREAD_H
+#define SIMULATIONTHREAD_H
+
+/* The heat solver steps on its own thread, as fast as it can, and publishes
+ * a copy of its state through a triple buffer every framePeriod. The UI takes
+ * the newest frame when it repaints, so neither side waits for the other.
+ * Settings changed from the UI are stored in atomics and applied by the
+ * simulation thread between two batches of steps. Checkpoints are captured
+ * between two batches too and written to disk in the background, and the
+ * published frames can be handed to a FrameRecorder.
+ * A run can be paused, resumed, stepped a given number of steps while paused
+ * and stopped; the solver reads the interrupt flag once per step (see
+ * HeatSolver::setInterruptFlag), so a request cuts the batch being stepped
+ * after the current step, the loops over the points are not touched.
+ * With a steady state action the convergence gathered by the steps is sampled
+ * once per batch (see SteadyStateMonitor): the run stops when the plate is
+ * steady, or jumps to its equilibrium once only the slow decay is left.
+ * The simulated time is paced against the wall clock by a real-time factor, or
+ * runs as fast as it can; a batch is sized from the measured cost of a step so
+ * it takes about a framePeriod of wall time at any speed, and the simulated
+ * seconds per wall second achieved are published with the frames. */
+
+// Qt multithreading
+#include <QThread>
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QMutex>
+#include <QWaitCondition>
+
+// C++ libs
+#include <atomic>
+#include <vector>
+
+#include "checkpoint.h"
+#include "heatsolver.h"
+#include "steadystate.h"
+#include "triplebuffer.h"
+
+class FrameRecorder;
+
+//______________________________________________Simulation Frame________________//
+struct SimulationFrame{
+    int sizeX = 0, sizeY = 0;
+    int tileCountX = 0, tileCountY = 0;
+    std::vector<double> temperatures;   // row by row, only valid in the active tiles
+    std::vector<char> activeTiles;
+    double ambientTemperature = HeatSolver::outsideTemperature;
+    long long step = 0;
+    double simulatedTime = 0;
+    double realTimeFactor = 0;          // simulated seconds per wall second achieved lately, 0 - paused or not known yet
+
+    const double *temperatureRow(int y) const { return temperatures.data() + static_cast<size_t>(y) * sizeX; }
+
+    bool isTileActive(int tileX, int tileY) const { return activeTiles[tileY * tileCountX + tileX] != 0; }
+
+    // copy of the current state of the solver, the vectors keep their size between frames
+    void copyFrom(const HeatSolver &solver);
+};
+
+//______________________________________________Simulation Thread________________//
+class SimulationThread : public QThread{
+    Q_OBJECT
+
+public:
+    SimulationThread(HeatSolver &solver, QObject *parent = nullptr);
+
+    ~SimulationThread();
+
+    // starts stepping from the current state of the solver
+    void startSimulation(long long maxSteps);
+
+    // interrupts the steps after the current one and waits for the thread to end
+    void stopSimulation();
+
+    // the thread stops stepping after the current step and waits, the last state is published
+    void pauseSimulation();
+
+    void resumeSimulation();
+
+    // while paused: steps more steps, publishes the state and waits again
+    void stepSimulation(int steps);
+
+    bool isPaused() const { return paused.load(std::memory_order_relaxed); }
+
+    // UI side: true if a newer frame was published since the last call
+    bool takeFrame() { return frames.update(); }
+
+    const SimulationFrame &frame() const { return frames.readBuffer(); }
+
+    // settings, safe to call while the simulation is running
+    void setBurner(bool status);
+
+    void setWatts(int newW);
+
+    void setAlpha(double newAlpha);
+
+    void setNumberOfThreads(int newThreads);
+
+    void setPlateLayers(int layers);
+
+    int getWatts() const { return watts.load(std::memory_order_relaxed); }
+
+    /* simulated seconds per wall second, minRealTimeFactor..maxRealTimeFactor; 0 - as fast
+     * as it can. A run that can not keep up steps as fast as it can and does not catch up
+     * later, the clock drops what it is more than maxClockLag behind */
+    void setRealTimeFactor(double factor);
+
+    double getRealTimeFactor() const { return realTimeFactor.load(std::memory_order_relaxed); }
+
+    static constexpr double minRealTimeFactor = 0.1;
+    static constexpr double maxRealTimeFactor = 1000.;
+
+    // what the run does about its steady state, tolerance in deg C per second
+    void setSteadyStateAction(SteadyStateAction action, double tolerance);
+
+    // a checkpoint of the running simulation after the current batch, see checkpointWritten
+    void requestCheckpoint(const QString &fileName);
+
+    // also one every periodSeconds of wall time while the simulation runs, 0 - off
+    void setPeriodicCheckpoint(const QString &fileName, int periodSeconds);
+
+    // gets every published frame, it keeps the ones it records; set while stopped, nullptr - none
+    void setRecorder(FrameRecorder *newRecorder) { recorder = newRecorder; }
+
+    static constexpr int framePeriod = 40;   // ms between two published frames
+    static constexpr double maxClockLag = 1.;       // s of wall time the paced clock may fall behind
+    static constexpr int rateWindow = 500;          // ms of wall time the achieved rate is measured over
+
+signals:
+    // from the writing thread, error is empty if the file was written
+    void checkpointWritten(const QString &fileName, const QString &error);
+
+    /* the run ended at its steady state: stepped to it (solved false), or the equilibrium was
+     * solved for at simulatedTime, secondsToSteady of simulated time before the run would have
+     * come within SteadyStateMonitor::equilibriumAccuracy of it (< 0 - not known) */
+    void steadyStateReached(double simulatedTime, double secondsToSteady, bool solved);
+
+protected:
+    void run() override;
+
+private:
+    void applySettings();
+
+    // waits while paused, true when the run is stopped; *steps - the steps asked for while paused, 0 - run on
+    bool waitForControl(long long *steps);
+
+    // the simulated seconds of the next batch, 0 - the clock is not due, the thread waited
+    double batchSeconds();
+
+    // the clock and the achieved rate start again from the current simulated time
+    void resetClock();
+
+    // after a batch of steps that took seconds of wall time
+    void measureBatch(long long steps, double seconds);
+
+    // after a batch: samples the convergence, true when the run ends at its steady state
+    bool checkSteadyState();
+
+    void publishFrame();
+
+    bool writeCheckpoint(const QString &fileName);
+
+    void writeRequestedCheckpoint();
+
+    HeatSolver &solver;
+    TripleBuffer<SimulationFrame> frames;
+    FrameRecorder *recorder = nullptr;
+    long long maxSimulationSteps = 0;
+
+    // pending settings, written by the UI, read by the simulation thread
+    std::atomic<bool> settingsChanged{false};
+    std::atomic<bool> burnerOn;
+    std::atomic<int> watts;
+    std::atomic<double> alpha;
+    std::atomic<int> numberOfThreads;
+    std::atomic<int> plateLayers;
+    std::atomic<int> steadyStateAction{static_cast<int>(SteadyStateAction::Off)};
+    std::atomic<double> steadyStateTolerance{1e-2};
+
+    // the clock: simulatedTime - clockStart is paced at realTimeFactor times clockTimer
+    std::atomic<double> realTimeFactor{0.};
+    std::atomic<bool> clockChanged{false};
+    QElapsedTimer clockTimer;
+    double clockStart = 0;
+    double stepCost = 0;                // wall seconds of a step, averaged over the batches, 0 - not measured yet
+    QElapsedTimer rateTimer;
+    double rateStart = 0;               // simulated time at the start of the rate window
+    double achievedRate = 0;
+
+    // the convergence of the run, restarted when the settings change
+    SteadyStateMonitor steadyStateMonitor;
+
+    /* pause, single steps and stop, guarded by controlMutex; interruptSteps is the flag of
+     * the solver, set by a request, cleared by the thread under the mutex before a batch, so
+     * no request made while the batch starts is lost */
+    QMutex controlMutex;
+    QWaitCondition controlChanged;
+    std::atomic<bool> interruptSteps{false};
+    std::atomic<bool> paused{false};
+    long long requestedSteps = 0;
+
+    // checkpoints, the file names are guarded by checkpointMutex
+    QMutex checkpointMutex;
+    std::atomic<bool> checkpointRequested{false};
+    QString requestedCheckpointFile;
+    QString periodicCheckpointFile;
+    std::atomic<int> checkpointPeriod{0};      // s
+    QFuture<void> checkpointWrite;             // one write at a time, the next ones wait for it
+};
+
+#endif // SIMULATIONTHREAD_H
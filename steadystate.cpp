@@ -0,0 +1,104 @@
+#include "steadystate.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+const char *steadyStateActionName(SteadyStateAction action){
+    switch (action){
+    case SteadyStateAction::Stop: return "stop";
+    case SteadyStateAction::Solve: return "solve";
+    default: return "off";
+    }
+}
+
+bool steadyStateActionFromName(const char *name, SteadyStateAction *action){
+    for (SteadyStateAction candidate : {SteadyStateAction::Off, SteadyStateAction::Stop, SteadyStateAction::Solve}){
+        if (std::strcmp(name, steadyStateActionName(candidate)) == 0){
+            *action = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+void SteadyStateMonitor::reset(){
+    hasSample = false;
+    rate = 0;
+    heatContent = 0;
+    heaterGap = 0;
+    baseTime = 0;
+    baseRate = 0;
+    baseHeaterGap = 0;
+    decayTime = 0;
+    agreeingEstimates = 0;
+    decayStart = 0;
+    heaterRate = 0;
+}
+
+void SteadyStateMonitor::addSample(const StepStatistics &statistics){
+    if (!statistics.valid) return;
+    rate = statistics.maxRate;
+    heatContent = statistics.heatContent;
+    heaterGap = statistics.heaterGap;
+    if (!hasSample){
+        hasSample = true;
+        baseTime = statistics.simulatedTime;
+        baseRate = rate;
+        baseHeaterGap = heaterGap;
+        decayStart = baseTime;
+        return;
+    }
+    // a fraction of tau apart, closer samples only see the noise of the fast modes
+    const double interval = statistics.simulatedTime - baseTime;
+    if (interval < std::max(minInterval, estimateSpan * decayTime)) return;
+
+    // a rate that does not go down (the burner switched, the settings changed) starts the decay again
+    if (rate <= 0 || rate >= baseRate){
+        decayTime = 0;
+        agreeingEstimates = 0;
+        decayStart = statistics.simulatedTime;
+    }
+    else {
+        const double estimate = interval / std::log(baseRate / rate);
+        const bool agrees = decayTime > 0 && std::fabs(estimate - decayTime) <= settleAgreement * estimate;
+        agreeingEstimates = agrees ? agreeingEstimates + 1 : 0;
+        decayTime = estimate;
+    }
+    // the gap of the heater shrinks as 1/(1/gap + k*t)
+    heaterRate = (heaterGap > 0 && baseHeaterGap > heaterGap) ? (1./heaterGap - 1./baseHeaterGap) / interval : 0;
+    baseTime = statistics.simulatedTime;
+    baseRate = rate;
+    baseHeaterGap = heaterGap;
+}
+
+bool SteadyStateMonitor::isSettled() const{
+    // the equilibrium has the heater at its limit, far from it a jump would skip the rest of the heating
+    const double heaterRange = HeatSolver::maxHeaterTemp - HeatSolver::outsideTemperature;
+    if (!hasSample || heaterGap > settleHeaterGap * heaterRange) return false;
+    if (isSteady()) return true;
+    return agreeingEstimates >= settleSamples && decayTime > 0 && baseTime - decayStart >= settleSpans * decayTime;
+}
+
+double SteadyStateMonitor::secondsToSteady() const{
+    if (isSteady()) return 0;
+    if (decayTime <= 0) return -1;
+    const double plate = decayTime * std::log(rate / tolerance);
+    if (heaterGap <= 0) return plate;
+    if (heaterRate <= 0) return -1;
+    // the plate follows the heater at most as fast as it changes: until k*gap^2 is within the tolerance
+    const double gapAtTolerance = std::sqrt(tolerance / heaterRate);
+    const double heater = gapAtTolerance < heaterGap ? (1./gapAtTolerance - 1./heaterGap) / heaterRate : 0.;
+    return std::max(plate, heater);
+}
+
+double SteadyStateMonitor::secondsToEquilibrium(double degrees) const{
+    // an exponential decay still has rate*tau to go, the heater gap shrinks as 1/(1/gap + k*t)
+    if (!hasSample || degrees <= 0) return -1;
+    double plate = 0;
+    if (rate > 0 && decayTime <= 0) return -1;
+    if (rate * decayTime > degrees) plate = decayTime * std::log(rate * decayTime / degrees);
+    if (heaterGap <= degrees) return plate;
+    if (heaterRate <= 0) return -1;
+    return std::max(plate, (1./degrees - 1./heaterGap) / heaterRate);
+}
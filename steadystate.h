@@ -0,0 +1,84 @@
+#ifndef STEADYSTATE_H
+#define STEADYSTATE_H
+
+/* Convergence of a run towards its steady state, from the statistics the explicit steps
+ * gather in their stencil sweep (HeatSolver::getLastStepStatistics), one sample per batch
+ * of steps. Once the fast transients are gone the change of the plate decays as
+ * exp(-t/tau) of its slowest mode: tau is estimated from two samples a fraction of tau
+ * apart. The run is settled, its equilibrium can be solved for instead of stepped to
+ * (HeatSolver::solveSteadyState), only when the heater is near its limit, the rate has
+ * gone down at every sample over at least settleSpans * tau and the last estimates of
+ * tau agree. The heater approaches its limit as a power law, its remaining time is
+ * estimated from two samples of its gap, so secondsToSteady and secondsToEquilibrium
+ * take the slower of the plate and the heater. */
+
+#include "heatsolver.h"
+
+// what a run does about its steady state
+enum class SteadyStateAction { Off, Stop, Solve };
+
+const char *steadyStateActionName(SteadyStateAction action);
+
+bool steadyStateActionFromName(const char *name, SteadyStateAction *action);
+
+//______________________________________________Steady State Monitor________________//
+class SteadyStateMonitor{
+public:
+    void reset();
+
+    // steady: no point of the plate changes faster than this, deg C per second
+    void setTolerance(double degreesPerSecond) { tolerance = degreesPerSecond; }
+
+    double getTolerance() const { return tolerance; }
+
+    // the statistics of the last step of a batch, the invalid ones are skipped
+    void addSample(const StepStatistics &statistics);
+
+    bool isSteady() const { return hasSample && rate <= tolerance; }
+
+    // only the slow decay is left and the heater is near its limit, the equilibrium can be solved for
+    bool isSettled() const;
+
+    double getRate() const { return rate; }
+
+    double getHeatContent() const { return heatContent; }
+
+    double getHeaterGap() const { return heaterGap; }
+
+    // tau in seconds, 0 - not known yet
+    double getDecayTime() const { return decayTime; }
+
+    // simulated seconds until the rate is within the tolerance, 0 if it is, < 0 if not known
+    double secondsToSteady() const;
+
+    /* simulated seconds until the plate and the heater are within degrees of the equilibrium
+     * HeatSolver::solveSteadyState jumps to: what a jump skips, < 0 if not known */
+    double secondsToEquilibrium(double degrees = equilibriumAccuracy) const;
+
+    static constexpr double minInterval = 0.1;       // s of simulated time between two samples of an estimate, at least
+    static constexpr double estimateSpan = 0.25;     // and a quarter of tau once it is known
+    static constexpr double settleAgreement = 0.1;   // relative difference of the estimates that agree
+    static constexpr int settleSamples = 3;
+    static constexpr double settleSpans = 3.;        // taus the decay has been seen for
+    static constexpr double settleHeaterGap = 0.05;  // of the heater range (outside to maxHeaterTemp)
+    static constexpr double equilibriumAccuracy = 0.1;   // deg C
+
+private:
+    double tolerance = 1e-2;
+
+    bool hasSample = false;
+    double rate = 0;
+    double heatContent = 0;
+    double heaterGap = 0;
+
+    // the sample the next estimate is taken from
+    double baseTime = 0;
+    double baseRate = 0;
+    double baseHeaterGap = 0;
+    double decayTime = 0;
+    int agreeingEstimates = 0;
+    double decayStart = 0;          // since when the rate went down at every sample
+    double heaterRate = 0;          // k of the gap of the heater, d(gap)/dt = -k*gap^2, 0 - not known
+};
+
+#endif // STEADYSTATE_H
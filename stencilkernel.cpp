@@ -0,0 +1,701 @@
+#include "stencilkernel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define STENCIL_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+// no fused multiply-add contraction, the kernels have to match the scalar reference
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize ("fp-contract=off")
+#endif
+
+/* every kernel does the operations in the same order as the scalar one,
+ * (mul, add, add, add, no fused multiply-add), so the results are the same */
+static void stencilRowScalar(const double *up, const double *mid, const double *down,
+                             const double *heater, double *out, int n, const StencilCoefficients &c){
+    for (int i = 0; i < n; ++i){
+        const double T = mid[i];
+        double result = c.center * T;
+        result += c.x * (mid[i-1] + mid[i+1]);
+        result += c.y * (up[i] + down[i]);
+        result += c.z * (std::min(c.outside, T*0.7) + heater[i]);
+        out[i] = result;
+    }
+}
+
+static void floatStencilRowScalar(const float *up, const float *mid, const float *down,
+                                  const float *heater, float *out, int n, const StencilCoefficients &c){
+    const float center = static_cast<float>(c.center);
+    const float cx = static_cast<float>(c.x);
+    const float cy = static_cast<float>(c.y);
+    const float cz = static_cast<float>(c.z);
+    const float outside = static_cast<float>(c.outside);
+    for (int i = 0; i < n; ++i){
+        const float T = mid[i];
+        float result = center * T;
+        result += cx * (mid[i-1] + mid[i+1]);
+        result += cy * (up[i] + down[i]);
+        result += cz * (std::min(outside, T*0.7f) + heater[i]);
+        out[i] = result;
+    }
+}
+
+static void mixedStencilRowScalar(const float *up, const float *mid, const float *down,
+                                  const double *heater, float *out, int n, const StencilCoefficients &c){
+    // the same as the double kernel, only the plate is loaded from and rounded to float
+    for (int i = 0; i < n; ++i){
+        const double T = mid[i];
+        double result = c.center * T;
+        result += c.x * (static_cast<double>(mid[i-1]) + static_cast<double>(mid[i+1]));
+        result += c.y * (static_cast<double>(up[i]) + static_cast<double>(down[i]));
+        result += c.z * (std::min(c.outside, T*0.7) + heater[i]);
+        out[i] = static_cast<float>(result);
+    }
+}
+
+/* layered plate (HeatSolver::setPlateLayers): the neighbours in z are the layers below and
+ * above the row (the heater under the lowest one, the air over the top one) */
+static void layeredStencilRowScalar(const double *up, const double *mid, const double *down,
+                                    const double *below, const double *above, double *out, int n,
+                                    const StencilCoefficients &c){
+    for (int i = 0; i < n; ++i){
+        double result = c.center * mid[i];
+        result += c.x * (mid[i-1] + mid[i+1]);
+        result += c.y * (up[i] + down[i]);
+        result += c.z * (below[i] + above[i]);
+        out[i] = result;
+    }
+}
+
+static void layerSweepRowScalar(const double *neighbour, double *out, int n, double coupling, double scale){
+    for (int i = 0; i < n; ++i) out[i] = (out[i] + coupling * neighbour[i]) * scale;
+}
+
+/* the convergence monitor (HeatSolver::setSteadyStateMonitor): the stencil of stencilRowScalar,
+ * the change and the sum of the points are gathered while they are in registers */
+static void monitoredStencilRowScalar(const double *up, const double *mid, const double *down,
+                                      const double *heater, double *out, int n, const StencilCoefficients &c,
+                                      StencilRowStats &stats){
+    double maxChange = stats.maxChange;
+    double sum = stats.sum;
+    for (int i = 0; i < n; ++i){
+        const double T = mid[i];
+        double result = c.center * T;
+        result += c.x * (mid[i-1] + mid[i+1]);
+        result += c.y * (up[i] + down[i]);
+        result += c.z * (std::min(c.outside, T*0.7) + heater[i]);
+        out[i] = result;
+        maxChange = std::max(maxChange, std::fabs(result - T));
+        sum += result;
+    }
+    stats.maxChange = maxChange;
+    stats.sum = sum;
+}
+
+#ifdef STENCIL_X86_KERNELS
+/* GCC 12 reports the _mm512_undefined_* placeholders of the AVX-512 intrinsics (min, masked
+ * loads, conversions) as uninitialized once inlined here; every lane is written before it is used */
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+__attribute__((target("sse2")))
+static void stencilRowSSE2(const double *up, const double *mid, const double *down,
+                           const double *heater, double *out, int n, const StencilCoefficients &c){
+    const __m128d center = _mm_set1_pd(c.center);
+    const __m128d cx = _mm_set1_pd(c.x);
+    const __m128d cy = _mm_set1_pd(c.y);
+    const __m128d cz = _mm_set1_pd(c.z);
+    const __m128d outside = _mm_set1_pd(c.outside);
+    const __m128d factor = _mm_set1_pd(0.7);
+
+    int i = 0;
+    for (; i + 2 <= n; i += 2){
+        const __m128d T = _mm_loadu_pd(mid + i);
+        __m128d result = _mm_mul_pd(center, T);
+        result = _mm_add_pd(result, _mm_mul_pd(cx, _mm_add_pd(_mm_loadu_pd(mid + i - 1), _mm_loadu_pd(mid + i + 1))));
+        result = _mm_add_pd(result, _mm_mul_pd(cy, _mm_add_pd(_mm_loadu_pd(up + i), _mm_loadu_pd(down + i))));
+        const __m128d air = _mm_min_pd(_mm_mul_pd(T, factor), outside);
+        result = _mm_add_pd(result, _mm_mul_pd(cz, _mm_add_pd(air, _mm_loadu_pd(heater + i))));
+        _mm_storeu_pd(out + i, result);
+    }
+    stencilRowScalar(up + i, mid + i, down + i, heater + i, out + i, n - i, c);
+}
+
+__attribute__((target("avx2")))
+static void stencilRowAVX2(const double *up, const double *mid, const double *down,
+                           const double *heater, double *out, int n, const StencilCoefficients &c){
+    const __m256d center = _mm256_set1_pd(c.center);
+    const __m256d cx = _mm256_set1_pd(c.x);
+    const __m256d cy = _mm256_set1_pd(c.y);
+    const __m256d cz = _mm256_set1_pd(c.z);
+    const __m256d outside = _mm256_set1_pd(c.outside);
+    const __m256d factor = _mm256_set1_pd(0.7);
+
+    int i = 0;
+    for (; i + 4 <= n; i += 4){
+        const __m256d T = _mm256_loadu_pd(mid + i);
+        __m256d result = _mm256_mul_pd(center, T);
+        result = _mm256_add_pd(result, _mm256_mul_pd(cx, _mm256_add_pd(_mm256_loadu_pd(mid + i - 1), _mm256_loadu_pd(mid + i + 1))));
+        result = _mm256_add_pd(result, _mm256_mul_pd(cy, _mm256_add_pd(_mm256_loadu_pd(up + i), _mm256_loadu_pd(down + i))));
+        const __m256d air = _mm256_min_pd(_mm256_mul_pd(T, factor), outside);
+        result = _mm256_add_pd(result, _mm256_mul_pd(cz, _mm256_add_pd(air, _mm256_loadu_pd(heater + i))));
+        _mm256_storeu_pd(out + i, result);
+    }
+    // the tail runs legacy SSE code, which is slow with the upper halves of the registers dirty
+    _mm256_zeroupper();
+    stencilRowSSE2(up + i, mid + i, down + i, heater + i, out + i, n - i, c);
+}
+
+__attribute__((target("avx512f")))
+static void stencilRowAVX512(const double *up, const double *mid, const double *down,
+                             const double *heater, double *out, int n, const StencilCoefficients &c){
+    const __m512d center = _mm512_set1_pd(c.center);
+    const __m512d cx = _mm512_set1_pd(c.x);
+    const __m512d cy = _mm512_set1_pd(c.y);
+    const __m512d cz = _mm512_set1_pd(c.z);
+    const __m512d outside = _mm512_set1_pd(c.outside);
+    const __m512d factor = _mm512_set1_pd(0.7);
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8){
+        const __m512d T = _mm512_loadu_pd(mid + i);
+        __m512d result = _mm512_mul_pd(center, T);
+        result = _mm512_add_pd(result, _mm512_mul_pd(cx, _mm512_add_pd(_mm512_loadu_pd(mid + i - 1), _mm512_loadu_pd(mid + i + 1))));
+        result = _mm512_add_pd(result, _mm512_mul_pd(cy, _mm512_add_pd(_mm512_loadu_pd(up + i), _mm512_loadu_pd(down + i))));
+        const __m512d air = _mm512_min_pd(_mm512_mul_pd(T, factor), outside);
+        result = _mm512_add_pd(result, _mm512_mul_pd(cz, _mm512_add_pd(air, _mm512_loadu_pd(heater + i))));
+        _mm512_storeu_pd(out + i, result);
+    }
+    // the tail with a mask instead of the narrower kernels
+    if (i < n){
+        const __mmask8 mask = static_cast<__mmask8>((1u << (n - i)) - 1);
+        const __m512d T = _mm512_maskz_loadu_pd(mask, mid + i);
+        __m512d result = _mm512_mul_pd(center, T);
+        result = _mm512_add_pd(result, _mm512_mul_pd(cx, _mm512_add_pd(_mm512_maskz_loadu_pd(mask, mid + i - 1),
+                                                                       _mm512_maskz_loadu_pd(mask, mid + i + 1))));
+        result = _mm512_add_pd(result, _mm512_mul_pd(cy, _mm512_add_pd(_mm512_maskz_loadu_pd(mask, up + i),
+                                                                       _mm512_maskz_loadu_pd(mask, down + i))));
+        const __m512d air = _mm512_min_pd(_mm512_mul_pd(T, factor), outside);
+        result = _mm512_add_pd(result, _mm512_mul_pd(cz, _mm512_add_pd(air, _mm512_maskz_loadu_pd(mask, heater + i))));
+        _mm512_mask_storeu_pd(out + i, mask, result);
+    }
+}
+__attribute__((target("sse2")))
+static void floatStencilRowSSE2(const float *up, const float *mid, const float *down,
+                                const float *heater, float *out, int n, const StencilCoefficients &c){
+    const __m128 center = _mm_set1_ps(static_cast<float>(c.center));
+    const __m128 cx = _mm_set1_ps(static_cast<float>(c.x));
+    const __m128 cy = _mm_set1_ps(static_cast<float>(c.y));
+    const __m128 cz = _mm_set1_ps(static_cast<float>(c.z));
+    const __m128 outside = _mm_set1_ps(static_cast<float>(c.outside));
+    const __m128 factor = _mm_set1_ps(0.7f);
+
+    int i = 0;
+    for (; i + 4 <= n; i += 4){
+        const __m128 T = _mm_loadu_ps(mid + i);
+        __m128 result = _mm_mul_ps(center, T);
+        result = _mm_add_ps(result, _mm_mul_ps(cx, _mm_add_ps(_mm_loadu_ps(mid + i - 1), _mm_loadu_ps(mid + i + 1))));
+        result = _mm_add_ps(result, _mm_mul_ps(cy, _mm_add_ps(_mm_loadu_ps(up + i), _mm_loadu_ps(down + i))));
+        const __m128 air = _mm_min_ps(_mm_mul_ps(T, factor), outside);
+        result = _mm_add_ps(result, _mm_mul_ps(cz, _mm_add_ps(air, _mm_loadu_ps(heater + i))));
+        _mm_storeu_ps(out + i, result);
+    }
+    floatStencilRowScalar(up + i, mid + i, down + i, heater + i, out + i, n - i, c);
+}
+
+__attribute__((target("avx2")))
+static void floatStencilRowAVX2(const float *up, const float *mid, const float *down,
+                                const float *heater, float *out, int n, const StencilCoefficients &c){
+    const __m256 center = _mm256_set1_ps(static_cast<float>(c.center));
+    const __m256 cx = _mm256_set1_ps(static_cast<float>(c.x));
+    const __m256 cy = _mm256_set1_ps(static_cast<float>(c.y));
+    const __m256 cz = _mm256_set1_ps(static_cast<float>(c.z));
+    const __m256 outside = _mm256_set1_ps(static_cast<float>(c.outside));
+    const __m256 factor = _mm256_set1_ps(0.7f);
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8){
+        const __m256 T = _mm256_loadu_ps(mid + i);
+        __m256 result = _mm256_mul_ps(center, T);
+        result = _mm256_add_ps(result, _mm256_mul_ps(cx, _mm256_add_ps(_mm256_loadu_ps(mid + i - 1), _mm256_loadu_ps(mid + i + 1))));
+        result = _mm256_add_ps(result, _mm256_mul_ps(cy, _mm256_add_ps(_mm256_loadu_ps(up + i), _mm256_loadu_ps(down + i))));
+        const __m256 air = _mm256_min_ps(_mm256_mul_ps(T, factor), outside);
+        result = _mm256_add_ps(result, _mm256_mul_ps(cz, _mm256_add_ps(air, _mm256_loadu_ps(heater + i))));
+        _mm256_storeu_ps(out + i, result);
+    }
+    _mm256_zeroupper();
+    floatStencilRowSSE2(up + i, mid + i, down + i, heater + i, out + i, n - i, c);
+}
+
+__attribute__((target("avx512f")))
+static void floatStencilRowAVX512(const float *up, const float *mid, const float *down,
+                                  const float *heater, float *out, int n, const StencilCoefficients &c){
+    const __m512 center = _mm512_set1_ps(static_cast<float>(c.center));
+    const __m512 cx = _mm512_set1_ps(static_cast<float>(c.x));
+    const __m512 cy = _mm512_set1_ps(static_cast<float>(c.y));
+    const __m512 cz = _mm512_set1_ps(static_cast<float>(c.z));
+    const __m512 outside = _mm512_set1_ps(static_cast<float>(c.outside));
+    const __m512 factor = _mm512_set1_ps(0.7f);
+
+    int i = 0;
+    for (; i + 16 <= n; i += 16){
+        const __m512 T = _mm512_loadu_ps(mid + i);
+        __m512 result = _mm512_mul_ps(center, T);
+        result = _mm512_add_ps(result, _mm512_mul_ps(cx, _mm512_add_ps(_mm512_loadu_ps(mid + i - 1), _mm512_loadu_ps(mid + i + 1))));
+        result = _mm512_add_ps(result, _mm512_mul_ps(cy, _mm512_add_ps(_mm512_loadu_ps(up + i), _mm512_loadu_ps(down + i))));
+        const __m512 air = _mm512_min_ps(_mm512_mul_ps(T, factor), outside);
+        result = _mm512_add_ps(result, _mm512_mul_ps(cz, _mm512_add_ps(air, _mm512_loadu_ps(heater + i))));
+        _mm512_storeu_ps(out + i, result);
+    }
+    if (i < n){
+        const __mmask16 mask = static_cast<__mmask16>((1u << (n - i)) - 1);
+        const __m512 T = _mm512_maskz_loadu_ps(mask, mid + i);
+        __m512 result = _mm512_mul_ps(center, T);
+        result = _mm512_add_ps(result, _mm512_mul_ps(cx, _mm512_add_ps(_mm512_maskz_loadu_ps(mask, mid + i - 1),
+                                                                       _mm512_maskz_loadu_ps(mask, mid + i + 1))));
+        result = _mm512_add_ps(result, _mm512_mul_ps(cy, _mm512_add_ps(_mm512_maskz_loadu_ps(mask, up + i),
+                                                                       _mm512_maskz_loadu_ps(mask, down + i))));
+        const __m512 air = _mm512_min_ps(_mm512_mul_ps(T, factor), outside);
+        result = _mm512_add_ps(result, _mm512_mul_ps(cz, _mm512_add_ps(air, _mm512_maskz_loadu_ps(mask, heater + i))));
+        _mm512_mask_storeu_ps(out + i, mask, result);
+    }
+}
+
+/* mixed: the floats are widened to double on load, calculated as in the double kernels
+ * and rounded to float on store */
+__attribute__((target("sse2")))
+static void mixedStencilRowSSE2(const float *up, const float *mid, const float *down,
+                                const double *heater, float *out, int n, const StencilCoefficients &c){
+    const __m128d center = _mm_set1_pd(c.center);
+    const __m128d cx = _mm_set1_pd(c.x);
+    const __m128d cy = _mm_set1_pd(c.y);
+    const __m128d cz = _mm_set1_pd(c.z);
+    const __m128d outside = _mm_set1_pd(c.outside);
+    const __m128d factor = _mm_set1_pd(0.7);
+    // two floats at a time
+    auto load = [](const float *p){ return _mm_cvtps_pd(_mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double *>(p)))); };
+
+    int i = 0;
+    for (; i + 2 <= n; i += 2){
+        const __m128d T = load(mid + i);
+        __m128d result = _mm_mul_pd(center, T);
+        result = _mm_add_pd(result, _mm_mul_pd(cx, _mm_add_pd(load(mid + i - 1), load(mid + i + 1))));
+        result = _mm_add_pd(result, _mm_mul_pd(cy, _mm_add_pd(load(up + i), load(down + i))));
+        const __m128d air = _mm_min_pd(_mm_mul_pd(T, factor), outside);
+        result = _mm_add_pd(result, _mm_mul_pd(cz, _mm_add_pd(air, _mm_loadu_pd(heater + i))));
+        _mm_store_sd(reinterpret_cast<double *>(out + i), _mm_castps_pd(_mm_cvtpd_ps(result)));
+    }
+    mixedStencilRowScalar(up + i, mid + i, down + i, heater + i, out + i, n - i, c);
+}
+
+__attribute__((target("avx2")))
+static void mixedStencilRowAVX2(const float *up, const float *mid, const float *down,
+                                const double *heater, float *out, int n, const StencilCoefficients &c){
+    const __m256d center = _mm256_set1_pd(c.center);
+    const __m256d cx = _mm256_set1_pd(c.x);
+    const __m256d cy = _mm256_set1_pd(c.y);
+    const __m256d cz = _mm256_set1_pd(c.z);
+    const __m256d outside = _mm256_set1_pd(c.outside);
+    const __m256d factor = _mm256_set1_pd(0.7);
+
+    int i = 0;
+    for (; i + 4 <= n; i += 4){
+        const __m256d T = _mm256_cvtps_pd(_mm_loadu_ps(mid + i));
+        __m256d result = _mm256_mul_pd(center, T);
+        result = _mm256_add_pd(result, _mm256_mul_pd(cx, _mm256_add_pd(_mm256_cvtps_pd(_mm_loadu_ps(mid + i - 1)),
+                                                                       _mm256_cvtps_pd(_mm_loadu_ps(mid + i + 1)))));
+        result = _mm256_add_pd(result, _mm256_mul_pd(cy, _mm256_add_pd(_mm256_cvtps_pd(_mm_loadu_ps(up + i)),
+                                                                       _mm256_cvtps_pd(_mm_loadu_ps(down + i)))));
+        const __m256d air = _mm256_min_pd(_mm256_mul_pd(T, factor), outside);
+        result = _mm256_add_pd(result, _mm256_mul_pd(cz, _mm256_add_pd(air, _mm256_loadu_pd(heater + i))));
+        _mm_storeu_ps(out + i, _mm256_cvtpd_ps(result));
+    }
+    _mm256_zeroupper();
+    mixedStencilRowSSE2(up + i, mid + i, down + i, heater + i, out + i, n - i, c);
+}
+
+__attribute__((target("avx512f")))
+static void mixedStencilRowAVX512(const float *up, const float *mid, const float *down,
+                                  const double *heater, float *out, int n, const StencilCoefficients &c){
+    const __m512d center = _mm512_set1_pd(c.center);
+    const __m512d cx = _mm512_set1_pd(c.x);
+    const __m512d cy = _mm512_set1_pd(c.y);
+    const __m512d cz = _mm512_set1_pd(c.z);
+    const __m512d outside = _mm512_set1_pd(c.outside);
+    const __m512d factor = _mm512_set1_pd(0.7);
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8){
+        const __m512d T = _mm512_cvtps_pd(_mm256_loadu_ps(mid + i));
+        __m512d result = _mm512_mul_pd(center, T);
+        result = _mm512_add_pd(result, _mm512_mul_pd(cx, _mm512_add_pd(_mm512_cvtps_pd(_mm256_loadu_ps(mid + i - 1)),
+                                                                       _mm512_cvtps_pd(_mm256_loadu_ps(mid + i + 1)))));
+        result = _mm512_add_pd(result, _mm512_mul_pd(cy, _mm512_add_pd(_mm512_cvtps_pd(_mm256_loadu_ps(up + i)),
+                                                                       _mm512_cvtps_pd(_mm256_loadu_ps(down + i)))));
+        const __m512d air = _mm512_min_pd(_mm512_mul_pd(T, factor), outside);
+        result = _mm512_add_pd(result, _mm512_mul_pd(cz, _mm512_add_pd(air, _mm512_loadu_pd(heater + i))));
+        _mm256_storeu_ps(out + i, _mm512_cvtpd_ps(result));
+    }
+    if (i < n){
+        // 8 floats of a 16 float register, AVX-512F has no masked 8 float load
+        const __mmask8 mask = static_cast<__mmask8>((1u << (n - i)) - 1);
+        auto load = [mask](const float *p){ return _mm512_cvtps_pd(_mm512_castps512_ps256(_mm512_maskz_loadu_ps(mask, p))); };
+        const __m512d T = load(mid + i);
+        __m512d result = _mm512_mul_pd(center, T);
+        result = _mm512_add_pd(result, _mm512_mul_pd(cx, _mm512_add_pd(load(mid + i - 1), load(mid + i + 1))));
+        result = _mm512_add_pd(result, _mm512_mul_pd(cy, _mm512_add_pd(load(up + i), load(down + i))));
+        const __m512d air = _mm512_min_pd(_mm512_mul_pd(T, factor), outside);
+        result = _mm512_add_pd(result, _mm512_mul_pd(cz, _mm512_add_pd(air, _mm512_maskz_loadu_pd(mask, heater + i))));
+        _mm512_mask_storeu_ps(out + i, mask, _mm512_castps256_ps512(_mm512_cvtpd_ps(result)));
+    }
+}
+__attribute__((target("sse2")))
+static void layeredStencilRowSSE2(const double *up, const double *mid, const double *down,
+                                  const double *below, const double *above, double *out, int n,
+                                  const StencilCoefficients &c){
+    const __m128d center = _mm_set1_pd(c.center);
+    const __m128d cx = _mm_set1_pd(c.x);
+    const __m128d cy = _mm_set1_pd(c.y);
+    const __m128d cz = _mm_set1_pd(c.z);
+
+    int i = 0;
+    for (; i + 2 <= n; i += 2){
+        __m128d result = _mm_mul_pd(center, _mm_loadu_pd(mid + i));
+        result = _mm_add_pd(result, _mm_mul_pd(cx, _mm_add_pd(_mm_loadu_pd(mid + i - 1), _mm_loadu_pd(mid + i + 1))));
+        result = _mm_add_pd(result, _mm_mul_pd(cy, _mm_add_pd(_mm_loadu_pd(up + i), _mm_loadu_pd(down + i))));
+        result = _mm_add_pd(result, _mm_mul_pd(cz, _mm_add_pd(_mm_loadu_pd(below + i), _mm_loadu_pd(above + i))));
+        _mm_storeu_pd(out + i, result);
+    }
+    layeredStencilRowScalar(up + i, mid + i, down + i, below + i, above + i, out + i, n - i, c);
+}
+
+__attribute__((target("avx2")))
+static void layeredStencilRowAVX2(const double *up, const double *mid, const double *down,
+                                  const double *below, const double *above, double *out, int n,
+                                  const StencilCoefficients &c){
+    const __m256d center = _mm256_set1_pd(c.center);
+    const __m256d cx = _mm256_set1_pd(c.x);
+    const __m256d cy = _mm256_set1_pd(c.y);
+    const __m256d cz = _mm256_set1_pd(c.z);
+
+    int i = 0;
+    for (; i + 4 <= n; i += 4){
+        __m256d result = _mm256_mul_pd(center, _mm256_loadu_pd(mid + i));
+        result = _mm256_add_pd(result, _mm256_mul_pd(cx, _mm256_add_pd(_mm256_loadu_pd(mid + i - 1), _mm256_loadu_pd(mid + i + 1))));
+        result = _mm256_add_pd(result, _mm256_mul_pd(cy, _mm256_add_pd(_mm256_loadu_pd(up + i), _mm256_loadu_pd(down + i))));
+        result = _mm256_add_pd(result, _mm256_mul_pd(cz, _mm256_add_pd(_mm256_loadu_pd(below + i), _mm256_loadu_pd(above + i))));
+        _mm256_storeu_pd(out + i, result);
+    }
+    _mm256_zeroupper();
+    layeredStencilRowSSE2(up + i, mid + i, down + i, below + i, above + i, out + i, n - i, c);
+}
+
+__attribute__((target("avx512f")))
+static void layeredStencilRowAVX512(const double *up, const double *mid, const double *down,
+                                    const double *below, const double *above, double *out, int n,
+                                    const StencilCoefficients &c){
+    const __m512d center = _mm512_set1_pd(c.center);
+    const __m512d cx = _mm512_set1_pd(c.x);
+    const __m512d cy = _mm512_set1_pd(c.y);
+    const __m512d cz = _mm512_set1_pd(c.z);
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8){
+        __m512d result = _mm512_mul_pd(center, _mm512_loadu_pd(mid + i));
+        result = _mm512_add_pd(result, _mm512_mul_pd(cx, _mm512_add_pd(_mm512_loadu_pd(mid + i - 1), _mm512_loadu_pd(mid + i + 1))));
+        result = _mm512_add_pd(result, _mm512_mul_pd(cy, _mm512_add_pd(_mm512_loadu_pd(up + i), _mm512_loadu_pd(down + i))));
+        result = _mm512_add_pd(result, _mm512_mul_pd(cz, _mm512_add_pd(_mm512_loadu_pd(below + i), _mm512_loadu_pd(above + i))));
+        _mm512_storeu_pd(out + i, result);
+    }
+    if (i < n){
+        const __mmask8 mask = static_cast<__mmask8>((1u << (n - i)) - 1);
+        __m512d result = _mm512_mul_pd(center, _mm512_maskz_loadu_pd(mask, mid + i));
+        result = _mm512_add_pd(result, _mm512_mul_pd(cx, _mm512_add_pd(_mm512_maskz_loadu_pd(mask, mid + i - 1),
+                                                                       _mm512_maskz_loadu_pd(mask, mid + i + 1))));
+        result = _mm512_add_pd(result, _mm512_mul_pd(cy, _mm512_add_pd(_mm512_maskz_loadu_pd(mask, up + i),
+                                                                       _mm512_maskz_loadu_pd(mask, down + i))));
+        result = _mm512_add_pd(result, _mm512_mul_pd(cz, _mm512_add_pd(_mm512_maskz_loadu_pd(mask, below + i),
+                                                                       _mm512_maskz_loadu_pd(mask, above + i))));
+        _mm512_mask_storeu_pd(out + i, mask, result);
+    }
+}
+__attribute__((target("sse2")))
+static void layerSweepRowSSE2(const double *neighbour, double *out, int n, double coupling, double scale){
+    const __m128d c = _mm_set1_pd(coupling);
+    const __m128d s = _mm_set1_pd(scale);
+    int i = 0;
+    for (; i + 2 <= n; i += 2){
+        const __m128d sum = _mm_add_pd(_mm_loadu_pd(out + i), _mm_mul_pd(c, _mm_loadu_pd(neighbour + i)));
+        _mm_storeu_pd(out + i, _mm_mul_pd(sum, s));
+    }
+    layerSweepRowScalar(neighbour + i, out + i, n - i, coupling, scale);
+}
+
+__attribute__((target("avx2")))
+static void layerSweepRowAVX2(const double *neighbour, double *out, int n, double coupling, double scale){
+    const __m256d c = _mm256_set1_pd(coupling);
+    const __m256d s = _mm256_set1_pd(scale);
+    int i = 0;
+    for (; i + 4 <= n; i += 4){
+        const __m256d sum = _mm256_add_pd(_mm256_loadu_pd(out + i), _mm256_mul_pd(c, _mm256_loadu_pd(neighbour + i)));
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(sum, s));
+    }
+    _mm256_zeroupper();
+    layerSweepRowSSE2(neighbour + i, out + i, n - i, coupling, scale);
+}
+
+__attribute__((target("avx512f")))
+static void layerSweepRowAVX512(const double *neighbour, double *out, int n, double coupling, double scale){
+    const __m512d c = _mm512_set1_pd(coupling);
+    const __m512d s = _mm512_set1_pd(scale);
+    int i = 0;
+    for (; i + 8 <= n; i += 8){
+        const __m512d sum = _mm512_add_pd(_mm512_loadu_pd(out + i), _mm512_mul_pd(c, _mm512_loadu_pd(neighbour + i)));
+        _mm512_storeu_pd(out + i, _mm512_mul_pd(sum, s));
+    }
+    if (i < n){
+        const __mmask8 mask = static_cast<__mmask8>((1u << (n - i)) - 1);
+        const __m512d sum = _mm512_add_pd(_mm512_maskz_loadu_pd(mask, out + i),
+                                          _mm512_mul_pd(c, _mm512_maskz_loadu_pd(mask, neighbour + i)));
+        _mm512_mask_storeu_pd(out + i, mask, _mm512_mul_pd(sum, s));
+    }
+}
+
+__attribute__((target("sse2")))
+static void monitoredStencilRowSSE2(const double *up, const double *mid, const double *down,
+                                    const double *heater, double *out, int n, const StencilCoefficients &c,
+                                    StencilRowStats &stats){
+    const __m128d center = _mm_set1_pd(c.center);
+    const __m128d cx = _mm_set1_pd(c.x);
+    const __m128d cy = _mm_set1_pd(c.y);
+    const __m128d cz = _mm_set1_pd(c.z);
+    const __m128d outside = _mm_set1_pd(c.outside);
+    const __m128d factor = _mm_set1_pd(0.7);
+    const __m128d sign = _mm_set1_pd(-0.);
+    __m128d maxChange = _mm_setzero_pd();
+    __m128d sum = _mm_setzero_pd();
+
+    int i = 0;
+    for (; i + 2 <= n; i += 2){
+        const __m128d T = _mm_loadu_pd(mid + i);
+        __m128d result = _mm_mul_pd(center, T);
+        result = _mm_add_pd(result, _mm_mul_pd(cx, _mm_add_pd(_mm_loadu_pd(mid + i - 1), _mm_loadu_pd(mid + i + 1))));
+        result = _mm_add_pd(result, _mm_mul_pd(cy, _mm_add_pd(_mm_loadu_pd(up + i), _mm_loadu_pd(down + i))));
+        const __m128d air = _mm_min_pd(_mm_mul_pd(T, factor), outside);
+        result = _mm_add_pd(result, _mm_mul_pd(cz, _mm_add_pd(air, _mm_loadu_pd(heater + i))));
+        _mm_storeu_pd(out + i, result);
+        maxChange = _mm_max_pd(maxChange, _mm_andnot_pd(sign, _mm_sub_pd(result, T)));
+        sum = _mm_add_pd(sum, result);
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, maxChange);
+    stats.maxChange = std::max({stats.maxChange, lanes[0], lanes[1]});
+    _mm_storeu_pd(lanes, sum);
+    stats.sum += lanes[0] + lanes[1];
+    monitoredStencilRowScalar(up + i, mid + i, down + i, heater + i, out + i, n - i, c, stats);
+}
+
+__attribute__((target("avx2")))
+static void monitoredStencilRowAVX2(const double *up, const double *mid, const double *down,
+                                    const double *heater, double *out, int n, const StencilCoefficients &c,
+                                    StencilRowStats &stats){
+    const __m256d center = _mm256_set1_pd(c.center);
+    const __m256d cx = _mm256_set1_pd(c.x);
+    const __m256d cy = _mm256_set1_pd(c.y);
+    const __m256d cz = _mm256_set1_pd(c.z);
+    const __m256d outside = _mm256_set1_pd(c.outside);
+    const __m256d factor = _mm256_set1_pd(0.7);
+    const __m256d sign = _mm256_set1_pd(-0.);
+    __m256d maxChange = _mm256_setzero_pd();
+    __m256d sum = _mm256_setzero_pd();
+
+    int i = 0;
+    for (; i + 4 <= n; i += 4){
+        const __m256d T = _mm256_loadu_pd(mid + i);
+        __m256d result = _mm256_mul_pd(center, T);
+        result = _mm256_add_pd(result, _mm256_mul_pd(cx, _mm256_add_pd(_mm256_loadu_pd(mid + i - 1), _mm256_loadu_pd(mid + i + 1))));
+        result = _mm256_add_pd(result, _mm256_mul_pd(cy, _mm256_add_pd(_mm256_loadu_pd(up + i), _mm256_loadu_pd(down + i))));
+        const __m256d air = _mm256_min_pd(_mm256_mul_pd(T, factor), outside);
+        result = _mm256_add_pd(result, _mm256_mul_pd(cz, _mm256_add_pd(air, _mm256_loadu_pd(heater + i))));
+        _mm256_storeu_pd(out + i, result);
+        maxChange = _mm256_max_pd(maxChange, _mm256_andnot_pd(sign, _mm256_sub_pd(result, T)));
+        sum = _mm256_add_pd(sum, result);
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, maxChange);
+    stats.maxChange = std::max({stats.maxChange, lanes[0], lanes[1], lanes[2], lanes[3]});
+    _mm256_storeu_pd(lanes, sum);
+    stats.sum += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    // the tail runs legacy SSE code
+    _mm256_zeroupper();
+    monitoredStencilRowSSE2(up + i, mid + i, down + i, heater + i, out + i, n - i, c, stats);
+}
+
+__attribute__((target("avx512f")))
+static void monitoredStencilRowAVX512(const double *up, const double *mid, const double *down,
+                                      const double *heater, double *out, int n, const StencilCoefficients &c,
+                                      StencilRowStats &stats){
+    const __m512d center = _mm512_set1_pd(c.center);
+    const __m512d cx = _mm512_set1_pd(c.x);
+    const __m512d cy = _mm512_set1_pd(c.y);
+    const __m512d cz = _mm512_set1_pd(c.z);
+    const __m512d outside = _mm512_set1_pd(c.outside);
+    const __m512d factor = _mm512_set1_pd(0.7);
+    __m512d maxChange = _mm512_setzero_pd();
+    __m512d sum = _mm512_setzero_pd();
+
+    // the tail is the last pass of the loop with a mask, the masked lanes gather nothing
+    for (int i = 0; i < n; i += 8){
+        const __mmask8 mask = (n - i >= 8) ? static_cast<__mmask8>(0xff) : static_cast<__mmask8>((1u << (n - i)) - 1);
+        const __m512d T = _mm512_maskz_loadu_pd(mask, mid + i);
+        __m512d result = _mm512_mul_pd(center, T);
+        result = _mm512_add_pd(result, _mm512_mul_pd(cx, _mm512_add_pd(_mm512_maskz_loadu_pd(mask, mid + i - 1),
+                                                                       _mm512_maskz_loadu_pd(mask, mid + i + 1))));
+        result = _mm512_add_pd(result, _mm512_mul_pd(cy, _mm512_add_pd(_mm512_maskz_loadu_pd(mask, up + i),
+                                                                       _mm512_maskz_loadu_pd(mask, down + i))));
+        const __m512d air = _mm512_min_pd(_mm512_mul_pd(T, factor), outside);
+        result = _mm512_add_pd(result, _mm512_mul_pd(cz, _mm512_add_pd(air, _mm512_maskz_loadu_pd(mask, heater + i))));
+        _mm512_mask_storeu_pd(out + i, mask, result);
+        maxChange = _mm512_mask_max_pd(maxChange, mask, maxChange, _mm512_abs_pd(_mm512_sub_pd(result, T)));
+        sum = _mm512_mask_add_pd(sum, mask, sum, result);
+    }
+    stats.maxChange = std::max(stats.maxChange, _mm512_reduce_max_pd(maxChange));
+    stats.sum += _mm512_reduce_add_pd(sum);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif // STENCIL_X86_KERNELS
+
+KernelIsa detectKernelIsa(){
+#ifdef STENCIL_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return KernelIsa::AVX512;
+    if (__builtin_cpu_supports("avx2")) return KernelIsa::AVX2;
+    if (__builtin_cpu_supports("sse2")) return KernelIsa::SSE2;
+#endif
+    return KernelIsa::Scalar;
+}
+
+bool isKernelIsaSupported(KernelIsa isa){
+    return static_cast<int>(isa) <= static_cast<int>(detectKernelIsa());
+}
+
+StencilRowKernel stencilRowKernel(KernelIsa isa){
+    // falls back to the best supported kernel if isa is not available
+    if (!isKernelIsaSupported(isa)) isa = detectKernelIsa();
+    switch (isa){
+#ifdef STENCIL_X86_KERNELS
+    case KernelIsa::AVX512: return stencilRowAVX512;
+    case KernelIsa::AVX2: return stencilRowAVX2;
+    case KernelIsa::SSE2: return stencilRowSSE2;
+#endif
+    default: return stencilRowScalar;
+    }
+}
+
+FloatStencilRowKernel floatStencilRowKernel(KernelIsa isa){
+    if (!isKernelIsaSupported(isa)) isa = detectKernelIsa();
+    switch (isa){
+#ifdef STENCIL_X86_KERNELS
+    case KernelIsa::AVX512: return floatStencilRowAVX512;
+    case KernelIsa::AVX2: return floatStencilRowAVX2;
+    case KernelIsa::SSE2: return floatStencilRowSSE2;
+#endif
+    default: return floatStencilRowScalar;
+    }
+}
+
+MixedStencilRowKernel mixedStencilRowKernel(KernelIsa isa){
+    if (!isKernelIsaSupported(isa)) isa = detectKernelIsa();
+    switch (isa){
+#ifdef STENCIL_X86_KERNELS
+    case KernelIsa::AVX512: return mixedStencilRowAVX512;
+    case KernelIsa::AVX2: return mixedStencilRowAVX2;
+    case KernelIsa::SSE2: return mixedStencilRowSSE2;
+#endif
+    default: return mixedStencilRowScalar;
+    }
+}
+
+LayeredStencilRowKernel layeredStencilRowKernel(KernelIsa isa){
+    if (!isKernelIsaSupported(isa)) isa = detectKernelIsa();
+    switch (isa){
+#ifdef STENCIL_X86_KERNELS
+    case KernelIsa::AVX512: return layeredStencilRowAVX512;
+    case KernelIsa::AVX2: return layeredStencilRowAVX2;
+    case KernelIsa::SSE2: return layeredStencilRowSSE2;
+#endif
+    default: return layeredStencilRowScalar;
+    }
+}
+
+LayerSweepRowKernel layerSweepRowKernel(KernelIsa isa){
+    if (!isKernelIsaSupported(isa)) isa = detectKernelIsa();
+    switch (isa){
+#ifdef STENCIL_X86_KERNELS
+    case KernelIsa::AVX512: return layerSweepRowAVX512;
+    case KernelIsa::AVX2: return layerSweepRowAVX2;
+    case KernelIsa::SSE2: return layerSweepRowSSE2;
+#endif
+    default: return layerSweepRowScalar;
+    }
+}
+
+MonitoredStencilRowKernel monitoredStencilRowKernel(KernelIsa isa){
+    if (!isKernelIsaSupported(isa)) isa = detectKernelIsa();
+    switch (isa){
+#ifdef STENCIL_X86_KERNELS
+    case KernelIsa::AVX512: return monitoredStencilRowAVX512;
+    case KernelIsa::AVX2: return monitoredStencilRowAVX2;
+    case KernelIsa::SSE2: return monitoredStencilRowSSE2;
+#endif
+    default: return monitoredStencilRowScalar;
+    }
+}
+
+const char *kernelIsaName(KernelIsa isa){
+    switch (isa){
+    case KernelIsa::AVX512: return "avx512";
+    case KernelIsa::AVX2: return "avx2";
+    case KernelIsa::SSE2: return "sse2";
+    default: return "scalar";
+    }
+}
+
+bool kernelIsaFromName(const char *name, KernelIsa *isa){
+    for (KernelIsa candidate : {KernelIsa::Scalar, KernelIsa::SSE2, KernelIsa::AVX2, KernelIsa::AVX512}){
+        if (std::strcmp(name, kernelIsaName(candidate)) == 0){
+            *isa = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *precisionName(Precision precision){
+    switch (precision){
+    case Precision::Float: return "float";
+    case Precision::Mixed: return "mixed";
+    default: return "double";
+    }
+}
+
+bool precisionFromName(const char *name, Precision *precision){
+    for (Precision candidate : {Precision::Double, Precision::Float, Precision::Mixed}){
+        if (std::strcmp(name, precisionName(candidate)) == 0){
+            *precision = candidate;
+            return true;
+        }
+    }
+    return false;
+}
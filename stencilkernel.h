@@ -0,0 +1,89 @@
+#ifndef STENCILKERNEL_H
+#define STENCILKERNEL_H
+
+/* Row kernels of the explicit 5 point stencil of the stove top.
+ *   out = T*center + x*(E + W) + y*(N + S) + z*(min(outside, 0.7*T) + heater)
+ * which is the x, y and z second derivatives of HeatSolver multiplied out,
+ * with the divisions by the steps done once per step instead of once per cell.
+ * The scalar kernel is the reference, the SSE2, AVX2 and AVX-512 ones are
+ * compiled with function target attributes and picked at startup by CPUID.
+ * The float and mixed precision kernels follow the same order of operations,
+ * so every instruction set gives the same result as their scalar reference. */
+
+enum class KernelIsa { Scalar, SSE2, AVX2, AVX512 };
+
+/* storage and arithmetic of the plate: Double - both in double, Float - both in float,
+ * Mixed - the plate is stored in float, the heater in double and a point is calculated
+ * in double and rounded once when it is stored */
+enum class Precision { Double, Float, Mixed };
+
+struct StencilCoefficients{
+    double center = 1.;     // 1 - 2*(x + y + z)
+    double x = 0;           // alpha*timeStep/xStep^2
+    double y = 0;           // alpha*timeStep/yStep^2
+    double z = 0;           // alpha*timeStep/zStep^2
+    double outside = 20.;   // air temperature over the top
+};
+
+// n cells of a row; up, mid and down are the previous state rows, heater the heater row
+using StencilRowKernel = void (*)(const double *up, const double *mid, const double *down,
+                                  const double *heater, double *out, int n, const StencilCoefficients &c);
+
+using FloatStencilRowKernel = void (*)(const float *up, const float *mid, const float *down,
+                                       const float *heater, float *out, int n, const StencilCoefficients &c);
+
+using MixedStencilRowKernel = void (*)(const float *up, const float *mid, const float *down,
+                                       const double *heater, float *out, int n, const StencilCoefficients &c);
+
+// what the monitored kernel gathers over the points of a step, see MonitoredStencilRowKernel
+struct StencilRowStats{
+    double maxChange = 0;   // the largest |out - mid|, deg C per step
+    double sum = 0;         // sum of out
+};
+
+/* the explicit kernel with the reductions of a convergence monitor done in the same sweep:
+ * out is the same as the one of StencilRowKernel, stats gathers the change and the sum of
+ * the row (the sum of the vector kernels is added up in another order, it can differ in
+ * the last bits from the scalar one) */
+using MonitoredStencilRowKernel = void (*)(const double *up, const double *mid, const double *down,
+                                           const double *heater, double *out, int n, const StencilCoefficients &c,
+                                           StencilRowStats &stats);
+
+/* a row of a layer of the layered plate, the 7 point stencil:
+ *   out = T*center + x*(E + W) + y*(N + S) + z*(below + above)
+ * below is the heater under the lowest layer, above a row standing for the air over the top one */
+using LayeredStencilRowKernel = void (*)(const double *up, const double *mid, const double *down,
+                                         const double *below, const double *above, double *out, int n,
+                                         const StencilCoefficients &c);
+
+/* a step of the implicit z solve of the layered plate (HeatSolver::fillLayerSweep), for a
+ * row of columns at once: out = (out + coupling*neighbour) * scale; the forward elimination
+ * (neighbour - the layer below, scale - its pivot) and the back substitution (the layer
+ * above, scale 1) */
+using LayerSweepRowKernel = void (*)(const double *neighbour, double *out, int n, double coupling, double scale);
+
+KernelIsa detectKernelIsa();
+
+bool isKernelIsaSupported(KernelIsa isa);
+
+StencilRowKernel stencilRowKernel(KernelIsa isa);
+
+FloatStencilRowKernel floatStencilRowKernel(KernelIsa isa);
+
+MixedStencilRowKernel mixedStencilRowKernel(KernelIsa isa);
+
+LayeredStencilRowKernel layeredStencilRowKernel(KernelIsa isa);
+
+LayerSweepRowKernel layerSweepRowKernel(KernelIsa isa);
+
+MonitoredStencilRowKernel monitoredStencilRowKernel(KernelIsa isa);
+
+const char *kernelIsaName(KernelIsa isa);
+
+bool kernelIsaFromName(const char *name, KernelIsa *isa);
+
+const char *precisionName(Precision precision);
+
+bool precisionFromName(const char *name, Precision *precision);
+
+#endif // STENCILKERNEL_H
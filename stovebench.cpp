@@ -0,0 +1,250 @@
+/* Microbenchmarks of the simulation pipeline, every piece timed on its own over
+ * plate sizes and thread counts:
+ *   heater  - the heater pass over the burner points (HeatSolver::calcHeaterRows)
+ *   stencil - the stencil kernel alone over the whole plate
+ *   copy    - the copy of the plate into a frame for the UI (SimulationFrame::copyFrom),
+ *             the one copy of the plate left in the pipeline, single threaded
+ *   step    - full explicit steps of the solver (heater and stencil in one sweep)
+ *   paint   - the frame painted into 32 bit pixels through the colour table (TemperaturePainter)
+ * Reports ns per cell, the memory traffic in GB/s (counted from the bytes a cell has
+ * to read and write, cache hits included) and the scaling efficiency against one
+ * thread; --json writes the same results, to be compared between builds. */
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+
+// C++ libs
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "heatsolver.h"
+#include "plategrid.h"
+#include "simulationthread.h"
+#include "temperaturepainter.h"
+#include "workerpool.h"
+
+struct BenchResult{
+    QString piece;
+    int size = 0;
+    int threads = 1;
+    double nsPerCell = 0;
+    double gbPerSecond = 0;
+    double efficiency = 1;      // time of one thread / (threads * time)
+};
+
+template <typename Job>
+static double secondsPerCall(Job job, double minSeconds){
+    // one call to warm the caches and fault the pages in, then as many as fit in minSeconds
+    job();
+    QElapsedTimer timer;
+    timer.start();
+    long long calls = 0;
+    do {
+        job();
+        ++calls;
+    } while (timer.nsecsElapsed() < minSeconds * 1e9);
+    return timer.nsecsElapsed() / 1e9 / calls;
+}
+
+static void setupSolver(HeatSolver &solver, int size, int threads, KernelIsa isa){
+    solver.resize(size, size);
+    solver.setKernelIsa(isa);
+    solver.setNumberOfThreads(threads);
+    solver.setAlpha(23.);
+    solver.setBurnerDisc(size/2, size/2, size/2, true);
+    solver.countBurnerPixels();
+    solver.setWatts(5000);
+    solver.setBurner(true);
+}
+
+static BenchResult measure(const QString &piece, int size, int threads, double cells, double bytesPerCell, double seconds){
+    BenchResult result;
+    result.piece = piece;
+    result.size = size;
+    result.threads = threads;
+    result.nsPerCell = seconds / cells * 1e9;
+    result.gbPerSecond = cells * bytesPerCell / seconds / 1e9;
+    return result;
+}
+
+static QVector<BenchResult> benchSize(int size, int threads, KernelIsa isa, double minSeconds, bool withCopy){
+    QVector<BenchResult> results;
+    HeatSolver solver;
+    setupSolver(solver, size, threads, isa);
+    const double cells = static_cast<double>(size) * size;
+    const double interior = static_cast<double>(size-2) * (size-2);
+
+    // heater: read and write a double and read the index of every burner point
+    const double burnerCells = solver.getNumberOfBurnerPixels();
+    results.push_back(measure("heater", size, threads, burnerCells, 8+8+4,
+                              secondsPerCall([&solver](){ solver.calcHeaterRows(); }, minSeconds)));
+
+    // stencil: read the plate and the heater, write the plate
+    {
+        PlateGrid<double> previous, current, heater;
+        previous.resize(size, size, HeatSolver::outsideTemperature);
+        current.resize(size, size, HeatSolver::outsideTemperature);
+        heater.resize(size, size, HeatSolver::outsideTemperature);
+        const StencilRowKernel stencilRow = stencilRowKernel(isa);
+        StencilCoefficients c;
+        c.x = c.y = 0.2;
+        c.z = 0.01;
+        c.center = 1. - 2*(c.x + c.y + c.z);
+        std::unique_ptr<WorkerPool> pool;
+        if (threads > 1) pool = std::make_unique<WorkerPool>(threads);
+        const int stride = previous.stride();
+        auto job = [&, stride](int worker){
+            const int yMin = 1 + static_cast<int>(static_cast<long long>(size-2) * worker / threads);
+            const int yMax = 1 + static_cast<int>(static_cast<long long>(size-2) * (worker+1) / threads);
+            for (int y = yMin; y < yMax; ++y){
+                const double *mid = previous.row(y) + 1;
+                stencilRow(mid - stride, mid, mid + stride, heater.row(y) + 1, current.row(y) + 1, size-2, c);
+            }
+        };
+        results.push_back(measure("stencil", size, threads, interior, 3*8, secondsPerCall([&](){
+            if (pool) pool->run(job);
+            else job(0);
+        }, minSeconds)));
+    }
+
+    // step: the stencil traffic, the heater pass is in the same sweep; several steps per call for the barriers
+    const int stepsPerCall = 8;
+    results.push_back(measure("step", size, threads, cells * stepsPerCall, 3*8,
+                              secondsPerCall([&solver, stepsPerCall](){ solver.calcHeatingSteps(stepsPerCall); }, minSeconds)));
+
+    SimulationFrame frame;
+    // copy: read and write a double, single threaded like the simulation thread, so measured once per size
+    if (withCopy){
+        results.push_back(measure("copy", size, 1, cells, 8+8,
+                                  secondsPerCall([&solver, &frame](){ frame.copyFrom(solver); }, minSeconds)));
+    }
+
+    // paint: read a double, read (compare) and write a pixel, in bands of tile rows as DrawArea does
+    {
+        frame.copyFrom(solver);
+        const TemperaturePainter painter;
+        std::vector<QRgb> pixels(static_cast<size_t>(size) * size, 0);
+        std::vector<char> dirtyTiles(static_cast<size_t>(frame.tileCountX) * frame.tileCountY, 0);
+        const QRgb ambientColor = painter.temperatureColor(frame.ambientTemperature);
+        std::unique_ptr<WorkerPool> pool;
+        if (threads > 1) pool = std::make_unique<WorkerPool>(threads);
+        auto job = [&](int worker){
+            const int bands = std::min(threads, frame.tileCountY);
+            if (worker >= bands) return;
+            painter.paintTileRows(frame, reinterpret_cast<uchar *>(pixels.data()), size, size,
+                                  size * static_cast<int>(sizeof(QRgb)), frame.tileCountY * worker / bands,
+                                  frame.tileCountY * (worker+1) / bands, ambientColor, false, dirtyTiles.data());
+        };
+        results.push_back(measure("paint", size, threads, cells, 8+4+4, secondsPerCall([&](){
+            if (pool) pool->run(job);
+            else job(0);
+        }, minSeconds)));
+    }
+    return results;
+}
+
+static QVector<int> parseList(const QString &value){
+    QVector<int> list;
+    for (const QString &item : value.split(',', Qt::SkipEmptyParts)) list.push_back(item.trimmed().toInt());
+    return list;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("stovebench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Microbenchmarks of the stove top simulation pipeline.");
+    parser.addHelpOption();
+    QCommandLineOption sizesOption("sizes", "Plate sizes, comma separated (default 256,512,1024,2048).", "n,...");
+    QCommandLineOption threadsOption("threads", "Thread counts, comma separated (default 1, 2, 4... up to all cores).", "n,...");
+    QCommandLineOption kernelOption("kernel", "Stencil kernel: scalar, sse2, avx2 or avx512 (default the best the CPU supports).", "isa");
+    QCommandLineOption minTimeOption("min-time", "Seconds every measurement runs for (default 0.2).", "s");
+    QCommandLineOption jsonOption("json", "Write the results as JSON to a file, - for stdout.", "file");
+    parser.addOption(sizesOption);
+    parser.addOption(threadsOption);
+    parser.addOption(kernelOption);
+    parser.addOption(minTimeOption);
+    parser.addOption(jsonOption);
+    parser.process(a);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    const QVector<int> sizes = parser.isSet(sizesOption) ? parseList(parser.value(sizesOption))
+                                                         : QVector<int>{256, 512, 1024, 2048};
+    QVector<int> threadCounts;
+    if (parser.isSet(threadsOption)) threadCounts = parseList(parser.value(threadsOption));
+    else {
+        const int cores = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        for (int threads = 1; threads < cores; threads *= 2) threadCounts.push_back(threads);
+        threadCounts.push_back(cores);
+    }
+    if (sizes.isEmpty() || threadCounts.isEmpty() || *std::min_element(sizes.begin(), sizes.end()) < 3
+            || *std::min_element(threadCounts.begin(), threadCounts.end()) < 1){
+        err << "Sizes must be at least 3 and thread counts at least 1." << Qt::endl;
+        return 1;
+    }
+    KernelIsa isa = detectKernelIsa();
+    if (parser.isSet(kernelOption) && !kernelIsaFromName(parser.value(kernelOption).toLatin1().constData(), &isa)){
+        err << "Unknown kernel " << parser.value(kernelOption) << Qt::endl;
+        return 1;
+    }
+    const double minSeconds = parser.isSet(minTimeOption) ? parser.value(minTimeOption).toDouble() : 0.2;
+    // with the JSON on stdout the table goes to stderr
+    const bool jsonToStdout = parser.value(jsonOption) == "-";
+    QTextStream &table = jsonToStdout ? err : out;
+
+    table << kernelIsaName(isa) << " kernel" << Qt::endl
+          << "piece      size  threads    ns/cell      GB/s  efficiency" << Qt::endl;
+    QVector<BenchResult> results;
+    for (int size : sizes){
+        QHash<QString, double> oneThread;    // ns/cell of every piece with one thread
+        for (int threads : threadCounts){
+            QVector<BenchResult> sizeResults = benchSize(size, threads, isa, minSeconds, threads == threadCounts.first());
+            for (BenchResult &result : sizeResults){
+                if (result.threads == 1) oneThread.insert(result.piece, result.nsPerCell);
+                // against the same piece with one thread, 0 if it was not measured
+                result.efficiency = oneThread.contains(result.piece)
+                        ? oneThread.value(result.piece) / (result.threads * result.nsPerCell) : 0.;
+                table << result.piece.leftJustified(8) << qSetFieldWidth(6) << result.size
+                      << qSetFieldWidth(9) << result.threads
+                      << qSetFieldWidth(11) << QString::number(result.nsPerCell, 'f', 3)
+                      << qSetFieldWidth(10) << QString::number(result.gbPerSecond, 'f', 2)
+                      << qSetFieldWidth(12) << QString::number(result.efficiency, 'f', 2)
+                      << qSetFieldWidth(0) << Qt::endl;
+                results.push_back(result);
+            }
+        }
+    }
+
+    if (parser.isSet(jsonOption)){
+        QJsonArray array;
+        for (const BenchResult &result : results){
+            array.append(QJsonObject{{"piece", result.piece}, {"size", result.size}, {"threads", result.threads},
+                                     {"nsPerCell", result.nsPerCell}, {"gbPerSecond", result.gbPerSecond},
+                                     {"efficiency", result.efficiency}});
+        }
+        const QJsonObject root{{"kernel", kernelIsaName(isa)}, {"minTime", minSeconds}, {"results", array}};
+        const QByteArray json = QJsonDocument(root).toJson();
+        if (jsonToStdout) out << json;
+        else {
+            QFile file(parser.value(jsonOption));
+            if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)){
+                err << "Can not write " << file.fileName() << Qt::endl;
+                return 1;
+            }
+            file.write(json);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,669 @@
+/* Headless batch runner of the stove top simulation.
+ * Runs a scenario file (see scenario.h) as fast as possible,
+ * without GUI and without timer throttling, and reports steps per second.
+ * With --bench the scenario is ran with 1..N threads, comparing the worker pool
+ * of HeatSolver with a copy of the baseline parallel step (BaselineStepper); with --validate
+ * the result of the chosen kernel, precision, threads and temporal blocking is
+ * compared to the scalar double reference stepped one step at a time (max and
+ * RMS deviation, to weigh the float and mixed precisions against their speed); --memory reports what
+ * the solver holds in memory after the run; --profile reports the time of every phase of the run
+ * and --trace writes them as a Chrome trace, for chrome://tracing or ui.perfetto.dev.
+ * --restore resumes a run from a checkpoint, --checkpoint writes one after the run and,
+ * with --checkpoint-every, in the background while it runs. --sweep runs every combination of
+ * the [sweep] section (see parametersweep.h) on all the cores and prints what each one reached.
+ * --steady stop ends the run once the plate is steady, --steady solve jumps to its equilibrium
+ * once only the slow decay is left (see steadystate.h). */
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+
+// Qt multithreading
+#include <QtConcurrent>
+
+// C++ libs
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <thread>
+
+#include "checkpoint.h"
+#include "heatsolver.h"
+#include "parametersweep.h"
+#include "profiler.h"
+#include "scenario.h"
+#include "steadystate.h"
+
+/* the parallel step of the GUI before the worker pool, kept as the benchmark reference as it
+ * was: the plate in columns of vectors, a QtConcurrent task per thread on every step that
+ * checks its promise at every point of the heater pass, then the stencil pass; the vector of
+ * futures is presized and then appended to (twice its size, half of it default futures), and
+ * the new state is copied back after every step. The columns left over by the split are not
+ * stepped, as then; only the cost is measured (the z term is the one of the single threaded
+ * step, the same work) */
+class BaselineStepper{
+public:
+    explicit BaselineStepper(const HeatSolver &solver)
+        : temperatureMapSizeX(solver.sizeX()), temperatureMapSizeY(solver.sizeY()),
+          alpha(solver.getAlpha()), timeStep(solver.getTimeStep()), burnerOn(solver.isBurnerOn()){
+        temperatureMapL0.assign(temperatureMapSizeX, std::vector<double>(temperatureMapSizeY));
+        temperatureMapL2 = temperatureMapL0;
+        burnerMap.assign(temperatureMapSizeX, std::vector<bool>(temperatureMapSizeY, false));
+        for (int x = 0; x < temperatureMapSizeX; ++x){
+            for (int y = 0; y < temperatureMapSizeY; ++y){
+                temperatureMapL0[x][y] = solver.heaterTemperature(x, y);
+                temperatureMapL2[x][y] = solver.temperature(x, y);
+                burnerMap[x][y] = solver.isBurnerCell(x, y);
+                if (burnerMap[x][y]) power = solver.getDeltaT(x, y);
+            }
+        }
+        temperatureMapL3 = temperatureMapL2;
+    }
+
+    void calcHeatingStep(int numberOfThreads){
+        calcHeatingStepParallel(numberOfThreads);
+        for (int x = 0; x < temperatureMapSizeX; ++x){
+            for(int y = 0; y < temperatureMapSizeY; ++y){
+                temperatureMapL2[x][y] = temperatureMapL3[x][y];
+            }
+        }
+    }
+
+private:
+    double getDeltaT(int x, int y) const{
+        if (burnerMap[x][y]) {
+            return power;
+        }
+        return 0;
+    }
+
+    void calcHeatingStepParallel(int numberOfThreads){
+        int batch = (temperatureMapSizeX-2) / numberOfThreads;
+
+        QVector<QFuture<void>> results(numberOfThreads);
+        for (int i = 0; i < numberOfThreads; ++i){
+            QFuture<void> future = QtConcurrent::run(&BaselineStepper::calcHeatingStepPartial, this, i*batch+1, (i+1)*batch+1);
+            results.push_back(future);
+        }
+
+        for (auto result : results){
+            result.waitForFinished();
+        }
+    }
+
+    void calcHeatingStepPartial(QPromise<void> &promise, int xMin, int xMax){
+        for (int x = xMin; x < xMax; ++x){
+            for (int y = 1; y < temperatureMapSizeY-1; ++y){
+                promise.suspendIfRequested();
+                if (promise.isCanceled()) return;
+
+                if (burnerMap[x][y]){
+                    if (burnerOn) {
+                        temperatureMapL0[x][y] = temperatureMapL0[x][y] + timeStep * (
+                                    getDeltaT(x,y) *
+                                    std::pow((HeatSolver::maxHeaterTemp - temperatureMapL0[x][y])/HeatSolver::maxHeaterTemp, 2));
+                    }
+                    else {
+                        temperatureMapL0[x][y] = qMax(HeatSolver::outsideTemperature,
+                                                      temperatureMapL0[x][y] - timeStep * getDeltaT(x,y)); }
+                }
+            }
+        }
+
+        const double xStep = HeatSolver::xStep, yStep = HeatSolver::yStep, zStep = HeatSolver::zStep;
+        for (int x = xMin; x < xMax; ++x){
+            for (int y = 1; y < temperatureMapSizeY-1; ++y){
+                temperatureMapL3[x][y] = temperatureMapL2[x][y] + alpha*timeStep * (
+                            (temperatureMapL2[x+1][y] - 2*temperatureMapL2[x][y] + temperatureMapL2[x-1][y])/xStep/xStep +   // x
+                            (temperatureMapL2[x][y+1] - 2*temperatureMapL2[x][y] + temperatureMapL2[x][y-1])/yStep/yStep +   // y
+                            (qMin(HeatSolver::outsideTemperature, temperatureMapL2[x][y]*0.7) - 2*temperatureMapL2[x][y] + temperatureMapL0[x][y])/zStep/zStep );  // z
+            }
+        }
+    }
+
+    int temperatureMapSizeX, temperatureMapSizeY;
+    std::vector<std::vector<double>> temperatureMapL0, temperatureMapL2, temperatureMapL3;
+    std::vector<std::vector<bool>> burnerMap;
+    double alpha, timeStep;
+    double power = 0;
+    bool burnerOn;
+};
+
+// the steady state of a run, see --steady
+struct SteadyStateRun{
+    SteadyStateAction action = SteadyStateAction::Off;
+    SteadyStateMonitor monitor;
+    bool reached = false;
+    bool solved = false;
+    double simulatedTime = 0;       // when it was reached or solved
+    double secondsToSteady = -1;    // skipped by the solve (to the equilibrium), < 0 - not known
+    static constexpr double sampleInterval = 0.05;   // s of simulated time between two samples
+};
+
+static QString runScenario(HeatSolver &solver, const Scenario &scenario,
+                           const QString &checkpointFile = QString(), double checkpointPeriod = 0,
+                           SteadyStateRun *steady = nullptr){
+    /* the checkpoints are captured between two chunks and written on the pool while the
+     * next chunks run, one at a time; returns the error of the last failed one */
+    QElapsedTimer checkpointTimer;
+    checkpointTimer.start();
+    QFuture<QString> checkpointWrite;
+    bool checkpointStarted = false;
+    QString checkpointError;
+    auto collectCheckpoint = [&checkpointWrite, &checkpointStarted, &checkpointError](){
+        // waits for the write
+        if (checkpointStarted && !checkpointWrite.result().isEmpty()) checkpointError = checkpointWrite.result();
+        checkpointStarted = false;
+    };
+    const bool periodic = !checkpointFile.isEmpty() && checkpointPeriod > 0;
+    const bool monitored = steady && steady->action != SteadyStateAction::Off;
+    solver.setSteadyStateMonitor(monitored);
+
+    const long long firstStep = solver.getCurrentStep();
+    while (solver.getCurrentStep() - firstStep < scenario.steps){
+        const double now = solver.getSimulatedTime();
+        solver.setBurner(scenario.heaterStateAt(now));
+
+        long long chunk = std::min(scenario.steps - (solver.getCurrentStep() - firstStep), 1LL << 20);
+        // short enough chunks for the wall clock of the checkpoints
+        if (periodic) chunk = std::min(chunk, 256LL);
+        // and for the samples of the convergence, their time is taken as it comes
+        if (monitored){
+            chunk = std::min(chunk, std::max(1LL, static_cast<long long>(std::ceil(SteadyStateRun::sampleInterval
+                                                                                    / solver.getTimeStep()))));
+        }
+        /* a chunk that can reach the next heater switch ends exactly on it, as the sweep cases do:
+         * the steps of RKC are at most maxdt long, the others the time step (the last one cut) */
+        const double untilSwitch = scenario.nextSwitchAfter(now) - now;
+        const double longestStep = solver.getIntegrator() == Integrator::RKC && solver.getPlateLayers() == 1
+                ? solver.getMaxTimeStep() : solver.getTimeStep();
+        if (untilSwitch <= chunk * longestStep) solver.advanceTime(untilSwitch);
+        else solver.calcHeatingSteps(static_cast<int>(chunk));
+
+        if (monitored){
+            // a heater switch starts the convergence again
+            if (scenario.heaterStateAt(solver.getSimulatedTime()) != solver.isBurnerOn()) steady->monitor.reset();
+            else steady->monitor.addSample(solver.getLastStepStatistics());
+            // a solving run goes on while it is steady but the heater is still far from its limit
+            const bool solve = steady->action == SteadyStateAction::Solve && steady->monitor.isSettled();
+            if ((steady->action == SteadyStateAction::Stop && steady->monitor.isSteady()) || solve){
+                steady->reached = true;
+                steady->secondsToSteady = solve ? steady->monitor.secondsToEquilibrium() : 0;
+                steady->solved = solve && solver.solveSteadyState();
+                steady->simulatedTime = solver.getSimulatedTime();
+                break;
+            }
+        }
+
+        if (periodic && checkpointTimer.elapsed() >= checkpointPeriod * 1000 && !checkpointWrite.isRunning()){
+            collectCheckpoint();
+            std::shared_ptr<Checkpoint> checkpoint = std::make_shared<Checkpoint>();
+            checkpoint->capture(solver);
+            checkpointWrite = QtConcurrent::run([checkpoint, checkpointFile](){
+                QString error;
+                checkpoint->write(checkpointFile, &error);
+                return error;
+            });
+            checkpointStarted = true;
+            checkpointTimer.restart();
+        }
+    }
+    collectCheckpoint();
+    return checkpointError;
+}
+
+static double measureStepsPerSecond(Scenario &scenario, int threads, bool workerPool){
+    HeatSolver solver;
+    scenario.apply(solver);
+    solver.setBurner(true);
+    if (workerPool) solver.setNumberOfThreads(threads);
+
+    QElapsedTimer runTimer;
+    if (workerPool){
+        runTimer.start();
+        solver.calcHeatingSteps(static_cast<int>(scenario.steps));
+    }
+    else {
+        BaselineStepper baseline(solver);
+        runTimer.start();
+        for (long long i = 0; i < scenario.steps; ++i) baseline.calcHeatingStep(threads);
+    }
+    const double seconds = runTimer.nsecsElapsed() / 1e9;
+    return seconds > 0 ? scenario.steps / seconds : 0.;
+}
+
+static int validateSolver(Scenario &scenario, KernelIsa isa, QTextStream &out){
+    HeatSolver reference;
+    HeatSolver solver;
+    scenario.apply(reference);
+    scenario.apply(solver);
+    // the scalar explicit steps of the same model: a layered plate is layered in the reference too
+    reference.setKernelIsa(KernelIsa::Scalar);
+    reference.setPlateLayers(scenario.layers);
+    scenario.configure(solver, isa);
+
+    QElapsedTimer runTimer;
+    runTimer.start();
+    runScenario(solver, scenario);
+    const double seconds = runTimer.nsecsElapsed() / 1e9;
+    // the reference is stepped to the simulated time of the solver, the steps of RKC are only known afterwards
+    Scenario referenceScenario = scenario;
+    if (solver.getIntegrator() != Integrator::Explicit){
+        referenceScenario.steps = qRound64(solver.getSimulatedTime() / reference.getTimeStep());
+    }
+    runTimer.restart();
+    runScenario(reference, referenceScenario);
+    const double referenceSeconds = runTimer.nsecsElapsed() / 1e9;
+
+    double maxDeviation = 0;
+    double squares = 0;
+    for (int y = 0; y < solver.sizeY(); ++y){
+        for (int x = 0; x < solver.sizeX(); ++x){
+            const double deviation = qAbs(solver.temperature(x, y) - reference.temperature(x, y));
+            maxDeviation = qMax(maxDeviation, deviation);
+            squares += deviation * deviation;
+        }
+    }
+    const double rmsDeviation = std::sqrt(squares / (static_cast<double>(solver.sizeX()) * solver.sizeY()));
+    if (solver.getIntegrator() != Integrator::Explicit){
+        // compare the same simulated time, not the same number of steps
+        out << (solver.getIntegrator() == Integrator::RKC ? "Last RKC step " : "Implicit time step ")
+            << solver.getTimeStep() << " s, explicit " << reference.getTimeStep()
+            << " s, simulated " << solver.getSimulatedTime() << " s against " << reference.getSimulatedTime() << " s" << Qt::endl;
+    }
+    out << kernelIsaName(solver.getKernelIsa()) << " " << precisionName(solver.getPrecision()) << ", "
+        << scenario.threads << " threads, " << scenario.blockSteps
+        << " steps per sweep against scalar double after " << scenario.steps << " steps: "
+        << "max deviation " << maxDeviation << " C, RMS " << rmsDeviation << " C, "
+        << "max temperature " << solver.maxTemperature() << " C against " << reference.maxTemperature() << " C, speed up "
+        << QString::number(seconds > 0 ? referenceSeconds / seconds : 0., 'f', 2) << Qt::endl;
+    // the other integrators, the reduced precisions and the active tiles are only expected to stay close to the reference
+    if (solver.getIntegrator() != Integrator::Explicit || solver.getPrecision() != Precision::Double) return 0;
+    if (solver.isActiveTileTracking() && solver.getActiveTileEpsilon() > 0){
+        out << "Active tiles, epsilon " << solver.getActiveTileEpsilon() << " C" << Qt::endl;
+        return 0;
+    }
+    return maxDeviation == 0 ? 0 : 2;
+}
+
+static QString mebibytes(size_t bytes){
+    return QString::number(bytes / 1048576., 'f', 2) + " MiB";
+}
+
+static void printMemoryUsage(const HeatSolver &solver, QTextStream &out){
+    const MemoryUsage usage = solver.memoryUsage();
+    out << "Memory: temperature layers " << mebibytes(usage.temperatureLayers)
+        << ", heater layer " << mebibytes(usage.heaterLayer)
+        << " (row stride " << solver.rowStride() << " points, padding " << mebibytes(usage.padding) << ")" << Qt::endl
+        << "        burner " << mebibytes(usage.burnerMap) << ", active tiles " << mebibytes(usage.activeTiles)
+        << ", integrator scratch " << mebibytes(usage.integratorScratch)
+        << ", temporal blocking scratch " << mebibytes(usage.blockingScratch) << Qt::endl
+        << "        float layers " << mebibytes(usage.floatLayers) << ", plate layers " << mebibytes(usage.plateLayers)
+        << ", total " << mebibytes(usage.total()) << Qt::endl;
+}
+
+static void printProfile(QTextStream &out){
+    const ProfileTotals totals = Profiler::instance().totals();
+    out << "phase          calls    total ms   us/call" << Qt::endl;
+    for (int i = 0; i < profilePhaseCount; ++i){
+        if (!totals.calls[i]) continue;
+        out << QString(profilePhaseName(static_cast<ProfilePhase>(i))).leftJustified(9)
+            << qSetFieldWidth(11) << totals.calls[i]
+            << qSetFieldWidth(12) << QString::number(totals.nanoseconds[i] / 1e6, 'f', 2)
+            << qSetFieldWidth(10) << QString::number(totals.nanoseconds[i] / 1e3 / totals.calls[i], 'f', 2)
+            << qSetFieldWidth(0) << Qt::endl;
+    }
+}
+
+static bool writeTrace(const QString &fileName, uint64_t from, uint64_t to, QTextStream &out){
+    std::ostringstream trace;
+    const size_t count = Profiler::instance().writeChromeTrace(trace, from, to);
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+    const std::string json = trace.str();
+    file.write(json.data(), static_cast<qint64>(json.size()));
+    out << count << " phases written to " << fileName << Qt::endl;
+    return true;
+}
+
+static void runBenchmark(Scenario &scenario, int maxThreads, QTextStream &out){
+    out << "threads       baseline steps/s   worker pool steps/s   speed up" << Qt::endl;
+    for (int threads = 1; threads <= maxThreads; ++threads){
+        const double reference = measureStepsPerSecond(scenario, threads, false);
+        const double pool = measureStepsPerSecond(scenario, threads, true);
+        out << qSetFieldWidth(7) << threads << qSetFieldWidth(23) << qRound64(reference)
+            << qSetFieldWidth(22) << qRound64(pool) << qSetFieldWidth(11)
+            << QString::number(reference > 0 ? pool / reference : 0., 'f', 2)
+            << qSetFieldWidth(0) << Qt::endl;
+    }
+}
+
+static int runSweep(const QString &fileName, const Scenario &scenario, KernelIsa isa, int jobs,
+                    const QString &csvFile, QTextStream &out, QTextStream &err){
+    ParameterSweep sweep;
+    if (!sweep.load(fileName, scenario)){
+        err << sweep.errorString() << Qt::endl;
+        return 1;
+    }
+    sweep.run(isa, jobs);
+
+    out << "Sweep of " << sweep.caseCount() << " runs, " << sweep.getDuration() << " s each, target "
+        << sweep.getTargetTemperature() << " C" << Qt::endl
+        << "material       alpha   watts burner pixels  target s    peak C    at s   final C       steps  wall s" << Qt::endl;
+    QFile csv(csvFile);
+    QTextStream csvOut(&csv);
+    if (!csvFile.isEmpty()){
+        if (!csv.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)){
+            err << "Can not write " << csvFile << Qt::endl;
+            return 1;
+        }
+        csvOut << "material,alpha,watts,burner,pixels,time_to_target,peak_temperature,peak_time,final_temperature,"
+                  "steps,wall_seconds,error" << Qt::endl;
+    }
+    double runSeconds = 0;
+    long long steps = 0;
+    for (const SweepResult &result : sweep.getResults()){
+        const SweepCase &parameters = result.parameters;
+        const QString toTarget = result.timeToTarget < 0 ? QString("never") : QString::number(result.timeToTarget, 'f', 2);
+        out << parameters.material.leftJustified(12)
+            << qSetFieldWidth(8) << parameters.alpha << qSetFieldWidth(8) << parameters.watts
+            << qSetFieldWidth(7) << parameters.burner << qSetFieldWidth(7) << result.burnerPixels
+            << qSetFieldWidth(10) << toTarget
+            << qSetFieldWidth(10) << QString::number(result.peakTemperature, 'f', 1)
+            << qSetFieldWidth(8) << QString::number(result.peakTime, 'f', 1)
+            << qSetFieldWidth(10) << QString::number(result.finalTemperature, 'f', 1)
+            << qSetFieldWidth(12) << result.steps << qSetFieldWidth(8) << QString::number(result.wallSeconds, 'f', 2)
+            << qSetFieldWidth(0);
+        if (!result.error.isEmpty()) out << "  " << result.error;
+        out << Qt::endl;
+        if (!csvFile.isEmpty()){
+            csvOut << parameters.material << "," << parameters.alpha << "," << parameters.watts << "," << parameters.burner
+                   << "," << result.burnerPixels << "," << (result.timeToTarget < 0 ? QString() : QString::number(result.timeToTarget))
+                   << "," << result.peakTemperature << "," << result.peakTime << "," << result.finalTemperature
+                   << "," << result.steps << "," << result.wallSeconds << "," << result.error << Qt::endl;
+        }
+        runSeconds += result.wallSeconds;
+        steps += result.steps;
+    }
+    // the time of the runs against the wall time: the cores kept busy
+    const double wall = sweep.getWallSeconds();
+    out << sweep.caseCount() << " runs on " << sweep.getJobs() << " workers in " << wall << " s, "
+        << (wall > 0 ? sweep.caseCount() / wall : 0.) << " runs/s, " << (wall > 0 ? steps / wall : 0.) << " steps/s, "
+        << "speed up " << QString::number(wall > 0 ? runSeconds / wall : 0., 'f', 2) << Qt::endl;
+    if (!csvFile.isEmpty()) out << "Results written to " << csvFile << Qt::endl;
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("stovecli");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless stove top simulation.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("scenario", "Scenario ini file.");
+    QCommandLineOption stepsOption("steps", "Override the number of steps.", "n");
+    QCommandLineOption threadsOption("threads", "Override the number of threads, 0 - single threaded.", "n");
+    QCommandLineOption kernelOption("kernel", "Stencil kernel: scalar, sse2, avx2 or avx512 (default the best the CPU supports).", "isa");
+    QCommandLineOption blockOption("block", "Temporal blocking, steps done in one sweep over the plate, 1 - off.", "k");
+    QCommandLineOption integratorOption("integrator", "Integrator: explicit, adi, multigrid or rkc.", "name");
+    QCommandLineOption timeStepFactorOption("dt-factor", "Time step of the implicit integrators in explicit stability limits.", "f");
+    QCommandLineOption maxTimeStepOption("max-dt", "Largest time step in seconds (default 0.1).", "s");
+    QCommandLineOption rkcToleranceOption("rkc-tolerance", "Local error allowed per RKC step, relative to 1 + |T| (default 1e-4).", "tol");
+    QCommandLineOption precisionOption("precision", "Precision of the explicit steps: double, float or mixed "
+                                                    "(float plate, double heater and arithmetic).", "name");
+    QCommandLineOption layersOption("layers", "Layers through the thickness of the top, implicit in z "
+                                              "(default 1, the single layer model).", "n");
+    QCommandLineOption activeOption("active", "Only step the tiles off the ambient temperature by more than eps deg C.", "eps");
+    QCommandLineOption memoryOption("memory", "Report the memory held by the solver after the run.");
+    QCommandLineOption validateOption("validate", "Compare the result with the scalar reference stepped one step at a time.");
+    QCommandLineOption profileOption("profile", "Report the time spent in every phase of the run.");
+    QCommandLineOption traceOption("trace", "Write the phases of the run as a Chrome trace (JSON) to a file.", "file");
+    QCommandLineOption traceWindowOption("trace-window", "Only trace the phases ending between from and to seconds "
+                                                         "after the start of the run (default all the ring buffers hold).", "from:to");
+    QCommandLineOption restoreOption("restore", "Resume from a checkpoint: plate and its layers, burner, step, time, "
+                                                "material and power; the rest is set by the scenario and the options. "
+                                                "Not with --validate, --bench or --sweep.", "file");
+    QCommandLineOption checkpointOption("checkpoint", "Write a checkpoint of the state after the run.", "file");
+    QCommandLineOption checkpointEveryOption("checkpoint-every", "Also write the checkpoint in the background every "
+                                                                 "s seconds of wall time during the run.", "s");
+    QCommandLineOption sweepOption("sweep", "Run every combination of material, power and burner of the [sweep] "
+                                            "section, single threaded runs spread over the cores.");
+    QCommandLineOption jobsOption("jobs", "Workers of --sweep (default all cores).", "n");
+    QCommandLineOption csvOption("csv", "Also write the results of --sweep as CSV to a file.", "file");
+    QCommandLineOption steadyOption("steady", "Stop the run once the plate is steady (stop), or jump to the "
+                                              "equilibrium once only the slow decay is left (solve).", "action");
+    QCommandLineOption steadyToleranceOption("steady-tolerance", "Steady: no point changes faster than this, "
+                                                                 "deg C/s (default 0.01).", "rate");
+    QCommandLineOption benchOption("bench", "Compare steps/s of the worker pool and of the baseline parallel "
+                                            "step for 1 to --threads (default all cores) threads.");
+    parser.addOption(stepsOption);
+    parser.addOption(threadsOption);
+    parser.addOption(kernelOption);
+    parser.addOption(blockOption);
+    parser.addOption(integratorOption);
+    parser.addOption(timeStepFactorOption);
+    parser.addOption(maxTimeStepOption);
+    parser.addOption(rkcToleranceOption);
+    parser.addOption(precisionOption);
+    parser.addOption(layersOption);
+    parser.addOption(activeOption);
+    parser.addOption(memoryOption);
+    parser.addOption(validateOption);
+    parser.addOption(profileOption);
+    parser.addOption(traceOption);
+    parser.addOption(traceWindowOption);
+    parser.addOption(restoreOption);
+    parser.addOption(checkpointOption);
+    parser.addOption(checkpointEveryOption);
+    parser.addOption(sweepOption);
+    parser.addOption(jobsOption);
+    parser.addOption(csvOption);
+    parser.addOption(steadyOption);
+    parser.addOption(steadyToleranceOption);
+    parser.addOption(benchOption);
+    parser.process(a);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    if (parser.positionalArguments().size() != 1){
+        parser.showHelp(1);
+    }
+
+    Scenario scenario;
+    if (!scenario.load(parser.positionalArguments().first())){
+        err << scenario.errorString() << Qt::endl;
+        return 1;
+    }
+    if (parser.isSet(stepsOption)) scenario.steps = parser.value(stepsOption).toLongLong();
+    if (parser.isSet(threadsOption)) scenario.threads = parser.value(threadsOption).toInt();
+    if (parser.isSet(blockOption)) scenario.blockSteps = parser.value(blockOption).toInt();
+    if (parser.isSet(timeStepFactorOption)) scenario.timeStepFactor = parser.value(timeStepFactorOption).toDouble();
+    if (parser.isSet(layersOption)) scenario.layers = std::max(1, std::min(HeatSolver::maxPlateLayers, parser.value(layersOption).toInt()));
+    if (parser.isSet(activeOption)) scenario.activeEpsilon = parser.value(activeOption).toDouble();
+    if (parser.isSet(maxTimeStepOption)) scenario.maxTimeStep = parser.value(maxTimeStepOption).toDouble();
+    if (parser.isSet(rkcToleranceOption)) scenario.adaptiveTolerance = parser.value(rkcToleranceOption).toDouble();
+    if (parser.isSet(integratorOption) && !integratorFromName(parser.value(integratorOption), &scenario.integrator)){
+        err << "Unknown integrator " << parser.value(integratorOption) << Qt::endl;
+        return 1;
+    }
+
+    if (parser.isSet(precisionOption) && !precisionFromName(parser.value(precisionOption).toLatin1().constData(),
+                                                            &scenario.precision)){
+        err << "Unknown precision " << parser.value(precisionOption) << Qt::endl;
+        return 1;
+    }
+
+    KernelIsa isa = detectKernelIsa();
+    if (parser.isSet(kernelOption) && !kernelIsaFromName(parser.value(kernelOption).toLatin1().constData(), &isa)){
+        err << "Unknown kernel " << parser.value(kernelOption) << Qt::endl;
+        return 1;
+    }
+
+    SteadyStateRun steady;
+    if (parser.isSet(steadyOption) && !steadyStateActionFromName(parser.value(steadyOption).toLatin1().constData(),
+                                                                 &steady.action)){
+        err << "Unknown steady state action " << parser.value(steadyOption) << Qt::endl;
+        return 1;
+    }
+    if (parser.isSet(steadyToleranceOption)) steady.monitor.setTolerance(parser.value(steadyToleranceOption).toDouble());
+    if (steady.monitor.getTolerance() <= 0){
+        err << "--steady-tolerance must be positive" << Qt::endl;
+        return 1;
+    }
+
+    double traceFrom = 0, traceTo = -1;    // seconds after the start of the run, to < 0 - up to the end
+    if (parser.isSet(traceWindowOption)){
+        const QStringList window = parser.value(traceWindowOption).split(':');
+        bool fromOk = false, toOk = false;
+        if (window.size() == 2){
+            traceFrom = window[0].toDouble(&fromOk);
+            traceTo = window[1].toDouble(&toOk);
+        }
+        if (!fromOk || !toOk || traceFrom < 0 || traceTo < traceFrom){
+            err << "Trace window must be from:to in seconds, 0 <= from <= to" << Qt::endl;
+            return 1;
+        }
+    }
+    Profiler::instance().setEnabled(parser.isSet(profileOption) || parser.isSet(traceOption));
+
+    // they step solvers of their own set from the scenario, a restored state would be dropped
+    if (parser.isSet(restoreOption) && (parser.isSet(validateOption) || parser.isSet(benchOption) || parser.isSet(sweepOption))){
+        err << "--restore can not be combined with --validate, --bench or --sweep" << Qt::endl;
+        return 1;
+    }
+
+    if (parser.isSet(sweepOption)){
+        return runSweep(parser.positionalArguments().first(), scenario, isa, parser.value(jobsOption).toInt(),
+                        parser.value(csvOption), out, err);
+    }
+
+    HeatSolver solver;
+    if (!scenario.apply(solver)){
+        err << scenario.errorString() << Qt::endl;
+        return 1;
+    }
+    scenario.configure(solver, isa);
+    if (parser.isSet(restoreOption)){
+        QElapsedTimer restoreTimer;
+        restoreTimer.start();
+        QString error;
+        if (!Checkpoint::restore(solver, parser.value(restoreOption), &error)){
+            err << error << Qt::endl;
+            return 1;
+        }
+        out << "Restored step " << solver.getCurrentStep() << ", " << solver.getSimulatedTime() << " s, from "
+            << parser.value(restoreOption) << " in " << restoreTimer.nsecsElapsed() / 1e6 << " ms" << Qt::endl;
+    }
+    const double checkpointPeriod = parser.isSet(checkpointEveryOption) ? parser.value(checkpointEveryOption).toDouble() : 0;
+    if (parser.isSet(checkpointEveryOption) && (!parser.isSet(checkpointOption) || checkpointPeriod <= 0)){
+        err << "--checkpoint-every needs --checkpoint and a positive number of seconds" << Qt::endl;
+        return 1;
+    }
+
+    if (parser.isSet(validateOption)){
+        return validateSolver(scenario, isa, out);
+    }
+
+    if (parser.isSet(benchOption)){
+        const int maxThreads = parser.isSet(threadsOption) ? scenario.threads
+                                                           : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        runBenchmark(scenario, maxThreads, out);
+        return 0;
+    }
+    out << "Plate " << solver.sizeX() << "x" << solver.sizeY()
+        << ", alpha " << solver.getAlpha() << " mm^2/s, " << solver.getWatts() << " W, "
+        << solver.getNumberOfBurnerPixels() << " burner pixels, time step "
+        << solver.getTimeStep() << " s, " << scenario.threads << " threads, "
+        << kernelIsaName(solver.getKernelIsa()) << " kernel, " << solver.getTemporalBlockSteps()
+        << " steps per sweep, " << integratorName(solver.getIntegrator()) << " integrator, "
+        << precisionName(solver.getPrecision()) << " precision" << Qt::endl;
+    if (solver.getPlateLayers() > 1){
+        out << solver.getPlateLayers() << " layers through the top, implicit in z, in double precision" << Qt::endl;
+    }
+
+    QElapsedTimer runTimer;
+    runTimer.start();
+    const uint64_t runStart = Profiler::instance().now();
+    // a restored run has steps and time already, the rates only count those of this run
+    const long long stepStart = solver.getCurrentStep();
+    const double simulatedStart = solver.getSimulatedTime();
+
+    const QString checkpointError = runScenario(solver, scenario, parser.value(checkpointOption), checkpointPeriod, &steady);
+
+    const double seconds = runTimer.nsecsElapsed() / 1e9;
+    const uint64_t runEnd = Profiler::instance().now();
+    out << "Simulated " << solver.getSimulatedTime() << " s in " << solver.getCurrentStep() << " steps, "
+        << "max plate temperature " << solver.maxTemperature() << " C" << Qt::endl;
+    if (steady.action != SteadyStateAction::Off){
+        if (steady.solved){
+            out << "Jumped to the equilibrium at " << steady.simulatedTime << " s in "
+                << solver.getLastSteadyStateIterations() << " multigrid solves";
+            if (steady.secondsToSteady >= 0) out << ", about " << steady.secondsToSteady << " s of simulated time skipped";
+            out << " (decay time " << steady.monitor.getDecayTime() << " s)" << Qt::endl;
+        }
+        else if (steady.reached){
+            out << "Steady within " << steady.monitor.getTolerance() << " C/s at " << steady.simulatedTime << " s" << Qt::endl;
+        }
+        else if (solver.getPlateLayers() > 1 || solver.getIntegrator() != Integrator::Explicit
+                 || solver.getPrecision() != Precision::Double){
+            out << "Steady state not monitored, only the single layer explicit double precision steps are" << Qt::endl;
+        }
+        else {
+            out << "Not steady, fastest change " << steady.monitor.getRate() << " C/s";
+            if (steady.monitor.secondsToSteady() > 0) out << ", about " << steady.monitor.secondsToSteady() << " s to go";
+            out << Qt::endl;
+        }
+    }
+    if (solver.isActiveTileTracking()){
+        out << solver.countActiveTiles() << " of " << solver.getTileCountX() * solver.getTileCountY()
+            << " tiles active" << Qt::endl;
+    }
+    if (solver.getPlateLayers() > 1){
+        // the hottest point of the lowest layer, over the heater
+        double bottom = -std::numeric_limits<double>::infinity();
+        for (int y = 0; y < solver.sizeY(); ++y){
+            const double *row = solver.layerRow(y, 0);
+            bottom = std::max(bottom, *std::max_element(row, row + solver.sizeX()));
+        }
+        out << "max temperature of the lowest layer " << bottom << " C" << Qt::endl;
+    }
+    if (solver.getIntegrator() == Integrator::Multigrid){
+        out << "Last step solved in " << solver.getLastMultigridCycles() << " V-cycles" << Qt::endl;
+    }
+    if (solver.getIntegrator() == Integrator::RKC){
+        out << solver.getAcceptedSteps() << " steps accepted, " << solver.getRejectedSteps() << " rejected, last step "
+            << solver.getTimeStep() << " s in " << solver.getLastStages() << " stages" << Qt::endl;
+    }
+    out << "Wall time " << seconds << " s, "
+        << (seconds > 0 ? (solver.getCurrentStep() - stepStart) / seconds : 0.) << " steps/s, "
+        << (seconds > 0 ? (solver.getSimulatedTime() - simulatedStart) / seconds : 0.) << "x real time" << Qt::endl;
+    if (parser.isSet(memoryOption)) printMemoryUsage(solver, out);
+    if (parser.isSet(profileOption)) printProfile(out);
+    if (!checkpointError.isEmpty()) err << checkpointError << Qt::endl;
+    if (parser.isSet(checkpointOption)){
+        Checkpoint checkpoint;
+        checkpoint.capture(solver);
+        QString error;
+        if (!checkpoint.write(parser.value(checkpointOption), &error)){
+            err << error << Qt::endl;
+            return 1;
+        }
+        out << "Checkpoint of step " << checkpoint.getStep() << " written to " << parser.value(checkpointOption) << Qt::endl;
+    }
+    if (parser.isSet(traceOption)){
+        const uint64_t from = runStart + static_cast<uint64_t>(traceFrom * 1e9);
+        const uint64_t to = traceTo < 0 ? runEnd : runStart + static_cast<uint64_t>(traceTo * 1e9);
+        if (!writeTrace(parser.value(traceOption), from, to, out)){
+            err << "Can not write " << parser.value(traceOption) << Qt::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
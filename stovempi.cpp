@@ -0,0 +1,246 @@
+/* Distributed runs of the explicit steps over MPI ranks (see DistributedSolver):
+ *   mpirun -np 4 stovempi --size 2050x2050 --steps 500 --validate
+ * steps a plate with a disc burner, reports the throughput and the time spent
+ * waiting for the halos, and with --validate compares the plate with a single
+ * solver stepped on the first rank.
+ *   mpirun -np 8 stovempi --scaling --size 4098x4098 --weak 1024 --steps 200
+ * reports the strong scaling (the same plate over 1, 2, 4... ranks) and the weak
+ * scaling (a block of weak*weak points per rank) from one launch, the ranks
+ * left out of a row wait. Only the C++ standard library and MPI are used, so it
+ * builds with the MPI compiler wrappers on machines without Qt (StoveMpi.pro). */
+
+// MPI
+#include <mpi.h>
+
+// C++ libs
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "distributedsolver.h"
+#include "heatsolver.h"
+
+struct MpiRunOptions{
+    int sizeX = 1026;
+    int sizeY = 1026;
+    int steps = 200;
+    double alpha = 23.;
+    int watts = 5000;
+    int burnerDiameter = 0;         // 0 - half of the shorter side
+    KernelIsa isa = detectKernelIsa();
+    bool validate = false;
+    bool scaling = false;
+    int weakBlock = 512;            // weak scaling: points of a block side per rank
+};
+
+struct MpiRunResult{
+    int ranks = 1;
+    int gridX = 1, gridY = 1;
+    int sizeX = 0, sizeY = 0;
+    double seconds = 0;             // the slowest rank
+    double waitSeconds = 0;         // the longest wait for halos of a rank
+    double maxTemperature = 0;
+};
+
+static void printUsage(){
+    std::printf("Usage: mpirun -np N stovempi [options]\n"
+                "  --size WxH       plate size, border points included (default 1026x1026)\n"
+                "  --steps n        explicit steps (default 200)\n"
+                "  --alpha a        thermal diffusivity of the top, mm^2/s (default 23)\n"
+                "  --watts w        burner power (default 5000)\n"
+                "  --burner d       diameter of the centred disc burner (default half of the plate)\n"
+                "  --isa name       stencil kernel: scalar, sse2, avx2, avx512 (default the best supported)\n"
+                "  --validate       compare the plate with a single solver stepped on the first rank\n"
+                "  --scaling        strong and weak scaling over 1, 2, 4... ranks up to N\n"
+                "  --weak n         weak scaling block side per rank (default 512)\n");
+}
+
+static bool parseOptions(int argc, char *argv[], MpiRunOptions *options){
+    for (int i = 1; i < argc; ++i){
+        const std::string arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (arg == "--validate") options->validate = true;
+        else if (arg == "--scaling") options->scaling = true;
+        else if (!value) return false;
+        else {
+            ++i;
+            if (arg == "--size"){
+                if (std::sscanf(value, "%dx%d", &options->sizeX, &options->sizeY) != 2) return false;
+            }
+            else if (arg == "--steps") options->steps = std::atoi(value);
+            else if (arg == "--alpha") options->alpha = std::atof(value);
+            else if (arg == "--watts") options->watts = std::atoi(value);
+            else if (arg == "--burner") options->burnerDiameter = std::atoi(value);
+            else if (arg == "--weak") options->weakBlock = std::atoi(value);
+            else if (arg == "--isa"){
+                if (!kernelIsaFromName(value, &options->isa) || !isKernelIsaSupported(options->isa)) return false;
+            }
+            else return false;
+        }
+    }
+    return options->sizeX >= 3 && options->sizeY >= 3 && options->steps > 0 && options->alpha > 0
+            && options->watts >= 0 && options->burnerDiameter >= 0 && options->weakBlock > 0;
+}
+
+template <typename Solver>
+static void setupPlate(Solver &solver, const MpiRunOptions &options, int sizeX, int sizeY){
+    // the same burner, material and power for the distributed and the single solver
+    const int diameter = options.burnerDiameter > 0 ? options.burnerDiameter : std::min(sizeX, sizeY) / 2;
+    solver.setKernelIsa(options.isa);
+    solver.setAlpha(options.alpha);
+    solver.setBurnerDisc(sizeX / 2, sizeY / 2, diameter, true);
+    solver.countBurnerPixels();
+    solver.setWatts(options.watts);
+    solver.setBurner(true);
+}
+
+static MpiRunResult timedRun(MPI_Comm communicator, const MpiRunOptions &options, int sizeX, int sizeY){
+    DistributedSolver solver(communicator, sizeX, sizeY);
+    setupPlate(solver, options, sizeX, sizeY);
+    // a few steps to fault the pages in and settle the connections
+    solver.calcHeatingSteps(std::min(10, options.steps));
+    const double waitBefore = solver.getExchangeWaitSeconds();
+
+    MPI_Barrier(communicator);
+    const double start = MPI_Wtime();
+    solver.calcHeatingSteps(options.steps);
+    const double seconds = MPI_Wtime() - start;
+    const double wait = solver.getExchangeWaitSeconds() - waitBefore;
+
+    MpiRunResult result;
+    result.ranks = solver.getRanks();
+    result.gridX = solver.getGridX();
+    result.gridY = solver.getGridY();
+    result.sizeX = sizeX;
+    result.sizeY = sizeY;
+    MPI_Allreduce(&seconds, &result.seconds, 1, MPI_DOUBLE, MPI_MAX, communicator);
+    MPI_Allreduce(&wait, &result.waitSeconds, 1, MPI_DOUBLE, MPI_MAX, communicator);
+    result.maxTemperature = solver.maxTemperature();
+    return result;
+}
+
+static double megacellsPerSecond(const MpiRunResult &result, int steps){
+    return static_cast<double>(result.sizeX - 2) * (result.sizeY - 2) * steps / result.seconds / 1e6;
+}
+
+static int runSingle(const MpiRunOptions &options){
+    DistributedSolver solver(MPI_COMM_WORLD, options.sizeX, options.sizeY);
+    setupPlate(solver, options, options.sizeX, options.sizeY);
+    const bool root = solver.getRank() == 0;
+    if (root){
+        std::printf("plate %dx%d on %d ranks as %dx%d blocks of about %dx%d points, %s kernel, %d steps of %g s\n",
+                    options.sizeX, options.sizeY, solver.getRanks(), solver.getGridX(), solver.getGridY(),
+                    solver.blockSizeX(), solver.blockSizeY(), kernelIsaName(solver.getKernelIsa()),
+                    options.steps, solver.getTimeStep());
+    }
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    const double start = MPI_Wtime();
+    solver.calcHeatingSteps(options.steps);
+    const double elapsed = MPI_Wtime() - start;
+    double seconds = 0, wait = 0;
+    const double ownWait = solver.getExchangeWaitSeconds();
+    MPI_Allreduce(&elapsed, &seconds, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    MPI_Allreduce(&ownWait, &wait, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    const double maximum = solver.maxTemperature();
+    const std::vector<double> plate = solver.gatherPlate();
+
+    if (!root) return 0;
+    const double cells = static_cast<double>(options.sizeX - 2) * (options.sizeY - 2) * options.steps;
+    std::printf("%.3f s, %.1f Mcell/s, %.2fx real time, halo wait up to %.1f%% of the run (%lld bytes per step per rank)\n",
+                seconds, cells / seconds / 1e6, solver.getSimulatedTime() / seconds, 100. * wait / seconds,
+                solver.haloBytesPerStep());
+    std::printf("simulated %.3f s, max plate temperature %.6f C\n", solver.getSimulatedTime(), maximum);
+
+    if (options.validate){
+        HeatSolver reference(options.sizeX, options.sizeY);
+        setupPlate(reference, options, options.sizeX, options.sizeY);
+        reference.calcHeatingSteps(options.steps);
+        double deviation = 0;
+        for (int y = 0; y < options.sizeY; ++y){
+            const double *row = reference.temperatureRow(y);
+            for (int x = 0; x < options.sizeX; ++x){
+                deviation = std::max(deviation, std::fabs(row[x] - plate[static_cast<size_t>(y) * options.sizeX + x]));
+            }
+        }
+        std::printf("max deviation from a single solver %g C\n", deviation);
+        if (deviation > 1e-9) return 1;
+    }
+    return 0;
+}
+
+static void runScaling(const MpiRunOptions &options){
+    int worldRank = 0, worldSize = 1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &worldRank);
+    MPI_Comm_size(MPI_COMM_WORLD, &worldSize);
+    std::vector<int> rankCounts;
+    for (int p = 1; p < worldSize; p *= 2) rankCounts.push_back(p);
+    rankCounts.push_back(worldSize);
+
+    for (int weak = 0; weak < 2; ++weak){
+        if (worldRank == 0){
+            if (weak) std::printf("\nweak scaling, %dx%d points per rank, %d steps\n", options.weakBlock, options.weakBlock, options.steps);
+            else std::printf("strong scaling, plate %dx%d, %d steps\n", options.sizeX, options.sizeY, options.steps);
+            std::printf("ranks  blocks        plate    seconds    Mcell/s  speed up  efficiency  halo wait\n");
+        }
+        double oneRankSeconds = 0;
+        for (int p : rankCounts){
+            // the first p ranks step the plate, the others wait for them
+            MPI_Comm communicator;
+            MPI_Comm_split(MPI_COMM_WORLD, worldRank < p ? 0 : MPI_UNDEFINED, worldRank, &communicator);
+            if (communicator != MPI_COMM_NULL){
+                int sizeX = options.sizeX, sizeY = options.sizeY;
+                if (weak){
+                    int dims[2] = {0, 0};
+                    MPI_Dims_create(p, 2, dims);
+                    sizeX = dims[0] * options.weakBlock + 2;
+                    sizeY = dims[1] * options.weakBlock + 2;
+                }
+                const MpiRunResult result = timedRun(communicator, options, sizeX, sizeY);
+                if (p == 1) oneRankSeconds = result.seconds;
+                if (worldRank == 0){
+                    // weak: the same time at any count is perfect, strong: p times faster
+                    const double speedUp = weak ? oneRankSeconds * p / result.seconds : oneRankSeconds / result.seconds;
+                    const double efficiency = weak ? oneRankSeconds / result.seconds : speedUp / p;
+                    char blocks[32], plate[32];
+                    std::snprintf(blocks, sizeof(blocks), "%dx%d", result.gridX, result.gridY);
+                    std::snprintf(plate, sizeof(plate), "%dx%d", result.sizeX, result.sizeY);
+                    std::printf("%5d  %6s  %11s  %9.3f  %9.1f  %8.2f  %10.2f  %8.1f%%\n",
+                                p, blocks, plate, result.seconds, megacellsPerSecond(result, options.steps),
+                                speedUp, efficiency, 100. * result.waitSeconds / result.seconds);
+                    std::fflush(stdout);
+                }
+                MPI_Comm_free(&communicator);
+            }
+            MPI_Barrier(MPI_COMM_WORLD);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    MPI_Init(&argc, &argv);
+    int worldRank = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &worldRank);
+
+    MpiRunOptions options;
+    if (!parseOptions(argc, argv, &options)){
+        if (worldRank == 0) printUsage();
+        MPI_Finalize();
+        return 2;
+    }
+
+    int status = 0;
+    if (options.scaling) runScaling(options);
+    else status = runSingle(options);
+
+    // a failed validation on the first rank fails the launch
+    int worstStatus = 0;
+    MPI_Allreduce(&status, &worstStatus, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    MPI_Finalize();
+    return worstStatus;
+}
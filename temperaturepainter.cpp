@@ -0,0 +1,50 @@
+#include "temperaturepainter.h"
+
+TemperaturePainter::TemperaturePainter(){
+    buildColorTable();
+}
+
+void TemperaturePainter::buildColorTable(){
+    /* the color of a point corresponds to the temperature 1 to 1,
+     * 0-255 : red, 256-510 : full_red+green, 511-766 : full_red+full_green+blue
+     * i.e. colour goes from black at T = 0 to white at T = 766,
+     * heaviside function give value > 0 ? value : 0 */
+    colorTable.resize(colorTableSize);
+    for (int i = 0; i < colorTableSize; ++i){
+        const double temperature = i * colorTableMaxTemperature / (colorTableSize - 1);
+        colorTable[i] = qRgb(qMin(255., temperature),
+                             qMin(255. , heaviside(temperature - 255.)),
+                             qMin(255. , heaviside(temperature - 510.)));
+    }
+}
+
+void TemperaturePainter::paintTileRows(const SimulationFrame &frame, uchar *pixels, int width, int height, int bytesPerLine,
+                                       int tileYMin, int tileYMax, QRgb ambientColor, bool repaintAmbient,
+                                       char *dirtyTiles) const{
+    /* the inactive tiles are all at the ambient temperature, they are only
+     * repainted when its colour changes; a tile is dirty if any pixel changed */
+    const int tileSize = HeatSolver::tileSize;
+    width = qMin(frame.sizeX, width);
+    height = qMin(frame.sizeY, height);
+    for (int tileY = tileYMin; tileY < tileYMax; ++tileY){
+        const int yMax = qMin(height, (tileY+1)*tileSize);
+        for (int tileX = 0; tileX < frame.tileCountX; ++tileX){
+            const bool active = frame.isTileActive(tileX, tileY);
+            if (!active && !repaintAmbient) continue;
+            const int xMin = tileX*tileSize;
+            const int xMax = qMin(width, xMin + tileSize);
+
+            bool changed = false;
+            for (int y = tileY*tileSize; y < yMax; ++y){
+                QRgb *line = reinterpret_cast<QRgb *>(pixels + y * bytesPerLine);
+                const double *temperature = frame.temperatureRow(y);
+                for (int x = xMin; x < xMax; ++x){
+                    const QRgb color = active ? temperatureColor(temperature[x]) : ambientColor;
+                    changed |= line[x] != color;
+                    line[x] = color;
+                }
+            }
+            if (changed) dirtyTiles[tileY * frame.tileCountX + tileX] = 1;
+        }
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef TEMPERATUREPAINTER_H
+#define TEMPERATUREPAINTER_H
+
+/* Paints the frames of the simulation into 32 bit pixels through a colour table,
+ * black - red - yellow - white over 0..766 deg C. Kept apart from DrawArea so the
+ * paint pass can be timed without a widget (stovebench). */
+
+// Qt colours
+#include <QRgb>
+#include <QVector>
+
+#include "simulationthread.h"
+
+//______________________________________________Temperature Painter________________//
+class TemperaturePainter{
+public:
+    TemperaturePainter();
+
+    QRgb temperatureColor(double temperature) const{
+        const int i = static_cast<int>(temperature * ((colorTableSize - 1) / colorTableMaxTemperature) + 0.5);
+        return colorTable[qBound(0, i, colorTableSize - 1)];
+    }
+
+    /* tile rows tileYMin..tileYMax of the frame into pixels (width*height, bytesPerLine apart);
+     * dirtyTiles (one per tile of the frame) is set for every tile with a changed pixel */
+    void paintTileRows(const SimulationFrame &frame, uchar *pixels, int width, int height, int bytesPerLine,
+                       int tileYMin, int tileYMax, QRgb ambientColor, bool repaintAmbient, char *dirtyTiles) const;
+
+    static constexpr int colorTableSize = 1024;
+    static constexpr double colorTableMaxTemperature = 766.;
+
+private:
+    void buildColorTable();
+
+    template <typename T>
+    static T heaviside(T number) { return (number >= 0 ? number : 0 ); }
+
+    QVector<QRgb> colorTable;
+};
+
+#endif // TEMPERATUREPAINTER_H
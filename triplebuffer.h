@@ -0,0 +1,46 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+/* Lock-free triple buffer between one writer and one reader thread.
+ * The writer fills the back buffer and publishes it by swapping it with the
+ * middle one; the reader takes the middle buffer when it holds a newer frame.
+ * Neither side ever waits for the other: the writer always has a free buffer
+ * and the reader always has the last complete frame, older frames are dropped. */
+
+// C++ libs
+#include <atomic>
+#include <cstdint>
+
+//______________________________________________Triple Buffer________________//
+template <typename T>
+class TripleBuffer{
+public:
+    // writer side: the buffer to fill, then publish() hands it to the reader
+    T &writeBuffer() { return buffers[back]; }
+
+    void publish(){
+        // release: the contents of the back buffer are visible to the reader
+        back = state.exchange(static_cast<uint8_t>(back | freshBit), std::memory_order_acq_rel) & indexMask;
+    }
+
+    // reader side: takes the last published frame, false if there is nothing new
+    bool update(){
+        if (!(state.load(std::memory_order_relaxed) & freshBit)) return false;
+        // acquire: the frame written before publish() is visible here
+        front = state.exchange(front, std::memory_order_acq_rel) & indexMask;
+        return true;
+    }
+
+    const T &readBuffer() const { return buffers[front]; }
+
+private:
+    static constexpr uint8_t indexMask = 3;
+    static constexpr uint8_t freshBit = 4;     // the middle buffer was not read yet
+
+    T buffers[3];
+    uint8_t back = 0;                          // owned by the writer
+    uint8_t front = 1;                         // owned by the reader
+    std::atomic<uint8_t> state{2};             // index of the middle buffer | freshBit
+};
+
+#endif // TRIPLEBUFFER_H
@@ -0,0 +1,100 @@
+#include "workerpool.h"
+
+#include <algorithm>
+
+#include "profiler.h"
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+static inline void cpuRelax() { _mm_pause(); }
+#else
+static inline void cpuRelax() { std::this_thread::yield(); }
+#endif
+
+static int hardwareThreads(){
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+SpinBarrier::SpinBarrier(int count, int spinCount)
+    : count(count), spinCount(spinCount){
+}
+
+void SpinBarrier::arriveAndWait(){
+    const unsigned currentGeneration = generation.load(std::memory_order_acquire);
+
+    // the last thread to arrive opens the barrier for everybody
+    if (arrived.fetch_add(1, std::memory_order_acq_rel) == count - 1){
+        arrived.store(0, std::memory_order_relaxed);
+        generation.fetch_add(1, std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_seq_cst) > 0){
+            // taking the mutex guarantees the sleepers are already waiting on the condition
+            { std::lock_guard<std::mutex> lock(mutex); }
+            condition.notify_all();
+        }
+        return;
+    }
+
+    // spin first, steps are short and a sleep/wake up costs more than a step
+    for (int i = 0; i < spinCount; ++i){
+        if (generation.load(std::memory_order_acquire) != currentGeneration) return;
+        cpuRelax();
+    }
+
+    // then block, e.g. between the frames of the GUI
+    std::unique_lock<std::mutex> lock(mutex);
+    sleepers.fetch_add(1, std::memory_order_seq_cst);
+    condition.wait(lock, [&](){ return generation.load(std::memory_order_seq_cst) != currentGeneration; });
+    sleepers.fetch_sub(1, std::memory_order_relaxed);
+}
+
+WorkerPool::WorkerPool(int numberOfThreads, bool pinThreads)
+    : numberOfThreads(std::max(1, numberOfThreads)),
+      pinThreads(pinThreads),
+      // spinning only makes sense if every worker has its own core
+      syncBarrier(std::max(1, numberOfThreads), numberOfThreads <= hardwareThreads() ? 4000 : 0){
+    threads.reserve(this->numberOfThreads - 1);
+    for (int i = 1; i < this->numberOfThreads; ++i){
+        threads.emplace_back(&WorkerPool::workerLoop, this, i);
+    }
+}
+
+WorkerPool::~WorkerPool(){
+    stopping = true;
+    syncBarrier.arriveAndWait();
+    for (std::thread &thread : threads){
+        thread.join();
+    }
+}
+
+void WorkerPool::dispatch(){
+    // start barrier, the workers pick up the job
+    syncBarrier.arriveAndWait();
+    jobFunction(jobContext, 0);
+    // end barrier, all the workers are done
+    syncBarrier.arriveAndWait();
+}
+
+void WorkerPool::workerLoop(int workerIndex){
+#if defined(__linux__)
+    if (pinThreads){
+        // worker i always runs on core i, so its strip of the grid stays in that core's cache
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        CPU_SET(workerIndex % hardwareThreads(), &cpuSet);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet);
+    }
+#endif
+    Profiler::instance().setThreadName("worker " + std::to_string(workerIndex));
+
+    for (;;){
+        syncBarrier.arriveAndWait();
+        if (stopping) return;
+        jobFunction(jobContext, workerIndex);
+        syncBarrier.arriveAndWait();
+    }
+}
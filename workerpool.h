@@ -0,0 +1,73 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+/* Persistent pool of worker threads for the heat solver.
+ * The threads are created once, pinned to cores and kept for the whole run;
+ * a job is ran by all of them at once (the calling thread is worker 0),
+ * and the workers synchronise on a spin-then-block barrier. Nothing is
+ * allocated when a job is dispatched. */
+
+// C++ libs
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//______________________________________________Spin Barrier________________//
+class SpinBarrier{
+public:
+    explicit SpinBarrier(int count, int spinCount = 4000);
+
+    void arriveAndWait();
+
+private:
+    const int count;
+    const int spinCount;           // number of polls before going to sleep
+    std::atomic<int> arrived{0};
+    std::atomic<unsigned> generation{0};
+    std::atomic<int> sleepers{0};
+    std::mutex mutex;
+    std::condition_variable condition;
+};
+
+//______________________________________________Worker Pool________________//
+class WorkerPool{
+public:
+    explicit WorkerPool(int numberOfThreads, bool pinThreads = true);
+
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool &) = delete;
+
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    int size() const { return numberOfThreads; }
+
+    // calls job(workerIndex) on every worker, returns when all of them are done
+    template <typename Job>
+    void run(Job &job){
+        jobContext = &job;
+        jobFunction = [](void *context, int workerIndex){ (*static_cast<Job *>(context))(workerIndex); };
+        dispatch();
+    }
+
+    // to be called by every worker from inside a job
+    void barrier() { syncBarrier.arriveAndWait(); }
+
+private:
+    void dispatch();
+
+    void workerLoop(int workerIndex);
+
+    const int numberOfThreads;
+    const bool pinThreads;
+    SpinBarrier syncBarrier;
+    std::vector<std::thread> threads;   // workers 1..numberOfThreads-1
+
+    void *jobContext = nullptr;
+    void (*jobFunction)(void *, int) = nullptr;
+    bool stopping = false;
+};
+
+#endif // WORKERPOOL_H